@@ -0,0 +1,138 @@
+// Channel throughput and latency benchmark
+// Usage: channel_bench [max_lanes] [messages_per_producer] [capacity]
+// Part 1 drives the runtime ring (channels.hpp) with N producer and N
+// consumer threads, N = 1, 2, 4 ... max_lanes: throughput in messages
+// per second and p50/p99 send-to-receive latency. N = 1 uses the SPSC
+// tickets, larger N the MPMC ones. Part 2 compiles programs where N
+// producer lanes send to N consumer lanes through one channel, builds
+// them with the direct backend and times the executables.
+
+#include "../src/all.hpp"
+#include "../src/channels.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace EScript;
+
+static uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static void runtimeBench(size_t lanes, size_t messages, uint32_t capacity) {
+    Channel<uint64_t> channel(capacity, lanes == 1, lanes == 1);
+    const size_t total = lanes * messages;
+    std::vector<std::vector<uint64_t>> latency(lanes);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < lanes; ++p) {
+        threads.emplace_back([&] {
+            for (size_t i = 0; i < messages; ++i) channel.send(nowNs());
+        });
+    }
+    for (size_t c = 0; c < lanes; ++c) {
+        threads.emplace_back([&, c] {
+            latency[c].reserve(messages);
+            for (size_t i = 0; i < messages; ++i) {
+                uint64_t sent = channel.receive();
+                latency[c].push_back(nowNs() - sent);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<uint64_t> all;
+    all.reserve(total);
+    for (const auto& l : latency) all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+    std::cout << "[Bench] Runtime " << lanes << "x" << lanes << (lanes == 1 ? " (spsc)" : " (mpmc)")
+              << ": " << total / secs / 1e6 << " M msgs/s, latency p50 "
+              << all[all.size() / 2] / 1000.0 << " us, p99 "
+              << all[all.size() * 99 / 100] / 1000.0 << " us\n";
+}
+
+static std::string pipelineScript(size_t lanes, size_t messages, uint32_t capacity) {
+    std::string src = "channel q " + std::to_string(capacity) + " #\n";
+    for (size_t i = 0; i < messages; ++i) {
+        for (size_t l = 0; l < lanes; ++l) {
+            src += "lane p" + std::to_string(l) + " send q \"item " + std::to_string(i) + "\" #\n";
+            src += "lane c" + std::to_string(l) + " receive q v" + std::to_string(l) + " #\n";
+        }
+    }
+    src += "sync lanes #\n";
+    return src;
+}
+
+static double runSeconds(const std::string& exe) {
+    std::string cmd = "./" + exe + " > /dev/null";
+    auto start = std::chrono::steady_clock::now();
+    int status = std::system(cmd.c_str());
+    auto end = std::chrono::steady_clock::now();
+    if (status != 0) {
+        throw std::runtime_error("Benchmark program failed: " + exe);
+    }
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+#ifdef _WIN32
+    std::cout << "[Bench] Channel runtime requires Linux\n";
+    return 0;
+#else
+    try {
+        size_t maxLanes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 8;
+        size_t messages = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200000;
+        uint32_t capacity = argc > 3 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 1024;
+        if (maxLanes < 1) maxLanes = 1;
+        if (messages < 1) messages = 1;
+        if (capacity < 1 || capacity > kMaxChannelCapacity || (capacity & (capacity - 1))) {
+            std::cerr << "Capacity must be a power of two up to " << kMaxChannelCapacity << "\n";
+            return 1;
+        }
+
+        std::cout << "[Bench] " << std::thread::hardware_concurrency() << " cores, "
+                  << messages << " messages per producer, capacity " << capacity << "\n";
+        for (size_t lanes = 1; lanes <= maxLanes; lanes *= 2) {
+            runtimeBench(lanes, messages, capacity);
+        }
+
+        // Compiled programs hold one statement per message; keep them small
+        const size_t programMessages = std::min<size_t>(messages, 20000);
+        const std::string exe = "channel_bench_prog";
+        for (size_t lanes = 1; lanes <= maxLanes; lanes *= 2) {
+            std::string source = pipelineScript(lanes, programMessages, capacity);
+            auto tokens = tokenize(source);
+            Parser parser(source, tokens);
+            auto prog = parser.parse();
+            IRProgram ir = generateIR(*prog);
+            std::ostringstream log;
+            emitDirect(ir, exe, {}, log);
+
+            double best = 0.0;
+            for (int i = 0; i < 3; ++i) {
+                double secs = runSeconds(exe);
+                if (i == 0 || secs < best) best = secs;
+            }
+            double total = static_cast<double>(lanes * programMessages);
+            std::cout << "[Bench] Compiled " << lanes << "x" << lanes << ": " << best * 1000.0 << " ms, "
+                      << total / best / 1e6 << " M msgs/s\n";
+        }
+        std::remove(exe.c_str());
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+#endif
+}
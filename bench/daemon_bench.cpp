@@ -0,0 +1,115 @@
+// Compiler daemon load generator
+// Usage: daemon_bench [clients] [requests_per_client] [workers]
+// Starts runDaemon on a private socket in this process, then drives it
+// from `clients` threads, each on its own connection, with check, run
+// and direct-backend compile requests for a small script. Reports
+// p50/p99/max round-trip latency and throughput per request kind.
+
+#include "../src/daemon.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+using namespace EScript;
+
+static const char* kScript =
+    "create counter 0 #\n"
+    "modify counter 42 #\n"
+    "adjust counter 1 #\n"
+    "process write \"Hello from E-Script!\" #\n"
+    "lane y1 process write \"lane one\" #\n"
+    "lane y2 process write \"lane two\" #\n"
+    "sync lanes #\n"
+    "process write counter #\n";
+
+static double percentile(std::vector<double>& v, double p) {
+    size_t i = static_cast<size_t>(p * (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + i, v.end());
+    return v[i];
+}
+
+int main(int argc, char** argv) {
+    size_t clients = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4;
+    size_t requests = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000;
+    size_t workers = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 0;
+
+    std::string socketPath = "/tmp/escript_bench_" + std::to_string(getpid()) + ".sock";
+    CompileOptions base;
+    std::thread server([&] {
+        std::ostream quiet(nullptr);
+        runDaemon(socketPath, base, workers, quiet);
+    });
+
+    // Wait for the listener
+    for (int i = 0; i < 1000; ++i) {
+        try {
+            DaemonClient probe(socketPath);
+            break;
+        }
+        catch (const std::exception&) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    struct Kind {
+        const char* name;
+        RequestKind kind;
+    };
+    for (Kind k : {Kind{"check", RequestKind::Check}, Kind{"run", RequestKind::Run},
+                   Kind{"compile", RequestKind::Compile}}) {
+        std::vector<std::vector<double>> perClient(clients);
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> threads;
+        for (size_t c = 0; c < clients; ++c) {
+            threads.emplace_back([&, c] {
+                DaemonClient client(socketPath);
+                DaemonRequest req;
+                req.kind = k.kind;
+                req.backend = Backend::Direct;
+                req.input = "bench.es";
+                req.source = kScript;
+                req.output = socketPath + "." + std::to_string(c) + ".out";
+
+                // Warm-up requests are not timed
+                for (int i = 0; i < 10; ++i) client.request(req);
+                for (size_t i = 0; i < requests; ++i) {
+                    auto t0 = std::chrono::steady_clock::now();
+                    DaemonResponse resp = client.request(req);
+                    auto t1 = std::chrono::steady_clock::now();
+                    if (resp.status != 0) {
+                        std::cerr << resp.log;
+                        std::exit(1);
+                    }
+                    perClient[c].push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+                }
+                std::remove(req.output.c_str());
+            });
+        }
+        for (auto& t : threads) t.join();
+        auto end = std::chrono::steady_clock::now();
+
+        std::vector<double> all;
+        for (auto& v : perClient) all.insert(all.end(), v.begin(), v.end());
+        double secs = std::chrono::duration<double>(end - start).count();
+        double maxUs = *std::max_element(all.begin(), all.end());
+        double p50 = percentile(all, 0.50);
+        double p99 = percentile(all, 0.99);
+        std::cout << "[Bench] Daemon " << k.name << ": " << clients << " clients, "
+                  << all.size() << " requests, p50 " << p50 << " us, p99 " << p99
+                  << " us, max " << maxUs << " us, " << all.size() / secs << " req/s\n";
+    }
+
+    DaemonClient stopper(socketPath);
+    DaemonRequest stop;
+    stop.kind = RequestKind::Shutdown;
+    stopper.request(stop);
+    server.join();
+    return 0;
+}
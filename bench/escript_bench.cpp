@@ -0,0 +1,210 @@
+// Per-phase compiler benchmark with JSON output
+// Usage: escript_bench [--sizes=1000,10000,100000,1000000] [--iterations=N]
+//                      [--json=results.json] [workload options, see escript_gen]
+// Generates one synthetic workload per size and times tokenize,
+// Parser::parse, generateIR and emitNASM separately (best of N runs).
+// Each phase reports time, throughput, heap allocations and peak RSS.
+// JSON goes to stdout unless --json is given; progress goes to stderr.
+
+#include "workload.hpp"
+#include "../src/all.hpp"
+#include "../src/driver.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+static std::atomic<uint64_t> gAllocations{0};
+static std::atomic<uint64_t> gAllocatedBytes{0};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(size_t size) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    gAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+using namespace EScript;
+
+static uint64_t peakRssKB() {
+#ifdef _WIN32
+    return 0;
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+}
+
+struct PhaseResult {
+    const char* name;
+    double seconds = 0.0;
+    uint64_t items = 0;         // tokens, operations or instructions
+    uint64_t bytes = 0;         // input bytes (output bytes for emitNASM)
+    uint64_t allocs = 0;
+    uint64_t allocBytes = 0;
+    uint64_t peakRss = 0;
+};
+
+// Runs body `iterations` times; keeps the fastest time and the
+// allocations of the last run. setup runs untimed before each body.
+static void measure(PhaseResult& r, int iterations, const std::function<void()>& setup,
+                    const std::function<uint64_t()>& body) {
+    for (int i = 0; i < iterations; ++i) {
+        setup();
+        uint64_t allocs = gAllocations.load();
+        uint64_t bytes = gAllocatedBytes.load();
+        auto start = std::chrono::steady_clock::now();
+        r.items = body();
+        auto end = std::chrono::steady_clock::now();
+        r.allocs = gAllocations.load() - allocs;
+        r.allocBytes = gAllocatedBytes.load() - bytes;
+
+        double secs = std::chrono::duration<double>(end - start).count();
+        if (i == 0 || secs < r.seconds) r.seconds = secs;
+    }
+    r.peakRss = peakRssKB();
+}
+
+static std::vector<size_t> parseSizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::stringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        size_t n = std::strtoull(item.c_str(), nullptr, 10);
+        if (n == 0) throw std::runtime_error("Invalid size: " + item);
+        sizes.push_back(n);
+    }
+    return sizes;
+}
+
+static void writePhase(std::ostream& out, const PhaseResult& r) {
+    double secs = r.seconds > 0 ? r.seconds : 1e-9;
+    out << "\"" << r.name << "\":{\"seconds\":" << r.seconds
+        << ",\"items\":" << r.items
+        << ",\"items_per_sec\":" << r.items / secs
+        << ",\"bytes\":" << r.bytes
+        << ",\"mb_per_sec\":" << r.bytes / secs / 1e6
+        << ",\"allocs\":" << r.allocs
+        << ",\"alloc_bytes\":" << r.allocBytes
+        << ",\"peak_rss_kb\":" << r.peakRss << "}";
+}
+
+int main(int argc, char** argv) {
+    try {
+        std::vector<size_t> sizes = {1000, 10000, 100000, 1000000};
+        int iterations = 3;
+        std::string jsonFile;
+        WorkloadMix mix;
+
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.rfind("--sizes=", 0) == 0) sizes = parseSizes(arg.substr(8));
+            else if (arg.rfind("--iterations=", 0) == 0) iterations = std::max(1, std::atoi(arg.c_str() + 13));
+            else if (arg.rfind("--json=", 0) == 0) jsonFile = arg.substr(7);
+            else if (!parseWorkloadOption(arg, mix)) {
+                std::cerr << "Unknown option: " << arg << "\n";
+                return 1;
+            }
+        }
+
+        const std::string asmFile =
+            (std::filesystem::temp_directory_path() / "escript_bench.asm").string();
+
+        std::ostringstream json;
+        json.precision(6);
+        json << "{\"compiler\":\"" << kCompilerVersion << "\",\"iterations\":" << iterations
+             << ",\"workload\":" << workloadJson(mix) << ",\"runs\":[";
+
+        for (size_t s = 0; s < sizes.size(); ++s) {
+            const size_t statements = sizes[s];
+            std::string source = generateWorkload(statements, mix);
+
+            PhaseResult lex{"tokenize"};
+            PhaseResult parse{"parse"};
+            PhaseResult lower{"generateIR"};
+            PhaseResult emit{"emitNASM"};
+
+            std::vector<Token> tokens;
+            measure(lex, iterations, [&] { tokens.clear(); tokens.shrink_to_fit(); },
+                    [&] { tokens = tokenize(source); return tokens.size(); });
+            lex.bytes = source.size();
+
+            std::unique_ptr<Parser> parser;
+            std::unique_ptr<Program> prog;
+            measure(parse, iterations, [&] { prog.reset(); parser = std::make_unique<Parser>(source, tokens); },
+                    [&] { prog = parser->parse(); return prog->size(); });
+            parse.bytes = source.size();
+
+            IRProgram ir;
+            measure(lower, iterations, [&] { ir = IRProgram(); },
+                    [&] { ir = generateIR(*prog); return ir.size(); });
+            lower.bytes = source.size();
+
+            std::ostream quiet(nullptr);
+            measure(emit, iterations, [] {},
+                    [&] { emitNASM(ir, asmFile, {}, quiet); return ir.size(); });
+            emit.bytes = std::filesystem::file_size(asmFile);
+
+            std::cerr << "[Bench] " << statements << " statements, " << source.size() << " bytes:";
+            for (const PhaseResult* r : {&lex, &parse, &lower, &emit}) {
+                std::cerr << " " << r->name << " " << r->seconds * 1000.0 << " ms";
+            }
+            std::cerr << "\n";
+
+            json << (s ? "," : "") << "\n{\"statements\":" << statements
+                 << ",\"source_bytes\":" << source.size() << ",\"phases\":{";
+            writePhase(json, lex);
+            json << ",";
+            writePhase(json, parse);
+            json << ",";
+            writePhase(json, lower);
+            json << ",";
+            writePhase(json, emit);
+            json << "}}";
+        }
+        json << "\n]}\n";
+
+        std::error_code ec;
+        std::filesystem::remove(asmFile, ec);
+
+        if (jsonFile.empty()) {
+            std::cout << json.str();
+        }
+        else {
+            std::ofstream out(jsonFile);
+            out << json.str();
+            if (!out) {
+                std::cerr << "Error: Cannot write " << jsonFile << "\n";
+                return 1;
+            }
+        }
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
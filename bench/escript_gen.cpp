@@ -0,0 +1,58 @@
+// Synthetic .es workload generator
+// Usage: escript_gen <statements> [-o out.es] [--mix=modify=4,lane=2,...]
+//                    [--comments=N] [--long-strings=N] [--long-string-bytes=N]
+//                    [--lanes=N] [--containers=N] [--seed=N]
+// Writes to stdout without -o. Percentages are per statement.
+
+#include "workload.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+    try {
+        size_t statements = 0;
+        std::string output;
+        WorkloadMix mix;
+
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "-o" && i + 1 < argc) {
+                output = argv[++i];
+            }
+            else if (parseWorkloadOption(arg, mix)) {
+            }
+            else if (!arg.empty() && arg[0] != '-') {
+                statements = std::strtoull(arg.c_str(), nullptr, 10);
+            }
+            else {
+                std::cerr << "Unknown option: " << arg << "\n";
+                return 1;
+            }
+        }
+        if (statements == 0) {
+            std::cerr << "Usage: escript_gen <statements> [-o out.es] [--mix=...] [--comments=N]\n";
+            return 1;
+        }
+
+        std::string source = generateWorkload(statements, mix);
+        std::FILE* out = output.empty() ? stdout : std::fopen(output.c_str(), "wb");
+        if (!out) {
+            std::cerr << "Error: Cannot open file for writing: " << output << "\n";
+            return 1;
+        }
+        bool ok = std::fwrite(source.data(), 1, source.size(), out) == source.size();
+        if (out != stdout) ok = std::fclose(out) == 0 && ok;
+        if (!ok) {
+            std::cerr << "Error: Failed writing workload\n";
+            return 1;
+        }
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,93 @@
+// Parallel front-end scaling benchmark
+// Usage: frontend_bench [statements] [max_threads]
+// Generates a workload of `statements` statements, then times tokenize +
+// Parser::parse against parseParallel on 1, 2, 4 ... max_threads
+// workers. Every parallel result is compared with the serial one token
+// by token and node by node.
+
+#include "../src/all.hpp"
+#include "../src/frontend.hpp"
+#include "workload.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace EScript;
+
+static bool sameView(std::string_view a, std::string_view b) {
+    return a.data() == b.data() && a.size() == b.size();
+}
+
+static bool sameProgram(const Program& a, const Program& b) {
+    if (a.nodeCount != b.nodeCount || a.opCount != b.opCount) return false;
+    if (std::memcmp(a.ops, b.ops, a.opCount * sizeof(uint32_t)) != 0) return false;
+    for (uint32_t i = 0; i < a.nodeCount; ++i) {
+        const Operation& x = a.nodes[i];
+        const Operation& y = b.nodes[i];
+        if (!sameView(x.op, y.op) || !sameView(x.ident, y.ident) || !sameView(x.value, y.value) ||
+            x.nested != y.nested || x.line != y.line || x.column != y.column || x.kind != y.kind) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool sameTokens(const std::vector<Token>& a, const std::vector<Token>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].offset != b[i].offset || a[i].length != b[i].length || a[i].line != b[i].line ||
+            a[i].column != b[i].column || a[i].kind != b[i].kind) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    try {
+        size_t statements = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+        size_t maxThreads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+        if (statements < 1) statements = 1;
+        if (maxThreads < 1) maxThreads = 1;
+
+        WorkloadMix mix;
+        const std::string source = generateWorkload(statements, mix);
+        std::cout << "[Bench] " << statements << " statements, " << source.size() / (1024 * 1024) << " MB, "
+                  << std::thread::hardware_concurrency() << " cores\n";
+
+        const auto serialTokens = tokenize(source);
+        auto start = std::chrono::steady_clock::now();
+        Parser parser(source, tokenize(source));
+        auto serial = parser.parse();
+        double serialMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "[Bench] Serial: " << serialMs << " ms, " << source.size() / serialMs / 1e3 << " MB/s\n";
+
+        for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+            double best = 0.0;
+            ParallelParse result;
+            for (int i = 0; i < 3; ++i) {
+                start = std::chrono::steady_clock::now();
+                result = parseParallel(source, threads);
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                if (i == 0 || ms < best) best = ms;
+            }
+            std::vector<Token> tokens;
+            result = parseParallel(source, threads, &tokens);
+            if (!sameProgram(*serial, *result.program) || !sameTokens(serialTokens, tokens)) {
+                std::cerr << "Error: " << threads << " threads differ from the serial front end\n";
+                return 1;
+            }
+            std::cout << "[Bench] " << threads << " threads, " << result.chunks << " chunks: " << best << " ms, "
+                      << source.size() / best / 1e3 << " MB/s (" << serialMs / best << "x)\n";
+        }
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,165 @@
+// Incremental re-lex / re-parse benchmark
+// Usage: incremental_bench [statements] [edits]
+// Loads a synthetic workload into an IncrementalDocument and times small
+// edits at random statements against lexing and parsing the whole file
+// again: typing inside a statement, inserting and deleting a statement,
+// and opening and closing a "**" comment, which re-lexes up to wherever
+// the comment now ends. Every edit is undone again; the first few are
+// checked against a full tokenize of the document's text. Random edit
+// sequences on small documents, splicing in '#', '"', "**" and
+// newlines, are then checked after every edit.
+
+#include "../src/all.hpp"
+#include "../src/incremental.hpp"
+#include "workload.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace EScript;
+
+static double elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool sameTokens(const IncrementalDocument& doc) {
+    // The tolerant lexer: random edits leave strings and comments open
+    std::string text = doc.text();
+    LexStatus status;
+    std::vector<Token> expect = tokenize(text, status);
+    std::vector<Token> got = doc.tokens();
+    if (expect.size() != got.size()) return false;
+    for (size_t i = 0; i < got.size(); ++i) {
+        if (got[i].offset != expect[i].offset || got[i].length != expect[i].length ||
+            got[i].line != expect[i].line || got[i].column != expect[i].column || got[i].kind != expect[i].kind) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Applies random edits to small documents, comparing the tokens
+// with a full tokenize after each one; returns the failing sequence's
+// seed, or 0
+static uint64_t randomEdits(size_t sequences, size_t edits) {
+    static const char* const pieces[] = {
+        "#", "\"", "**", "\n", " ", "x", "lane y1 adjust q 2 #\n", "create a 1 #", "process write \"s\" #",
+        "sync y1 #\n", "\"open", "** note **",
+    };
+    for (uint64_t seed = 1; seed <= sequences; ++seed) {
+        uint64_t rng = seed * 0x9E3779B97F4A7C15ull;
+        auto next = [&](size_t n) {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            return static_cast<size_t>(rng % n);
+        };
+        IncrementalDocument doc("create a 1 #\nx#");
+        for (size_t e = 0; e < edits; ++e) {
+            const size_t offset = next(doc.size() + 1);
+            const size_t length = next(3) == 0 ? next(doc.size() - offset + 1) : 0;
+            doc.edit(offset, std::min<size_t>(length, 8), pieces[next(std::size(pieces))]);
+            if (!sameTokens(doc)) return seed;
+        }
+    }
+    return 0;
+}
+
+struct Timings {
+    std::vector<double> us;
+    size_t relexed = 0;
+
+    void report(const char* name) {
+        std::sort(us.begin(), us.end());
+        std::cout << "[Bench] " << name << ": median " << us[us.size() / 2] << " us, max " << us.back()
+                  << " us, " << relexed / us.size() << " bytes re-lexed per edit\n";
+    }
+};
+
+int main(int argc, char** argv) {
+    try {
+        size_t statements = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+        size_t edits = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+        if (statements < 1) statements = 1;
+        if (edits < 1) edits = 1;
+
+        WorkloadMix mix;
+        const std::string source = generateWorkload(statements, mix);
+        const size_t lines = static_cast<size_t>(std::count(source.begin(), source.end(), '\n'));
+
+        auto start = std::chrono::steady_clock::now();
+        IncrementalDocument doc(source);
+        double loadMs = elapsedUs(start) / 1000.0;
+
+        start = std::chrono::steady_clock::now();
+        {
+            auto tokens = tokenize(source);
+            Parser parser(source, tokens);
+            auto prog = parser.parse();
+        }
+        double fullUs = elapsedUs(start);
+
+        std::cout << "[Bench] " << lines << " lines, " << doc.statementCount() << " statements, "
+                  << source.size() / 1024 << " KB, load " << loadMs << " ms\n";
+        std::cout << "[Bench] Full re-lex and re-parse: " << fullUs << " us\n";
+
+        uint64_t rng = 88172645463325252ull;
+        auto pick = [&] {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            return static_cast<size_t>(rng % doc.statementCount());
+        };
+        size_t checked = 0;
+        bool ok = true;
+        auto timed = [&](Timings& t, size_t offset, size_t length, std::string_view text) {
+            auto begin = std::chrono::steady_clock::now();
+            DocumentEdit e = doc.edit(offset, length, text);
+            t.us.push_back(elapsedUs(begin));
+            t.relexed += e.relexed;
+            if (checked < 8) {
+                ok = ok && sameTokens(doc);
+                checked++;
+            }
+        };
+
+        Timings typing, statement, comment;
+        const std::string line = "modify bench_counter 7 #\n";
+        for (size_t i = 0; i < edits; ++i) {
+            DocumentStatement st = doc.statement(pick());
+            size_t middle = st.offset + st.source.size() / 2;
+            timed(typing, middle, 0, "x");
+            timed(typing, middle, 1, "");
+
+            st = doc.statement(pick());
+            timed(statement, st.offset, 0, line);
+            timed(statement, st.offset, line.size(), "");
+
+            st = doc.statement(pick());
+            timed(comment, st.offset, 0, "**");
+            timed(comment, st.offset, 2, "");
+        }
+        typing.report("Type inside a statement");
+        statement.report("Insert/delete a statement");
+        comment.report("Open/close a ** comment");
+
+        if (!ok || doc.text() != source || !sameTokens(doc)) {
+            std::cerr << "Error: incremental tokens differ from a full tokenize\n";
+            return 1;
+        }
+        const size_t sequences = 200;
+        if (uint64_t seed = randomEdits(sequences, 60)) {
+            std::cerr << "Error: random edit sequence " << seed << " differs from a full tokenize\n";
+            return 1;
+        }
+        std::cout << "[Bench] " << sequences << " random edit sequences match a full tokenize\n";
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
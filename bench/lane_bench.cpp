@@ -0,0 +1,91 @@
+// Lane runtime scaling benchmark
+// Usage: lane_bench [max_lanes] [writes_per_lane] [pin]
+// Builds programs where N lanes each issue the same number of
+// `process write` statements, compiles them with the direct backend and
+// times the executables with stdout sent to /dev/null. Total work grows
+// with N, so perfect scaling keeps the wall time flat. Passing "pin"
+// pins lane k to core k % cores.
+
+#include "../src/all.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using namespace EScript;
+
+static std::string laneScript(size_t lanes, size_t writes) {
+    std::string src;
+    for (size_t w = 0; w < writes; ++w) {
+        for (size_t l = 0; l < lanes; ++l) {
+            src += "lane y" + std::to_string(l) +
+                   " process write \"lane " + std::to_string(l) + " record " + std::to_string(w) + "\" #\n";
+        }
+    }
+    src += "sync lanes #\n";
+    return src;
+}
+
+static double runSeconds(const std::string& exe) {
+    std::string cmd = "./" + exe + " > /dev/null";
+    auto start = std::chrono::steady_clock::now();
+    int status = std::system(cmd.c_str());
+    auto end = std::chrono::steady_clock::now();
+    if (status != 0) {
+        throw std::runtime_error("Benchmark program failed: " + exe);
+    }
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+#ifdef _WIN32
+    std::cout << "[Bench] Lane runtime requires Linux\n";
+    return 0;
+#else
+    size_t maxLanes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 8;
+    size_t writes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+    bool pin = argc > 3 && std::string(argv[3]) == "pin";
+    if (maxLanes < 1) maxLanes = 1;
+
+    const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "[Bench] " << cores << " cores, " << writes << " writes per lane"
+              << (pin ? ", pinned" : "") << "\n";
+
+    const std::string exe = "lane_bench_prog";
+    double base = 0.0;
+    for (size_t lanes = 1; lanes <= maxLanes; lanes *= 2) {
+        std::string source = laneScript(lanes, writes);
+        auto tokens = tokenize(source);
+        Parser parser(source, tokens);
+        auto prog = parser.parse();
+        IRProgram ir = generateIR(*prog);
+
+        CodegenOptions opts;
+        if (pin) {
+            for (size_t c = 0; c < cores; ++c) opts.laneCores.push_back(static_cast<int>(c));
+        }
+        std::ostringstream log;
+        emitDirect(ir, exe, opts, log);
+
+        // Best of three runs
+        double best = 0.0;
+        for (int i = 0; i < 3; ++i) {
+            double secs = runSeconds(exe);
+            if (i == 0 || secs < best) best = secs;
+        }
+        if (lanes == 1) base = best;
+
+        double total = static_cast<double>(lanes * writes);
+        std::cout << "[Bench] Lanes " << lanes << ": " << best * 1000.0 << " ms, "
+                  << total / best / 1e6 << " M writes/s, scaling "
+                  << (base * lanes) / best << "x\n";
+    }
+    std::remove(exe.c_str());
+    return 0;
+#endif
+}
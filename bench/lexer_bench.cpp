@@ -0,0 +1,66 @@
+// Lexer throughput benchmark
+// Usage: lexer_bench [input.es] [iterations]
+// Without an input file a synthetic runbook is generated in memory.
+
+#include "../src/all.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using namespace EScript;
+
+static std::string syntheticScript(size_t statements) {
+    std::string src = "* Synthetic lexer benchmark\n\n";
+    for (size_t i = 0; i < statements; ++i) {
+        const std::string id = std::to_string(i);
+        switch (i % 6) {
+        case 0: src += "create counter_" + id + " 0 #\n"; break;
+        case 1: src += "modify counter_" + id + " 42 #\n"; break;
+        case 2: src += "adjust threshold-" + id + " 85.5 #\n"; break;
+        case 3: src += "process write \"Status line " + id + " \\\"ok\\\"\" #\n"; break;
+        case 4: src += "lane y" + std::to_string(i % 8) + " process analyze \"batch\" #\n"; break;
+        case 5: src += "** block " + id + "\n   spanning lines **\nsync lanes # * trailing\n"; break;
+        }
+    }
+    return src;
+}
+
+int main(int argc, char** argv) {
+    std::string source;
+    if (argc > 1) {
+        std::ifstream in(argv[1]);
+        if (!in) {
+            std::cerr << "Error: Cannot open file: " << argv[1] << "\n";
+            return 1;
+        }
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        source = buffer.str();
+    } else {
+        source = syntheticScript(100000);
+    }
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 10;
+    if (iterations < 1) iterations = 1;
+
+    size_t tokenCount = 0;
+    double best = 0.0;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        auto tokens = tokenize(source);
+        auto end = std::chrono::steady_clock::now();
+
+        double secs = std::chrono::duration<double>(end - start).count();
+        if (i == 0 || secs < best) best = secs;
+        tokenCount = tokens.size();
+    }
+
+    double mb = source.size() / (1024.0 * 1024.0);
+    std::cout << "[Bench] Lexer input: " << source.size() << " bytes, "
+              << tokenCount << " tokens\n";
+    std::cout << "[Bench] Best of " << iterations << ": " << best * 1000.0 << " ms, "
+              << (best > 0.0 ? mb / best : 0.0) << " MB/s\n";
+    return 0;
+}
@@ -0,0 +1,74 @@
+// Parser allocation and throughput benchmark
+// Usage: parser_bench [iterations]
+// Counts heap allocations made by Parser::parse() for growing inputs;
+// with the arena-backed AST the count stays constant.
+
+#include "../src/all.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+static std::atomic<size_t> gAllocations{0};
+
+void* operator new(size_t size) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+using namespace EScript;
+
+static std::string syntheticScript(size_t statements) {
+    std::string src;
+    for (size_t i = 0; i < statements; ++i) {
+        const std::string id = std::to_string(i);
+        switch (i % 5) {
+        case 0: src += "create counter_" + id + " 0 #\n"; break;
+        case 1: src += "modify counter_" + id + " 42 #\n"; break;
+        case 2: src += "process write \"line " + id + "\" #\n"; break;
+        case 3: src += "lane y" + std::to_string(i % 8) + " process analyze \"batch\" #\n"; break;
+        case 4: src += "sync lanes #\n"; break;
+        }
+    }
+    return src;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 5;
+    if (iterations < 1) iterations = 1;
+
+    for (size_t statements : {1000u, 10000u, 100000u, 1000000u}) {
+        std::string source = syntheticScript(statements);
+        auto tokens = tokenize(source);
+
+        double best = 0.0;
+        size_t allocations = 0;
+        size_t chunks = 0;
+        size_t ops = 0;
+        for (int i = 0; i < iterations; ++i) {
+            Parser parser(source, tokens);
+            size_t before = gAllocations.load();
+            auto start = std::chrono::steady_clock::now();
+            auto prog = parser.parse();
+            auto end = std::chrono::steady_clock::now();
+            allocations = gAllocations.load() - before;
+
+            double secs = std::chrono::duration<double>(end - start).count();
+            if (i == 0 || secs < best) best = secs;
+            chunks = prog->arena.chunkCount();
+            ops = prog->size();
+        }
+
+        std::cout << "[Bench] Parser " << statements << " statements: "
+                  << ops << " ops, " << best * 1000.0 << " ms, "
+                  << allocations << " allocations, "
+                  << chunks << " arena chunks\n";
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Pool import benchmark
+// Usage: pool_bench [entries] [calls]
+// Builds a pool source with `entries` defines of three statements each,
+// then compares two ways for a program to call `calls` of them: reparsing
+// the pool's source together with the program (the text import the
+// README describes), and `use pool` against the compiled .pool image,
+// which maps the file and materializes only the called entries.
+
+#include "../src/all.hpp"
+#include "../src/pool.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace EScript;
+
+static double bestMs(int runs, const std::function<size_t()>& body, size_t& result) {
+    double best = 0.0;
+    for (int i = 0; i < runs; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        result = body();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (i == 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    try {
+        size_t entries = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50000;
+        size_t calls = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100;
+        if (entries < 1) entries = 1;
+        if (calls > entries) calls = entries;
+
+        std::string poolSource;
+        for (size_t e = 0; e < entries; ++e) {
+            std::string name = "entry" + std::to_string(e);
+            poolSource += "define " + name + " create c" + std::to_string(e) + " 1 #\n";
+            poolSource += "define " + name + " modify c" + std::to_string(e) + " 2 #\n";
+            poolSource += "define " + name + " process write \"" + name + " done\" #\n";
+        }
+        std::string callSource;
+        for (size_t c = 0; c < calls; ++c) {
+            callSource += "call entry" + std::to_string(c * (entries / calls)) + " #\n";
+        }
+
+        const auto dir = std::filesystem::temp_directory_path();
+        const std::string poolFile = (dir / "bench.pool").string();
+        {
+            auto tokens = tokenize(poolSource);
+            Parser parser(poolSource, tokens);
+            auto prog = parser.parse();
+            std::vector<PoolEntryRange> ranges;
+            IRProgram ir = generatePoolIR(*prog, ranges);
+            writePool(ir, ranges, poolFile);
+        }
+
+        std::cout << "[Bench] " << entries << " entries, " << calls << " calls, pool image "
+                  << std::filesystem::file_size(poolFile) / 1024 << " KB\n";
+
+        // Text import: the program and the whole pool source go through
+        // the front end together
+        const std::string textProgram = poolSource + callSource;
+        size_t textInstrs = 0;
+        double textMs = bestMs(3, [&] {
+            auto tokens = tokenize(textProgram);
+            Parser parser(textProgram, tokens);
+            auto prog = parser.parse();
+            return generateIR(*prog).size();
+        }, textInstrs);
+
+        // Binary import: only the call statements are parsed
+        const std::string poolProgram = "use pool \"bench\" #\n" + callSource;
+        size_t poolInstrs = 0;
+        double poolMs = bestMs(3, [&] {
+            auto tokens = tokenize(poolProgram);
+            Parser parser(poolProgram, tokens);
+            auto prog = parser.parse();
+            PoolSet pools({dir.string()});
+            return generateIR(*prog, &pools).size();
+        }, poolInstrs);
+
+        if (textInstrs != poolInstrs) {
+            std::cerr << "Error: imports disagree (" << textInstrs << " vs " << poolInstrs << " instructions)\n";
+            return 1;
+        }
+        std::cout << "[Bench] Reparse source: " << textMs << " ms\n";
+        std::cout << "[Bench] use pool:       " << poolMs << " ms (" << textMs / poolMs << "x)\n";
+
+        std::remove(poolFile.c_str());
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,150 @@
+#include "workload.hpp"
+#include <stdexcept>
+
+namespace {
+
+// xorshift64*: fast, and identical on every platform
+class Random {
+    uint64_t state;
+
+public:
+    explicit Random(uint64_t seed) : state(seed ? seed : 0x9E3779B97F4A7C15ull) {}
+
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1Dull;
+    }
+
+    uint64_t below(uint64_t n) { return n ? next() % n : 0; }
+};
+
+uint64_t parseNumber(const std::string& text, const std::string& option) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+        throw std::runtime_error("Invalid value for " + option + ": " + text);
+    }
+    return std::stoull(text);
+}
+
+void parseMix(const std::string& spec, WorkloadMix& mix) {
+    size_t pos = 0;
+    while (pos < spec.size()) {
+        size_t comma = spec.find(',', pos);
+        if (comma == std::string::npos) comma = spec.size();
+        std::string item = spec.substr(pos, comma - pos);
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+            throw std::runtime_error("Invalid mix entry: " + item);
+        }
+        std::string kind = item.substr(0, eq);
+        unsigned weight = static_cast<unsigned>(parseNumber(item.substr(eq + 1), "--mix"));
+        if (kind == "create") mix.create = weight;
+        else if (kind == "modify") mix.modify = weight;
+        else if (kind == "adjust") mix.adjust = weight;
+        else if (kind == "process") mix.process = weight;
+        else if (kind == "lane") mix.lane = weight;
+        else if (kind == "sync") mix.sync = weight;
+        else throw std::runtime_error("Unknown statement kind in mix: " + kind);
+        pos = comma + 1;
+    }
+}
+
+} // namespace
+
+bool parseWorkloadOption(const std::string& arg, WorkloadMix& mix) {
+    auto value = [&](const char* prefix) -> const char* {
+        size_t n = std::char_traits<char>::length(prefix);
+        return arg.compare(0, n, prefix) == 0 ? arg.c_str() + n : nullptr;
+    };
+
+    if (const char* v = value("--mix=")) parseMix(v, mix);
+    else if (const char* v = value("--comments=")) mix.commentPercent = static_cast<unsigned>(parseNumber(v, "--comments"));
+    else if (const char* v = value("--long-strings=")) mix.longStringPercent = static_cast<unsigned>(parseNumber(v, "--long-strings"));
+    else if (const char* v = value("--long-string-bytes=")) mix.longStringBytes = parseNumber(v, "--long-string-bytes");
+    else if (const char* v = value("--lanes=")) mix.lanes = static_cast<unsigned>(parseNumber(v, "--lanes"));
+    else if (const char* v = value("--containers=")) mix.containers = parseNumber(v, "--containers");
+    else if (const char* v = value("--seed=")) mix.seed = parseNumber(v, "--seed");
+    else return false;
+
+    if (mix.create + mix.modify + mix.adjust + mix.process + mix.lane + mix.sync == 0) {
+        throw std::runtime_error("Workload mix has no statements");
+    }
+    return true;
+}
+
+std::string workloadJson(const WorkloadMix& mix) {
+    std::string out = "{";
+    out += "\"create\":" + std::to_string(mix.create);
+    out += ",\"modify\":" + std::to_string(mix.modify);
+    out += ",\"adjust\":" + std::to_string(mix.adjust);
+    out += ",\"process\":" + std::to_string(mix.process);
+    out += ",\"lane\":" + std::to_string(mix.lane);
+    out += ",\"sync\":" + std::to_string(mix.sync);
+    out += ",\"comment_percent\":" + std::to_string(mix.commentPercent);
+    out += ",\"long_string_percent\":" + std::to_string(mix.longStringPercent);
+    out += ",\"long_string_bytes\":" + std::to_string(mix.longStringBytes);
+    out += ",\"lanes\":" + std::to_string(mix.lanes);
+    out += ",\"containers\":" + std::to_string(mix.containers);
+    out += ",\"seed\":" + std::to_string(mix.seed);
+    out += "}";
+    return out;
+}
+
+std::string generateWorkload(size_t statements, const WorkloadMix& mix) {
+    Random rng(mix.seed);
+    const unsigned weights[] = {mix.create, mix.modify, mix.adjust, mix.process, mix.lane, mix.sync};
+    unsigned totalWeight = 0;
+    for (unsigned w : weights) totalWeight += w;
+    if (totalWeight == 0) {
+        throw std::runtime_error("Workload mix has no statements");
+    }
+
+    std::string longText;
+    for (size_t i = 0; i < mix.longStringBytes; ++i) {
+        longText.push_back(static_cast<char>('a' + i % 26));
+    }
+
+    const unsigned lanes = mix.lanes ? mix.lanes : 1;
+    const size_t containers = mix.containers ? mix.containers : 1;
+    auto container = [&] { return "c_" + std::to_string(rng.below(containers)); };
+    auto number = [&] { return std::to_string(rng.below(100000)); };
+    auto write = [&](size_t i) {
+        if (rng.below(100) < mix.longStringPercent) {
+            return "process write \"" + longText + "\" #\n";
+        }
+        return "process write \"line " + std::to_string(i) + "\" #\n";
+    };
+
+    std::string src = "* Synthetic E-Script workload\n\n";
+    src.reserve(statements * 28 + statements * mix.longStringPercent * mix.longStringBytes / 100);
+    for (size_t i = 0; i < statements; ++i) {
+        if (rng.below(100) < mix.commentPercent) {
+            if (rng.below(4) == 0) {
+                src += "** block comment " + std::to_string(i) + "\n   spanning lines **\n";
+            } else {
+                src += "* note " + std::to_string(i) + "\n";
+            }
+        }
+
+        unsigned pick = static_cast<unsigned>(rng.below(totalWeight));
+        size_t kind = 0;
+        while (pick >= weights[kind]) {
+            pick -= weights[kind];
+            kind++;
+        }
+
+        switch (kind) {
+        case 0: src += "create " + container() + " " + number() + " #\n"; break;
+        case 1: src += "modify " + container() + " " + number() + " #\n"; break;
+        case 2: src += "adjust " + container() + " " + number() + ".5 #\n"; break;
+        case 3: src += write(i); break;
+        case 4: src += "lane y" + std::to_string(rng.below(lanes)) + " " + write(i); break;
+        case 5:
+            if (rng.below(2) == 0) src += "sync lanes #\n";
+            else src += "sync y" + std::to_string(rng.below(lanes)) + " #\n";
+            break;
+        }
+    }
+    return src;
+}
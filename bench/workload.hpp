@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Synthetic .es workload generator shared by escript_bench and
+// escript_gen. Output is deterministic for a given size and mix.
+
+struct WorkloadMix {
+    // Relative statement weights
+    unsigned create = 1;
+    unsigned modify = 4;
+    unsigned adjust = 2;
+    unsigned process = 3;
+    unsigned lane = 1;
+    unsigned sync = 1;
+
+    unsigned commentPercent = 5;        // statements preceded by a comment
+    unsigned longStringPercent = 1;     // process writes with a long literal
+    size_t longStringBytes = 512;
+    unsigned lanes = 8;                 // distinct lane names
+    size_t containers = 1024;           // distinct container names
+    uint64_t seed = 1;
+};
+
+// Applies one command-line option (--mix=modify=4,lane=2, --comments=N,
+// --long-strings=N, --long-string-bytes=N, --lanes=N, --containers=N,
+// --seed=N). Returns false if arg is not a workload option; throws
+// std::runtime_error on a malformed value.
+bool parseWorkloadOption(const std::string& arg, WorkloadMix& mix);
+
+// The mix as a JSON object
+std::string workloadJson(const WorkloadMix& mix);
+
+std::string generateWorkload(size_t statements, const WorkloadMix& mix);
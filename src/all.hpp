@@ -5,13 +5,21 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <string_view>
 #include "tokens.hpp"
 #include "parser.hpp"
 #include "ir.hpp"
+#include "source.hpp"
 
 namespace EScript {
 
 // Forward declaration of lexer
-std::vector<Token> tokenize(const std::string& src);
+std::vector<Token> tokenize(std::string_view src);
+
+// Lexes like tokenize but never throws on bad input: unknown characters
+// are skipped and an unterminated string ends the scan, each recorded in
+// status. The incremental front end uses openComment and openString to
+// tell whether text after src could change the tokens.
+std::vector<Token> tokenize(std::string_view src, LexStatus& status);
 
 } // namespace EScript
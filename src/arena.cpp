@@ -0,0 +1,16 @@
+#include "arena.hpp"
+
+namespace EScript {
+
+Arena::Arena(size_t chunkBytes)
+    : cursor(nullptr), limit(nullptr), chunkSize(chunkBytes), bytesUsed(0) {}
+
+void Arena::grow(size_t minBytes) {
+    // Oversized requests get a dedicated chunk
+    size_t size = minBytes > chunkSize ? minBytes : chunkSize;
+    chunks.emplace_back(new char[size]);
+    cursor = chunks.back().get();
+    limit = cursor + size;
+}
+
+} // namespace EScript
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace EScript {
+
+// Bump allocator for compile-lifetime data. Memory is handed out from
+// large chunks and released all at once when the arena is destroyed,
+// so only trivially destructible objects may live in it.
+class Arena {
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char* cursor;
+    char* limit;
+    size_t chunkSize;
+    size_t bytesUsed;
+
+    void grow(size_t minBytes);
+
+public:
+    explicit Arena(size_t chunkBytes = 64 * 1024);
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t)) {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(cursor) + (align - 1)) & ~(uintptr_t)(align - 1);
+        if (!cursor || p + bytes > reinterpret_cast<uintptr_t>(limit)) {
+            grow(bytes + align);
+            p = (reinterpret_cast<uintptr_t>(cursor) + (align - 1)) & ~(uintptr_t)(align - 1);
+        }
+        cursor = reinterpret_cast<char*>(p + bytes);
+        bytesUsed += bytes;
+        return reinterpret_cast<void*>(p);
+    }
+
+    // Default-constructs count objects of T in one contiguous block
+    template<typename T>
+    T* allocateArray(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "Arena objects are never destroyed individually");
+        T* arr = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        for (size_t i = 0; i < count; ++i) {
+            new (&arr[i]) T();
+        }
+        return arr;
+    }
+
+    size_t chunkCount() const { return chunks.size(); }
+    size_t bytesAllocated() const { return bytesUsed; }
+};
+
+} // namespace EScript
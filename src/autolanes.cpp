@@ -0,0 +1,321 @@
+#include "autolanes.hpp"
+#include "storage.hpp"
+#include <algorithm>
+#include <queue>
+#include <string>
+#include <unordered_map>
+
+namespace EScript {
+
+namespace {
+
+constexpr uint32_t kNone = UINT32_MAX;
+
+// Output and input streams; containers and files are numbered after them
+constexpr uint32_t kStdout = 0;
+constexpr uint32_t kStdin = 1;
+
+class Resources {
+public:
+    uint32_t container(std::string_view name) { return id(containers, name); }
+    uint32_t file(std::string_view path) { return id(files, path); }
+    size_t size() const { return next; }
+
+private:
+    std::unordered_map<std::string_view, uint32_t> containers;
+    std::unordered_map<std::string_view, uint32_t> files;
+    uint32_t next = 2;
+
+    uint32_t id(std::unordered_map<std::string_view, uint32_t>& names, std::string_view name) {
+        auto it = names.emplace(name, next).first;
+        if (it->second == next) next++;
+        return it->second;
+    }
+};
+
+// What instruction i reads and writes, as the interpreter executes it
+InstrEffects effectsOf(const IRProgram& ir, size_t i, Resources& res) {
+    const IRInstr in = ir.at(i);
+    InstrEffects fx;
+
+    const ContainerAccess access = containerAccess(ir, i);
+    for (uint8_t r = 0; r < access.readCount; ++r) fx.reads.push_back(res.container(access.reads[r]));
+    if (access.writes) fx.writes.push_back(res.container(access.written));
+
+    // Files and the streams: output and line reads keep their order
+    if (in.op == IROp::PROCESS) {
+        std::string_view action = ir.text(in.arg1);
+        const bool literal = ir.symbols.isString(in.arg2);
+        if (action == "write" && (literal || access.readCount > 0)) {
+            fx.writes.push_back(kStdout);
+        } else if (action == "read" && literal) {
+            fx.reads.push_back(res.file(unquote(ir.text(in.arg2))));
+        } else if (action == "read" && access.writes) {
+            fx.writes.push_back(kStdin);
+        }
+    }
+    return fx;
+}
+
+// Rough relative cost of running an instruction: reading a file is
+// worth several stores
+uint64_t costOf(const IRProgram& ir, size_t i) {
+    if (ir.ops[i] == IROp::PROCESS && ir.text(ir.arg1[i]) == "read" && ir.symbols.isString(ir.arg2[i])) {
+        return 4;
+    }
+    return 1;
+}
+
+// Cost of a sync: joining a lane thread and starting another
+constexpr uint64_t kSyncCost = 8;
+
+bool hasLanesOrChannels(const IRProgram& ir) {
+    for (IROp op : ir.ops) {
+        if (op == IROp::LANE_START || op == IROp::SYNC || op == IROp::SYNC_ALL ||
+            op == IROp::CHANNEL || op == IROp::SEND || op == IROp::RECEIVE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+DependencyGraph buildDependencies(const IRProgram& ir) {
+    DependencyGraph g;
+    Resources res;
+    g.effects.reserve(ir.size());
+    g.preds.resize(ir.size());
+
+    // Per resource: the last writer and everything that read it since
+    std::vector<uint32_t> lastWriter;
+    std::vector<std::vector<uint32_t>> readers;
+
+    for (size_t i = 0; i < ir.size(); ++i) {
+        g.effects.push_back(effectsOf(ir, i, res));
+        const InstrEffects& fx = g.effects.back();
+        if (lastWriter.size() < res.size()) {
+            lastWriter.resize(res.size(), kNone);
+            readers.resize(res.size());
+        }
+
+        std::vector<uint32_t>& preds = g.preds[i];
+        for (uint32_t r : fx.reads) {
+            if (lastWriter[r] != kNone) preds.push_back(lastWriter[r]);
+        }
+        for (uint32_t r : fx.writes) {
+            if (lastWriter[r] != kNone) preds.push_back(lastWriter[r]);
+            preds.insert(preds.end(), readers[r].begin(), readers[r].end());
+        }
+        std::sort(preds.begin(), preds.end());
+        preds.erase(std::unique(preds.begin(), preds.end()), preds.end());
+        g.edges += preds.size();
+
+        const uint32_t self = static_cast<uint32_t>(i);
+        for (uint32_t r : fx.reads) {
+            if (std::find(fx.writes.begin(), fx.writes.end(), r) == fx.writes.end()) {
+                readers[r].push_back(self);
+            }
+        }
+        for (uint32_t r : fx.writes) {
+            lastWriter[r] = self;
+            readers[r].clear();
+        }
+    }
+    g.resources = res.size();
+    return g;
+}
+
+AutoLaneResult autoLanes(IRProgram& ir, size_t maxLanes) {
+    AutoLaneResult result;
+    const size_t n = ir.size();
+    result.statements = n;
+    if (maxLanes < 2) {
+        result.skipped = "one lane";
+        return result;
+    }
+    if (hasLanesOrChannels(ir)) {
+        result.skipped = "program already uses lanes or channels";
+        return result;
+    }
+
+    const DependencyGraph g = buildDependencies(ir);
+    std::vector<std::vector<uint32_t>> succs(n);
+    std::vector<uint32_t> waiting(n);
+    for (size_t i = 0; i < n; ++i) {
+        waiting[i] = static_cast<uint32_t>(g.preds[i].size());
+        for (uint32_t p : g.preds[i]) succs[p].push_back(static_cast<uint32_t>(i));
+    }
+
+    // Priority: cost of the longest chain from an instruction to the end.
+    // Predecessors come first in the IR, so one backward sweep suffices.
+    std::vector<uint64_t> cost(n), level(n);
+    for (size_t i = n; i-- > 0;) {
+        cost[i] = costOf(ir, i);
+        uint64_t below = 0;
+        for (uint32_t s : succs[i]) below = std::max(below, level[s]);
+        level[i] = cost[i] + below;
+        result.work += cost[i];
+        result.criticalPath = std::max(result.criticalPath, level[i]);
+    }
+
+    // List scheduling: take the ready instruction with the highest level
+    // and put it on the lane where it can start earliest. Data from
+    // another lane arrives kSyncCost late, so chains stay on one lane.
+    auto lower = [&](uint32_t a, uint32_t b) {
+        return level[a] != level[b] ? level[a] < level[b] : a > b;
+    };
+    std::priority_queue<uint32_t, std::vector<uint32_t>, decltype(lower)> ready(lower);
+    for (size_t i = 0; i < n; ++i) {
+        if (waiting[i] == 0) ready.push(static_cast<uint32_t>(i));
+    }
+
+    std::vector<uint64_t> laneFree(maxLanes, 0);
+    std::vector<bool> laneUsed(maxLanes, false);
+    std::vector<uint32_t> laneOf(n, kNone);
+    std::vector<uint64_t> start(n, 0), finish(n, 0);
+
+    while (!ready.empty()) {
+        const uint32_t i = ready.top();
+        ready.pop();
+
+        // Earliest start on each lane; ties go to a lane already in use
+        uint32_t best = kNone;
+        uint64_t bestStart = 0;
+        for (uint32_t l = 0; l < maxLanes; ++l) {
+            uint64_t at = laneFree[l];
+            for (uint32_t p : g.preds[i]) {
+                at = std::max(at, finish[p] + (laneOf[p] == l ? 0 : kSyncCost));
+            }
+            if (best == kNone || at < bestStart || (at == bestStart && laneUsed[l] && !laneUsed[best])) {
+                best = l;
+                bestStart = at;
+            }
+        }
+
+        laneOf[i] = best;
+        start[i] = bestStart;
+        finish[i] = bestStart + cost[i];
+        laneFree[best] = finish[i];
+        laneUsed[best] = true;
+        result.makespan = std::max(result.makespan, finish[i]);
+
+        for (uint32_t s : succs[i]) {
+            if (--waiting[s] == 0) ready.push(s);
+        }
+    }
+
+    if (result.makespan >= result.work) {
+        result.skipped = "no independent statements";
+        return result;
+    }
+
+    // Lanes are named auto1, auto2, ... in order of first use
+    std::vector<uint32_t> order(n);
+    for (size_t i = 0; i < n; ++i) order[i] = static_cast<uint32_t>(i);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return start[a] != start[b] ? start[a] < start[b] : laneOf[a] < laneOf[b];
+    });
+
+    std::vector<uint32_t> rename(maxLanes, kNone);
+    std::vector<SymbolId> laneName, laneLabel;
+    for (uint32_t i : order) {
+        uint32_t& named = rename[laneOf[i]];
+        if (named == kNone) {
+            named = static_cast<uint32_t>(laneName.size());
+            std::string name = "auto" + std::to_string(laneName.size() + 1);
+            laneLabel.push_back(ir.symbols.internCopy("lane_" + name));
+            laneName.push_back(ir.symbols.internCopy(std::move(name)));
+        }
+        laneOf[i] = named;
+    }
+    const size_t lanes = laneName.size();
+    result.lanes = lanes;
+
+    // Write the schedule back in start order. Each lane has at most one
+    // running instance; an instruction may join it only if every
+    // predecessor ran earlier on that instance or was joined before the
+    // instance started. Otherwise the predecessors' lanes and its own are
+    // synced first and it starts a fresh instance.
+    IRProgram out;
+    out.symbols = std::move(ir.symbols);
+    out.pooledLiterals = ir.pooledLiterals;
+    out.reserve(n * 3 + n / 4);
+
+    std::vector<uint32_t> instanceOf(n, kNone);
+    std::vector<uint32_t> current(lanes, kNone);   // open instance per lane
+    std::vector<size_t> spawnedAt;                 // per instance: output position
+    std::vector<size_t> joinedAt;                  // per instance: output position, or SIZE_MAX
+    std::vector<uint32_t> instanceLane;
+    size_t open = 0;
+    std::vector<uint32_t> join;
+
+    for (uint32_t i : order) {
+        const uint32_t lane = laneOf[i];
+        const uint32_t cur = current[lane];
+
+        join.clear();
+        bool fresh = false;
+        for (uint32_t p : g.preds[i]) {
+            const uint32_t inst = instanceOf[p];
+            if (inst == cur) continue;
+            if (joinedAt[inst] == SIZE_MAX) {
+                join.push_back(instanceLane[inst]);
+                fresh = true;
+            } else if (cur != kNone && joinedAt[inst] > spawnedAt[cur]) {
+                fresh = true;
+            }
+        }
+        if (fresh && cur != kNone) join.push_back(lane);
+        std::sort(join.begin(), join.end());
+        join.erase(std::unique(join.begin(), join.end()), join.end());
+
+        if (!join.empty()) {
+            if (join.size() == open && open > 1) {
+                out.push(IROp::SYNC_ALL, kNoSymbol, kNoSymbol);
+                result.syncs++;
+            } else {
+                for (uint32_t l : join) {
+                    out.push(IROp::SYNC, laneName[l], kNoSymbol);
+                    result.syncs++;
+                }
+            }
+            // SYNC_ALL joins every open lane, including ones not in join
+            const bool all = out.ops.back() == IROp::SYNC_ALL;
+            for (uint32_t l = 0; l < lanes; ++l) {
+                if (current[l] == kNone || (!all && !std::binary_search(join.begin(), join.end(), l))) continue;
+                joinedAt[current[l]] = out.size();
+                current[l] = kNone;
+                open--;
+            }
+        }
+
+        if (current[lane] == kNone) {
+            current[lane] = static_cast<uint32_t>(spawnedAt.size());
+            spawnedAt.push_back(out.size());
+            joinedAt.push_back(SIZE_MAX);
+            instanceLane.push_back(lane);
+            open++;
+        }
+        instanceOf[i] = current[lane];
+
+        // Back-to-back statements of one lane share a lane block
+        const IRInstr in = ir.at(i);
+        if (out.size() > 0 && out.ops.back() == IROp::LANE_END && out.lane.back() == laneLabel[lane]) {
+            out.ops.back() = in.op;
+            out.arg1.back() = in.arg1;
+            out.arg2.back() = in.arg2;
+            out.loc.back() = in.loc;
+        } else {
+            out.push(IROp::LANE_START, laneName[lane], kNoSymbol, laneLabel[lane], in.loc);
+            out.push(in.op, in.arg1, in.arg2, laneLabel[lane], in.loc);
+        }
+        out.push(IROp::LANE_END, laneName[lane], kNoSymbol, laneLabel[lane], in.loc);
+    }
+
+    ir = std::move(out);
+    result.applied = true;
+    return result;
+}
+
+} // namespace EScript
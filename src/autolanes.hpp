@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ir.hpp"
+
+namespace EScript {
+
+// Automatic parallelization of serial programs (-auto-lanes).
+//
+// Each instruction reads and writes a set of resources: containers for
+// create/modify/adjust/delete, file paths for `process read`, and the
+// program's output and input streams, which keep writes and line reads
+// in source order. Two instructions touching a resource, at least one
+// of them writing it, become an edge of a dependency DAG.
+//
+// The DAG is list-scheduled onto a fixed number of lanes: the ready
+// instruction with the longest path to the end of the program goes
+// first, to the lane where it can start earliest, preferring the lane
+// that ran one of its predecessors. The schedule is then written back as
+// `lane autoN` statements. Lane threads only meet at syncs, so an
+// instruction that depends on another lane's work first syncs that lane
+// and its own; lanes are synced only when such a dependency needs it.
+struct InstrEffects {
+    std::vector<uint32_t> reads;    // resource ids
+    std::vector<uint32_t> writes;
+};
+
+struct DependencyGraph {
+    std::vector<InstrEffects> effects;          // per instruction
+    std::vector<std::vector<uint32_t>> preds;   // per instruction, earlier instructions
+    size_t resources = 0;
+    size_t edges = 0;
+};
+
+DependencyGraph buildDependencies(const IRProgram& ir);
+
+struct AutoLaneResult {
+    bool applied = false;
+    const char* skipped = nullptr;  // why the IR was left alone
+    size_t statements = 0;
+    size_t lanes = 0;               // lanes the schedule uses
+    size_t syncs = 0;               // sync instructions inserted
+    uint64_t work = 0;              // sum of instruction costs
+    uint64_t criticalPath = 0;      // longest dependency chain
+    uint64_t makespan = 0;          // length of the schedule
+};
+
+// Rewrites a program without lanes or channels into up to maxLanes
+// lanes; leaves it unchanged when it already has them or nothing would
+// run in parallel
+AutoLaneResult autoLanes(IRProgram& ir, size_t maxLanes);
+
+} // namespace EScript
@@ -0,0 +1,361 @@
+#include "cache.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace EScript {
+
+namespace {
+
+constexpr uint64_t kMul1 = 0x87C37B91114253D5ull;
+constexpr uint64_t kMul2 = 0x4CF5AD432745937Full;
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t fmix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+inline void mixWord(uint64_t& a, uint64_t& b, uint64_t w) {
+    a ^= rotl(w * kMul1, 31) * kMul2;
+    a = rotl(a, 27) + b;
+    a = a * 5 + 0x52DCE729;
+    b ^= rotl(w * kMul2, 33) * kMul1;
+    b = rotl(b, 31) + a;
+    b = b * 5 + 0x38495AB5;
+}
+
+constexpr auto kStaleLock = std::chrono::seconds(30);
+constexpr auto kStaleTemp = std::chrono::hours(1);
+constexpr size_t kKeyDigits = 32;
+
+// Cross-process mutex: whoever creates the lock directory holds it.
+// A lock older than kStaleLock is assumed to belong to a dead process.
+class CacheLock {
+    fs::path path;
+    bool held = false;
+
+public:
+    explicit CacheLock(fs::path p) : path(std::move(p)) {
+        for (int attempt = 0; attempt < 5000; ++attempt) {
+            std::error_code ec;
+            if (fs::create_directory(path, ec)) {
+                held = true;
+                return;
+            }
+            auto stamp = fs::last_write_time(path, ec);
+            if (!ec && fs::file_time_type::clock::now() - stamp > kStaleLock) {
+                fs::remove(path, ec);
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    ~CacheLock() {
+        if (held) {
+            std::error_code ec;
+            fs::remove(path, ec);
+        }
+    }
+
+    explicit operator bool() const { return held; }
+};
+
+struct EntryInfo {
+    fs::path path;
+    fs::file_time_type used;
+    uint64_t bytes;
+};
+
+std::vector<EntryInfo> scanEntries(const fs::path& root) {
+    std::vector<EntryInfo> entries;
+    std::error_code ec;
+    for (fs::directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+        const fs::path& dir = it->path();
+        if (dir.filename().string().size() != kKeyDigits || !it->is_directory(ec)) continue;
+
+        EntryInfo info{dir, fs::last_write_time(dir, ec), 0};
+        if (ec) {
+            ec.clear();
+            continue;
+        }
+        for (fs::directory_iterator f(dir, ec); !ec && f != end; f.increment(ec)) {
+            std::error_code sizeEc;
+            uint64_t size = f->file_size(sizeEc);
+            if (!sizeEc) info.bytes += size;
+        }
+        ec.clear();
+        entries.push_back(std::move(info));
+    }
+    return entries;
+}
+
+CacheStats readStats(const fs::path& file) {
+    CacheStats stats;
+    std::ifstream in(file);
+    std::string name;
+    uint64_t value;
+    while (in >> name >> value) {
+        if (name == "hits") stats.hits = value;
+        else if (name == "misses") stats.misses = value;
+        else if (name == "stores") stats.stores = value;
+        else if (name == "evictions") stats.evictions = value;
+    }
+    return stats;
+}
+
+void touch(const fs::path& path) {
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+}
+
+} // namespace
+
+std::string CacheKey::hex() const {
+    static const char digits[] = "0123456789abcdef";
+    std::string out(kKeyDigits, '0');
+    for (int i = 0; i < 16; ++i) {
+        out[15 - i] = digits[(hi >> (4 * i)) & 0xF];
+        out[31 - i] = digits[(lo >> (4 * i)) & 0xF];
+    }
+    return out;
+}
+
+CacheHasher& CacheHasher::add(std::string_view bytes) {
+    const char* p = bytes.data();
+    size_t n = bytes.size();
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        mixWord(a, b, w);
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, p, n);
+    mixWord(a, b, tail ^ (static_cast<uint64_t>(n) << 56));
+
+    // Length is part of the key so add("ab").add("c") != add("a").add("bc")
+    mixWord(a, b, bytes.size());
+    total += bytes.size();
+    return *this;
+}
+
+CacheHasher& CacheHasher::add(uint64_t v) {
+    mixWord(a, b, v);
+    total += 8;
+    return *this;
+}
+
+CacheKey CacheHasher::finish() const {
+    uint64_t h1 = a ^ total;
+    uint64_t h2 = b ^ total;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix(h1);
+    h2 = fmix(h2);
+    h1 += h2;
+    h2 += h1;
+    return CacheKey{h1, h2};
+}
+
+BuildCache::BuildCache(std::string dir, uint64_t maxBytes)
+    : root(std::move(dir)), maxBytes(maxBytes) {
+    std::error_code ec;
+    fs::create_directories(fs::path(root) / "tmp", ec);
+}
+
+BuildCache::~BuildCache() {
+    flush();
+}
+
+std::string BuildCache::entryPath(const CacheKey& key) const {
+    return (fs::path(root) / key.hex()).string();
+}
+
+std::string BuildCache::tempPath() {
+    thread_local std::mt19937_64 rng(
+        std::random_device{}() ^
+        std::hash<std::thread::id>{}(std::this_thread::get_id()) ^
+        static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+    CacheKey name{rng(), rng()};
+    return (fs::path(root) / "tmp" / name.hex()).string();
+}
+
+bool BuildCache::load(const CacheKey& key, const std::string& name, std::string& out) {
+    fs::path entry = entryPath(key);
+    std::ifstream in(entry / name, std::ios::binary);
+    if (!in) return false;
+
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    if (in.bad()) return false;
+    out = buffer.str();
+    touch(entry);
+    return true;
+}
+
+bool BuildCache::fetch(const CacheKey& key, const std::string& name, const std::string& dest) {
+    fs::path entry = entryPath(key);
+    fs::path src = entry / name;
+    fs::path staged = dest + ".cache-tmp";
+    std::error_code ec;
+
+    // Stage next to dest and rename, so a running copy of dest is replaced
+    // rather than rewritten in place
+    if (!fs::copy_file(src, staged, fs::copy_options::overwrite_existing, ec)) {
+        fs::remove(staged, ec);
+        return false;
+    }
+    fs::permissions(staged, fs::status(src, ec).permissions(), ec);
+    fs::rename(staged, dest, ec);
+    if (ec) {
+        fs::remove(staged, ec);
+        return false;
+    }
+    touch(entry);
+    return true;
+}
+
+void BuildCache::commit(const std::string& temp, const CacheKey& key, const std::string& name) {
+    std::error_code ec;
+    uint64_t size = fs::file_size(temp, ec);
+    if (ec) size = 0;
+    fs::path entry = entryPath(key);
+    fs::create_directories(entry, ec);
+    fs::rename(temp, entry / name, ec);
+    if (ec) {
+        fs::remove(temp, ec);
+        return;
+    }
+    stores++;
+
+    // Keep long batches near the limit instead of only trimming at exit
+    if ((storedBytes += size) > maxBytes / 4) {
+        flush();
+    }
+}
+
+void BuildCache::store(const CacheKey& key, const std::string& name, std::string_view bytes) {
+    std::string temp = tempPath();
+    {
+        std::ofstream out(temp, std::ios::binary);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if (!out) {
+            out.close();
+            std::error_code ec;
+            fs::remove(temp, ec);
+            return;
+        }
+    }
+    commit(temp, key, name);
+}
+
+void BuildCache::storeFile(const CacheKey& key, const std::string& name, const std::string& path) {
+    std::string temp = tempPath();
+    std::error_code ec;
+    if (!fs::copy_file(path, temp, ec)) {
+        fs::remove(temp, ec);
+        return;
+    }
+    commit(temp, key, name);
+}
+
+uint64_t BuildCache::evict() {
+    const fs::path base(root);
+    std::error_code ec;
+    auto now = fs::file_time_type::clock::now();
+
+    // Temporaries left behind by crashed compilers
+    for (fs::directory_iterator it(base / "tmp", ec), end; !ec && it != end; it.increment(ec)) {
+        std::error_code stampEc;
+        auto stamp = it->last_write_time(stampEc);
+        if (!stampEc && now - stamp > kStaleTemp) {
+            fs::remove_all(it->path(), stampEc);
+        }
+    }
+
+    auto entries = scanEntries(base);
+    uint64_t total = 0;
+    for (const auto& e : entries) total += e.bytes;
+    if (total <= maxBytes) return 0;
+
+    // Oldest first, down to 90% of the limit so the next store does not
+    // immediately evict again
+    std::sort(entries.begin(), entries.end(),
+              [](const EntryInfo& x, const EntryInfo& y) { return x.used < y.used; });
+    const uint64_t target = maxBytes - maxBytes / 10;
+    uint64_t evicted = 0;
+    for (const auto& e : entries) {
+        if (total <= target) break;
+        fs::path trash = tempPath();
+        fs::rename(e.path, trash, ec);
+        if (ec) {
+            ec.clear();
+            continue;
+        }
+        fs::remove_all(trash, ec);
+        total -= std::min(total, e.bytes);
+        evicted++;
+    }
+    return evicted;
+}
+
+void BuildCache::flush() {
+    CacheStats delta;
+    delta.hits = hits.exchange(0);
+    delta.misses = misses.exchange(0);
+    delta.stores = stores.exchange(0);
+    const bool stored = storedBytes.exchange(0) > 0;
+    if (!delta.hits && !delta.misses && !delta.stores) return;
+
+    const fs::path base(root);
+    CacheLock lock(base / "lock");
+    if (!lock) return;
+
+    CacheStats total = readStats(base / "stats");
+    total.hits += delta.hits;
+    total.misses += delta.misses;
+    total.stores += delta.stores;
+    if (stored) total.evictions += evict();
+
+    std::string temp = tempPath();
+    {
+        std::ofstream out(temp);
+        out << "hits " << total.hits << "\n"
+            << "misses " << total.misses << "\n"
+            << "stores " << total.stores << "\n"
+            << "evictions " << total.evictions << "\n";
+    }
+    std::error_code ec;
+    fs::rename(temp, base / "stats", ec);
+    if (ec) fs::remove(temp, ec);
+}
+
+CacheStats BuildCache::stats() {
+    flush();
+    const fs::path base(root);
+    CacheStats stats = readStats(base / "stats");
+    for (const auto& e : scanEntries(base)) {
+        stats.entries++;
+        stats.bytes += e.bytes;
+    }
+    return stats;
+}
+
+} // namespace EScript
@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace EScript {
+
+// 128-bit content key, printed as 32 hex digits
+struct CacheKey {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+
+    std::string hex() const;
+};
+
+// Incremental 128-bit hash over source bytes, compiler version and flags.
+// Not cryptographic; it only has to make accidental collisions negligible.
+class CacheHasher {
+    uint64_t a = 0x9E3779B97F4A7C15ull;
+    uint64_t b = 0xC2B2AE3D27D4EB4Full;
+    uint64_t total = 0;
+
+public:
+    CacheHasher& add(std::string_view bytes);
+    CacheHasher& add(uint64_t v);
+    CacheKey finish() const;
+};
+
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t stores = 0;
+    uint64_t evictions = 0;
+    uint64_t entries = 0;
+    uint64_t bytes = 0;
+};
+
+// On-disk content-addressed artifact cache.
+//
+// Each key owns a directory <dir>/<hex> holding named artifacts ("ir",
+// "asm", "exe"). Artifacts are written to <dir>/tmp and renamed into
+// place, so concurrent compilers never see a partial file, and entries
+// are renamed away before they are deleted, so a reader either finds a
+// whole entry or none. The entry directory's mtime is its LRU stamp.
+// Stats and eviction are serialized across processes by <dir>/lock.
+//
+// Cache failures never fail a compile: lookups miss and stores are
+// dropped. One BuildCache may be shared by every batch worker.
+class BuildCache {
+public:
+    BuildCache(std::string dir, uint64_t maxBytes);
+    ~BuildCache();
+
+    BuildCache(const BuildCache&) = delete;
+    BuildCache& operator=(const BuildCache&) = delete;
+
+    const std::string& directory() const { return root; }
+
+    // Reads artifact `name` of key into out and marks the entry used
+    bool load(const CacheKey& key, const std::string& name, std::string& out);
+    // Copies artifact `name` of key to dest (keeping its permissions)
+    bool fetch(const CacheKey& key, const std::string& name, const std::string& dest);
+
+    // Adds artifact `name` to key's entry, from memory or from a file
+    void store(const CacheKey& key, const std::string& name, std::string_view bytes);
+    void storeFile(const CacheKey& key, const std::string& name, const std::string& path);
+
+    void recordHit() { hits++; }
+    void recordMiss() { misses++; }
+
+    // Adds this process's counters to <dir>/stats and evicts least
+    // recently used entries while the cache is over its size limit.
+    // Runs whenever a quarter of the limit has been stored, and from the
+    // destructor; safe to call more than once.
+    void flush();
+
+    // Persistent counters plus the current entry count and size
+    CacheStats stats();
+
+private:
+    std::string root;
+    uint64_t maxBytes;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> stores{0};
+    std::atomic<uint64_t> storedBytes{0};
+
+    std::string entryPath(const CacheKey& key) const;
+    std::string tempPath();
+    void commit(const std::string& temp, const CacheKey& key, const std::string& name);
+    uint64_t evict();
+};
+
+} // namespace EScript
@@ -0,0 +1,110 @@
+#include "channels.hpp"
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace EScript {
+
+namespace {
+
+uint32_t parseCapacity(std::string_view name, std::string_view text) {
+    if (text.empty()) return kDefaultChannelCapacity;
+    uint64_t n = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9' || n > kMaxChannelCapacity) {
+            n = 0;
+            break;
+        }
+        n = n * 10 + static_cast<uint64_t>(c - '0');
+    }
+    if (n == 0 || n > kMaxChannelCapacity) {
+        throw std::runtime_error("Invalid capacity for channel '" + std::string(name) + "': " +
+                                 std::string(text) + " (1.." + std::to_string(kMaxChannelCapacity) + ")");
+    }
+    uint32_t capacity = 1;
+    while (capacity < n) capacity <<= 1;
+    return capacity;
+}
+
+} // namespace
+
+ChannelPlan planChannels(const IRProgram& ir, const LanePlan& lanes) {
+    ChannelPlan plan;
+
+    // Thread of each instruction: 0 for main, lane instance + 1
+    std::vector<uint32_t> thread(ir.size(), 0);
+    for (size_t k = 0; k < lanes.instances.size(); ++k) {
+        for (uint32_t i : lanes.instances[k].body) thread[i] = static_cast<uint32_t>(k + 1);
+    }
+
+    std::vector<bool> declared;
+    std::vector<uint32_t> producer;     // first sending thread + 1, 0 for none
+    std::vector<uint32_t> consumer;
+    auto channel = [&](SymbolId name) {
+        auto it = plan.index.find(name);
+        if (it != plan.index.end()) return it->second;
+        uint32_t c = static_cast<uint32_t>(plan.channels.size());
+        ChannelInfo info;
+        info.name = name;
+        plan.channels.push_back(info);
+        plan.index.emplace(name, c);
+        declared.push_back(false);
+        producer.push_back(0);
+        consumer.push_back(0);
+        return c;
+    };
+
+    for (size_t i = 0; i < ir.size(); ++i) {
+        const IROp op = ir.ops[i];
+        if (op != IROp::CHANNEL && op != IROp::SEND && op != IROp::RECEIVE) continue;
+        std::string_view name = ir.text(ir.arg1[i]);
+        if (name.empty()) {
+            throw std::runtime_error(std::string(irOpName(op)) + " needs a channel name");
+        }
+        uint32_t c = channel(ir.arg1[i]);
+        ChannelInfo& info = plan.channels[c];
+
+        if (op == IROp::CHANNEL) {
+            uint32_t capacity = parseCapacity(name, ir.text(ir.arg2[i]));
+            if (declared[c] && capacity != info.capacity) {
+                throw std::runtime_error("Channel '" + std::string(name) + "' declared twice");
+            }
+            info.capacity = capacity;
+            declared[c] = true;
+        } else if (op == IROp::SEND) {
+            if (producer[c] == 0) producer[c] = thread[i] + 1;
+            else if (producer[c] != thread[i] + 1) info.singleProducer = false;
+        } else {
+            if (ir.text(ir.arg2[i]).empty() || ir.symbols.isString(ir.arg2[i])) {
+                throw std::runtime_error("receive " + std::string(name) + " needs a container");
+            }
+            if (consumer[c] == 0) consumer[c] = thread[i] + 1;
+            else if (consumer[c] != thread[i] + 1) info.singleConsumer = false;
+        }
+    }
+    return plan;
+}
+
+#ifdef __linux__
+void channelWait(std::atomic<uint32_t>& word, uint32_t seen) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, seen, nullptr, nullptr, 0);
+}
+
+void channelWake(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+#else
+void channelWait(std::atomic<uint32_t>& word, uint32_t seen) {
+    if (word.load() == seen) std::this_thread::yield();
+}
+
+void channelWake(std::atomic<uint32_t>&) {}
+#endif
+
+} // namespace EScript
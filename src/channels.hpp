@@ -0,0 +1,134 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include "ir.hpp"
+#include "lanes.hpp"
+
+namespace EScript {
+
+// Channels pass values between lanes. `channel <name> <capacity>`
+// declares one (optional; capacity defaults to kDefaultChannelCapacity
+// and rounds up to a power of two), `send <name> <value>` blocks while it
+// is full and `receive <name> <container>` blocks while it is empty.
+//
+// Both backends use the same bounded ring. Ticket t owns cell t & mask;
+// each cell has a turn counter that starts at 0. The sender waits for
+// turn == t - (t & mask), stores the value and adds 1; the receiver
+// waits for that + 1, takes the value and adds capacity - 1, which is
+// the turn the next round's sender waits for. Tickets come from an
+// atomic fetch-add, or from a plain load and store when one thread does
+// all the sends (or receives) of a channel. Waiters spin briefly, then
+// sleep on the turn word (futex on Linux).
+constexpr uint32_t kDefaultChannelCapacity = 64;
+constexpr uint32_t kMaxChannelCapacity = 1u << 16;
+constexpr uint32_t kChannelSpins = 256;
+
+struct ChannelInfo {
+    SymbolId name;
+    uint32_t capacity = kDefaultChannelCapacity;
+    bool singleProducer = true;     // every send runs on one thread
+    bool singleConsumer = true;     // every receive runs on one thread
+};
+
+struct ChannelPlan {
+    std::vector<ChannelInfo> channels;
+    std::unordered_map<SymbolId, uint32_t> index;   // name -> channels entry
+
+    bool empty() const { return channels.empty(); }
+    uint32_t of(SymbolId name) const { return index.at(name); }
+};
+
+// Collects the channels of a program; throws std::runtime_error for a
+// bad capacity or a channel declared twice with different capacities
+ChannelPlan planChannels(const IRProgram& ir, const LanePlan& lanes);
+
+// Sleep while word still holds seen (may return spuriously); wake all
+// sleepers on word
+void channelWait(std::atomic<uint32_t>& word, uint32_t seen);
+void channelWake(std::atomic<uint32_t>& word);
+
+template <typename T>
+class Channel {
+public:
+    Channel(uint32_t capacity, bool singleProducer, bool singleConsumer)
+        : mask(capacity - 1), spscSend(singleProducer), spscReceive(singleConsumer),
+          cells(new Cell[capacity]) {}
+
+    void send(T value) {
+        const uint64_t t = ticket(tail, spscSend);
+        Cell& cell = cells[t & mask];
+        waitTurn(cell, static_cast<uint32_t>(t - (t & mask)));
+        cell.value = std::move(value);
+        publish(cell, 1);
+    }
+
+    T receive() {
+        const uint64_t t = ticket(head, spscReceive);
+        Cell& cell = cells[t & mask];
+        waitTurn(cell, static_cast<uint32_t>(t - (t & mask) + 1));
+        T value = std::move(cell.value);
+        publish(cell, static_cast<uint32_t>(mask));
+        return value;
+    }
+
+    // Fails every blocked and later send/receive; used when a run aborts
+    void cancel() {
+        cancelled.store(true);
+        for (uint64_t i = 0; i <= mask; ++i) {
+            // Any change to the turn word ends a futex wait on it
+            cells[i].turn.fetch_add(1);
+            channelWake(cells[i].turn);
+        }
+    }
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<uint32_t> turn{0};
+        T value{};
+    };
+
+    alignas(64) std::atomic<uint64_t> tail{0};
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint32_t> sleepers{0};
+    std::atomic<bool> cancelled{false};
+    const uint64_t mask;
+    const bool spscSend;
+    const bool spscReceive;
+    std::unique_ptr<Cell[]> cells;
+
+    static uint64_t ticket(std::atomic<uint64_t>& counter, bool single) {
+        if (!single) return counter.fetch_add(1, std::memory_order_relaxed);
+        uint64_t t = counter.load(std::memory_order_relaxed);
+        counter.store(t + 1, std::memory_order_relaxed);
+        return t;
+    }
+
+    void waitTurn(Cell& cell, uint32_t want) {
+        for (;;) {
+            for (uint32_t spin = 0; spin < kChannelSpins; ++spin) {
+                if (cell.turn.load(std::memory_order_acquire) == want) {
+                    if (cancelled.load()) break;
+                    return;
+                }
+            }
+            if (cancelled.load()) throw std::runtime_error("Run error: channel closed");
+
+            // Announce the sleep before the last check, so publish sees it
+            sleepers.fetch_add(1);
+            uint32_t seen = cell.turn.load();
+            if (seen != want && !cancelled.load()) channelWait(cell.turn, seen);
+            sleepers.fetch_sub(1);
+        }
+    }
+
+    void publish(Cell& cell, uint32_t step) {
+        cell.turn.fetch_add(step);
+        if (sleepers.load() != 0) channelWake(cell.turn);
+    }
+};
+
+} // namespace EScript
@@ -1,84 +1,447 @@
 #include "ir.hpp"
-#include <fstream>
+#include "lower.hpp"
+#include "profile.hpp"
+#include "textbuffer.hpp"
+#include "threadpool.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <functional>
 #include <iostream>
+#include <stdexcept>
+#include <thread>
 
 namespace EScript {
 
-void emitNASM(const std::vector<IRInstr>& ir, const std::string& file) {
-    std::ofstream out(file);
-    
-    if (!out) {
-        throw std::runtime_error("Cannot open file for writing: " + file);
+namespace {
+
+// Below this many instructions a single thread is faster than the pool
+constexpr size_t kParallelEmitThreshold = 32 * 1024;
+// Longest straight-line span a worker emits in one piece
+constexpr size_t kEmitChunk = 16 * 1024;
+// Column of trailing instruction comments
+constexpr size_t kNoteColumn = 24;
+
+const char* const kReg64[] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"
+};
+const char* const kReg32[] = {
+    "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"
+};
+const char* const kReg8[] = {
+    "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"
+};
+
+const char* mnemonic(MOp op) {
+    switch (op) {
+    case MOp::Mov:     return "mov";
+    case MOp::Add:     return "add";
+    case MOp::Sub:     return "sub";
+    case MOp::Cmp:     return "cmp";
+    case MOp::And:     return "and";
+    case MOp::Or:      return "or";
+    case MOp::Xor:     return "xor";
+    case MOp::Test:    return "test";
+    case MOp::Lea:     return "lea";
+    case MOp::Shl:     return "shl";
+    case MOp::Shr:     return "shr";
+    case MOp::Xadd:    return "xadd";
+    case MOp::Neg:     return "neg";
+    case MOp::Div:     return "div";
+    case MOp::Jmp:     return "jmp";
+    case MOp::Jz:      return "jz";
+    case MOp::Jnz:     return "jnz";
+    case MOp::Js:      return "js";
+    case MOp::Jo:      return "jo";
+    case MOp::Call:    return "call";
+    case MOp::Ret:     return "ret";
+    case MOp::Syscall: return "syscall";
+    case MOp::Int80:   return "int 0x80";
+    case MOp::Pause:   return "pause";
+    }
+    return "?";
+}
+
+// Prints lowered code as NASM source. With track(), also lists the
+// symbols the text uses and the labels it defines, for sharding.
+class NasmStreamer : public MachineStreamer {
+    const MachineSymbols& syms;
+    TextBuffer& out;
+    std::vector<MSym>* refs = nullptr;
+    std::vector<MSym>* defs = nullptr;
+
+    void use(MSym sym) {
+        if (refs && sym != kNoMSym) refs->push_back(sym);
+    }
+
+    void define(MSym sym) {
+        if (defs) defs->push_back(sym);
+    }
+
+    void displacement(int32_t disp) {
+        if (disp > 0) out << " + " << disp;
+        else if (disp < 0) out << " - " << -static_cast<int64_t>(disp);
     }
-    
-    // Emit data section
-    out << "section .data\n";
-    out << "    msg db 'E-Script executed successfully', 0Ah, 0\n";
-    out << "    msg_len equ $ - msg\n";
- 
-    // Emit strings from IR
-    int strCounter = 0;
-    for (const auto& instr : ir) {
-        if (!instr.arg2.empty() && instr.arg2[0] == '"') {
-   // Extract string content (remove quotes)
-     std::string content = instr.arg2.substr(1, instr.arg2.length() - 2);
-  out << "    str_" << strCounter << " db '" << content << "', 0Ah, 0\n";
-      out << "    str_" << strCounter << "_len equ $ - str_" << strCounter << "\n";
-            strCounter++;
-     }
-    }
- out << "\n";
-    
-    // Emit BSS section for variables
-    out << "section .bss\n";
-    out << "    ; Reserved space for runtime variables\n\n";
-    
-    // Emit text section
-  out << "section .text\n";
-    out << "    global _start\n\n";
-    out << "_start:\n";
-    
-    // Generate assembly for each IR instruction
-    strCounter = 0;
-    for (const auto& instr : ir) {
-        out << "    ; " << instr.op << " " << instr.arg1 << " " << instr.arg2 << "\n";
-        
-  if (instr.op == "PROCESS" && instr.arg1 == "write") {
-   // sys_write for Windows (using int 80h style for compatibility)
- out << "    ; Write operation: " << instr.arg2 << "\n";
-    if (!instr.arg2.empty() && instr.arg2[0] == '"') {
-   out << "    mov eax, 4          ; sys_write\n";
-          out << "    mov ebx, 1   ; stdout\n";
-        out << "    mov ecx, str_" << strCounter << "\n";
-out << "    mov edx, str_" << strCounter << "_len\n";
-      out << "    int 0x80\n";
-     strCounter++;
+
+    void operand(const MOperand& op, Width width, bool sized) {
+        using Kind = MOperand::Kind;
+        const size_t r = static_cast<size_t>(op.reg);
+        switch (op.kind) {
+        case Kind::None:
+            break;
+        case Kind::Reg:
+            out << (width == Width::W64 ? kReg64[r] : width == Width::W8 ? kReg8[r] : kReg32[r]);
+            break;
+        case Kind::Imm:
+            use(op.sym);
+            if (op.sym != kNoMSym) out << syms[op.sym].name;
+            else out << op.value;
+            break;
+        case Kind::Addr:
+            use(op.sym);
+            out << syms[op.sym].name;
+            displacement(op.value);
+            break;
+        case Kind::Mem:
+            use(op.sym);
+            if (sized) {
+                out << (width == Width::W64 ? "qword " : width == Width::W8 ? "byte " : "dword ");
+            }
+            out << "[";
+            if (op.hasBase) {
+                out << kReg64[r];
+                if (op.sym != kNoMSym) out << " + " << syms[op.sym].name;
+                displacement(op.value);
+            } else {
+                out << syms[op.sym].name;
+                displacement(op.value);
             }
-     }
-        else if (instr.op == "LANE_START") {
-            out << instr.label << ":\n";
-   out << "  ; Lane " << instr.arg1 << " begins\n";
+            out << "]";
+            break;
         }
-        else if (instr.op == "LANE_END") {
-          out << "    ; Lane " << instr.arg1 << " ends\n";
+    }
+
+public:
+    NasmStreamer(const MachineSymbols& s, TextBuffer& o) : syms(s), out(o) {}
+
+    void track(std::vector<MSym>& usedSyms, std::vector<MSym>& definedSyms) {
+        refs = &usedSyms;
+        defs = &definedSyms;
+    }
+
+    void section(MSection s) override {
+        switch (s) {
+        case MSection::Data:
+            out << "section .data\n";
+            break;
+        case MSection::Bss:
+            out << "\nsection .bss align=64\n";
+            out << "    ; Reserved space for runtime variables\n";
+            break;
+        case MSection::Text:
+            out << "\nsection .text\n";
+            out << "    global _start\n\n";
+            break;
+        case MSection::Const:
+            break;
         }
-   else if (instr.op == "SYNC_ALL") {
-            out << "    ; Synchronization point\n";
+    }
+
+    void dataLine(MSym sym, MSym lenSym, std::string_view text) override {
+        const std::string& name = syms[sym].name;
+        define(sym);
+        define(lenSym);
+        out << "    " << name << " db '" << text << "', 0Ah, 0\n";
+        out << "    " << syms[lenSym].name << " equ $ - " << name << "\n";
+    }
+
+    void dataBytes(MSym sym, const std::vector<uint8_t>& bytes) override {
+        define(sym);
+        out << "    " << syms[sym].name << " db ";
+        for (size_t i = 0; i < bytes.size(); ++i) {
+            if (i) out << ", ";
+            out << static_cast<unsigned>(bytes[i]);
         }
-        else {
-       out << "    ; Operation: " << instr.op << "\n";
+        out << "\n";
+    }
+
+    void reserve(MSym sym, uint32_t bytes, uint32_t align) override {
+        define(sym);
+        out << "    alignb " << align << "\n";
+        out << "    " << syms[sym].name << " resb " << bytes << "\n";
+    }
+
+    void label(MSym sym) override {
+        define(sym);
+        out << syms[sym].name << ":\n";
+    }
+
+    void comment(std::initializer_list<std::string_view> parts) override {
+        out << "    ;";
+        for (std::string_view part : parts) out << " " << part;
+        out << "\n";
     }
+
+    void blank() override {
         out << "\n";
     }
-    
-    // Exit program
-    out << "    ; Exit program\n";
-    out << "    mov eax, 1          ; sys_exit\n";
-    out << "    xor ebx, ebx        ; exit code 0\n";
-    out << "int 0x80\n";
-    
-    out.close();
-    std::cout << "[CodeGen] Generated assembly: " << file << "\n";
+
+    void emit(const MInstr& in) override {
+        using Kind = MOperand::Kind;
+        const size_t start = out.size();
+        out << "    ";
+        if (in.lock) out << "lock ";
+        out << mnemonic(in.op);
+
+        switch (in.op) {
+        case MOp::Jmp:
+        case MOp::Jz:
+        case MOp::Jnz:
+        case MOp::Js:
+        case MOp::Jo:
+        case MOp::Call:
+            use(in.dst.sym);
+            out << " " << syms[in.dst.sym].name;
+            break;
+        default:
+            if (in.dst.kind != Kind::None) {
+                // Memory operands need a size unless a register implies it
+                bool sized = in.op != MOp::Lea &&
+                             in.dst.kind != Kind::Reg && in.src.kind != Kind::Reg;
+                out << " ";
+                operand(in.dst, in.width, sized);
+                if (in.src.kind != Kind::None) {
+                    out << ", ";
+                    operand(in.src, in.width, sized);
+                }
+            }
+            break;
+        }
+
+        if (in.note) {
+            size_t len = out.size() - start;
+            size_t pad = len < kNoteColumn ? kNoteColumn - len : 1;
+            for (size_t i = 0; i < pad; ++i) out << ' ';
+            out << "; " << in.note;
+        }
+        out << "\n";
+    }
+};
+
+} // namespace
+
+StringLayout layoutStrings(const IRProgram& ir) {
+    StringLayout layout;
+    layout.slot.assign(ir.size(), -1);
+
+    // Pooled literals get one entry per symbol; otherwise every
+    // occurrence gets its own
+    std::vector<int> pooledSlot(ir.pooledLiterals ? ir.symbols.size() : 0, -1);
+    for (size_t i = 0; i < ir.size(); ++i) {
+        SymbolId lit = ir.arg2[i];
+        if (!ir.symbols.isString(lit)) continue;
+        if (ir.pooledLiterals && pooledSlot[lit] >= 0) {
+            layout.slot[i] = pooledSlot[lit];
+            continue;
+        }
+
+        int n = static_cast<int>(layout.entries.size());
+        if (ir.pooledLiterals) pooledSlot[lit] = n;
+        layout.slot[i] = n;
+        layout.entries.push_back(lit);
+    }
+    return layout;
+}
+
+std::vector<std::string> renderNASMUnits(const IRProgram& ir, size_t units, const CodegenOptions& opts,
+                                         size_t threads) {
+    MachineLowering lowering(ir, opts);
+    const MachineSymbols& syms = lowering.symbols();
+    const bool shard = units > 1;
+
+    // Pieces of the text section, each rendered into its own buffer:
+    // chunks of the main code, the exit sequence, then every lane thread.
+    // Instructions lower independently, so any split concatenates to the
+    // same text. The main chunks and the exit fall through into each
+    // other; lane threads stand alone.
+    std::vector<std::function<void(MachineStreamer&)>> pieces;
+    for (size_t begin = 0; begin < ir.size(); begin += kEmitChunk) {
+        size_t end = std::min(begin + kEmitChunk, ir.size());
+        pieces.push_back([&lowering, begin, end](MachineStreamer& s) { lowering.lowerMain(begin, end, s); });
+    }
+    pieces.push_back([&lowering](MachineStreamer& s) { lowering.lowerExit(s); });
+    const size_t mainPieces = pieces.size();
+    for (size_t k = 0; k < lowering.laneCount(); ++k) {
+        pieces.push_back([&lowering, k](MachineStreamer& s) { lowering.lowerLane(k, s); });
+    }
+
+    // Symbols each piece uses and defines; only needed to shard
+    std::vector<TextBuffer> bodies(pieces.size());
+    std::vector<std::vector<MSym>> refs(shard ? pieces.size() + 1 : 0);
+    std::vector<std::vector<MSym>> defs(refs.size());
+    auto render = [&](size_t p) {
+        NasmStreamer streamer(syms, bodies[p]);
+        if (shard) streamer.track(refs[p + 1], defs[p + 1]);
+        pieces[p](streamer);
+    };
+
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads > 1 && pieces.size() > 1 && ir.size() >= kParallelEmitThreshold) {
+        ThreadPool pool(std::min(threads, pieces.size()));
+        for (size_t p = 0; p < pieces.size(); ++p) {
+            pool.submit([&, p] { render(p); });
+        }
+        pool.wait();
+    } else {
+        for (size_t p = 0; p < pieces.size(); ++p) {
+            render(p);
+        }
+    }
+
+    // Data, bss and the text prologue, then the pieces in order
+    TextBuffer head;
+    head.reserve(256 + ir.size() * 16);
+    NasmStreamer streamer(syms, head);
+    if (shard) streamer.track(refs[0], defs[0]);
+    lowering.lowerData(streamer);
+    lowering.lowerPrologue(streamer);
+
+    size_t total = head.size();
+    for (const auto& body : bodies) total += body.size();
+
+    if (!shard) {
+        std::string text = head.take();
+        text.reserve(total);
+        for (const auto& body : bodies) text += body.str();
+        return {std::move(text)};
+    }
+
+    // Cut the pieces into contiguous units of about total / units bytes:
+    // a piece goes to the unit its midpoint falls in. The head stays in
+    // unit 0 with _start.
+    std::vector<size_t> unitOf(pieces.size());
+    size_t offset = head.size();
+    size_t used = 0;
+    for (size_t p = 0; p < pieces.size(); ++p) {
+        size_t u = std::min(units - 1, (offset + bodies[p].size() / 2) * units / std::max<size_t>(total, 1));
+        if (u > used) u = ++used;      // no empty units in between
+        unitOf[p] = u;
+        offset += bodies[p].size();
+    }
+    const size_t count = used + 1;
+
+    // Owning unit of every defined symbol
+    std::vector<size_t> owner(syms.size(), 0);
+    for (size_t p = 0; p < pieces.size(); ++p) {
+        for (MSym sym : defs[p + 1]) owner[sym] = unitOf[p];
+    }
+
+    // Where the main code crosses into another unit, the earlier unit
+    // jumps to a main_part_<p> label at the start of the next
+    std::vector<std::string> entry(count);
+    std::vector<std::string> exits(count);
+    std::vector<TextBuffer> directives(count);
+    size_t prev = 0;
+    for (size_t p = 0; p < mainPieces; ++p) {
+        if (unitOf[p] == prev) continue;
+        std::string name = "main_part_" + std::to_string(p);
+        exits[prev] = "    jmp " + name + "\n";
+        entry[unitOf[p]] = name + ":\n";
+        directives[prev] << "    extern " << name << "\n";
+        directives[unitOf[p]] << "    global " << name << "\n";
+        prev = unitOf[p];
+    }
+
+    // Symbols used outside their unit: labels, data and bss are exported
+    // by the owner and imported by the user; equ constants are repeated
+    std::vector<bool> exported(syms.size(), false);
+    std::vector<TextBuffer> imports(count);
+    std::vector<MSym> seen;
+    for (size_t u = 0; u < count; ++u) {
+        seen.clear();
+        if (u == 0) seen = refs[0];
+        for (size_t p = 0; p < pieces.size(); ++p) {
+            if (unitOf[p] == u) seen.insert(seen.end(), refs[p + 1].begin(), refs[p + 1].end());
+        }
+        std::sort(seen.begin(), seen.end());
+        seen.erase(std::unique(seen.begin(), seen.end()), seen.end());
+        for (MSym sym : seen) {
+            if (owner[sym] == u) continue;
+            const MSymbolInfo& info = syms[sym];
+            if (info.section == MSection::Const) {
+                imports[u] << "    " << info.name << " equ " << info.value << "\n";
+            } else {
+                imports[u] << "    extern " << info.name << "\n";
+                exported[sym] = true;
+            }
+        }
+    }
+    for (size_t sym = 0; sym < syms.size(); ++sym) {
+        if (exported[sym]) directives[owner[sym]] << "    global " << syms[static_cast<MSym>(sym)].name << "\n";
+    }
+
+    std::vector<std::string> texts(count);
+    for (size_t u = 0; u < count; ++u) {
+        std::string& text = texts[u];
+        if (u == 0) text = head.take();
+        else text = "section .text\n";
+        text += directives[u].str();
+        text += imports[u].str();
+        text += entry[u];
+        for (size_t p = 0; p < pieces.size(); ++p) {
+            if (unitOf[p] == u) text += bodies[p].str();
+        }
+        text += exits[u];
+    }
+    return texts;
+}
+
+std::string renderNASM(const IRProgram& ir, const CodegenOptions& opts, size_t threads) {
+    return std::move(renderNASMUnits(ir, 1, opts, threads)[0]);
+}
+
+namespace {
+
+void writeAssembly(const std::string& file, const std::string& text) {
+    // One write for the whole file
+    std::FILE* out = std::fopen(file.c_str(), "w");
+    if (!out) {
+        throw std::runtime_error("Cannot open file for writing: " + file);
+    }
+    size_t written = std::fwrite(text.data(), 1, text.size(), out);
+    bool ok = std::fclose(out) == 0 && written == text.size();
+    if (!ok) {
+        throw std::runtime_error("Failed writing assembly: " + file);
+    }
+}
+
+} // namespace
+
+void emitNASM(const IRProgram& ir, const std::string& file, const CodegenOptions& opts, std::ostream& log) {
+    ES_TIME_SCOPE("emitNASM");
+    writeAssembly(file, renderNASM(ir, opts));
+    log << "[CodeGen] Generated assembly: " << file << "\n";
+}
+
+std::vector<std::string> emitNASMUnits(const IRProgram& ir, const std::string& file, size_t units,
+                                       const CodegenOptions& opts, std::ostream& log) {
+    ES_TIME_SCOPE("emitNASM");
+    if (units == 0) {
+        units = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::vector<std::string> texts = renderNASMUnits(ir, units, opts);
+
+    std::vector<std::string> files;
+    for (size_t u = 0; u < texts.size(); ++u) {
+        files.push_back(u == 0 ? file : replaceExtension(file, "." + std::to_string(u) + ".asm"));
+        writeAssembly(files.back(), texts[u]);
+        log << "[CodeGen] Generated assembly: " << files.back() << "\n";
+    }
+    return files;
 }
 
 } // namespace EScript
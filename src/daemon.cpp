@@ -0,0 +1,515 @@
+#include "daemon.hpp"
+#include "cache.hpp"
+#include "threadpool.hpp"
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace EScript {
+
+namespace {
+
+constexpr uint32_t kMaxFrame = 64u << 20;
+
+class MessageWriter {
+    std::string out;
+
+public:
+    MessageWriter() { u8(kProtocolVersion); }
+
+    void u8(uint8_t v) { out.push_back(static_cast<char>(v)); }
+
+    void u32(uint32_t v) {
+        for (int i = 0; i < 4; ++i) {
+            out.push_back(static_cast<char>(v >> (8 * i)));
+        }
+    }
+
+    void str(std::string_view s) {
+        u32(static_cast<uint32_t>(s.size()));
+        out.append(s.data(), s.size());
+    }
+
+    std::string take() { return std::move(out); }
+};
+
+class MessageReader {
+    std::string_view in;
+    size_t pos = 0;
+
+    const char* need(size_t n) {
+        if (in.size() - pos < n) {
+            throw std::runtime_error("Malformed daemon message");
+        }
+        const char* p = in.data() + pos;
+        pos += n;
+        return p;
+    }
+
+public:
+    explicit MessageReader(std::string_view payload) : in(payload) {
+        if (u8() != kProtocolVersion) {
+            throw std::runtime_error("Daemon protocol version mismatch");
+        }
+    }
+
+    uint8_t u8() { return static_cast<uint8_t>(*need(1)); }
+
+    uint32_t u32() {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(need(4));
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    std::string str() {
+        uint32_t n = u32();
+        return std::string(need(n), n);
+    }
+};
+
+} // namespace
+
+namespace {
+
+enum RequestFlag : uint8_t {
+    kShowTokens = 1,
+    kShowAST = 2,
+    kShowIR = 4,
+    kKeepAsm = 8,
+    kAutoLanes = 16,
+    kEmitPool = 32,
+    kEmitIR = 64
+};
+
+} // namespace
+
+std::string encodeRequest(const DaemonRequest& req) {
+    MessageWriter w;
+    w.u8(static_cast<uint8_t>(req.kind));
+    w.u8(req.optLevel);
+    w.u8(static_cast<uint8_t>(req.backend));
+    w.u8(static_cast<uint8_t>((req.showTokens ? kShowTokens : 0) | (req.showAST ? kShowAST : 0) |
+                              (req.showIR ? kShowIR : 0) | (req.keepAsm ? kKeepAsm : 0) |
+                              (req.autoLanes ? kAutoLanes : 0) | (req.emitPool ? kEmitPool : 0) |
+                              (req.emitIR ? kEmitIR : 0)));
+    w.u32(req.autoLaneCount);
+    w.u32(req.asmUnits);
+    w.u32(static_cast<uint32_t>(req.laneCores.size()));
+    for (int core : req.laneCores) w.u32(static_cast<uint32_t>(core));
+    w.u32(static_cast<uint32_t>(req.poolPaths.size()));
+    for (const auto& dir : req.poolPaths) w.str(dir);
+    w.str(req.workDir);
+    w.str(req.input);
+    w.str(req.source);
+    w.str(req.output);
+    return w.take();
+}
+
+std::string encodeResponse(const DaemonResponse& resp) {
+    MessageWriter w;
+    w.u32(static_cast<uint32_t>(resp.status));
+    w.str(resp.log);
+    w.str(resp.output);
+    return w.take();
+}
+
+DaemonRequest decodeRequest(std::string_view payload) {
+    MessageReader r(payload);
+    DaemonRequest req;
+    uint8_t kind = r.u8();
+    req.optLevel = r.u8();
+    uint8_t backend = r.u8();
+    uint8_t flags = r.u8();
+    if (kind < static_cast<uint8_t>(RequestKind::Compile) ||
+        kind > static_cast<uint8_t>(RequestKind::Shutdown) ||
+        req.optLevel > 2 || backend > static_cast<uint8_t>(Backend::Direct) || flags >= 128) {
+        throw std::runtime_error("Malformed daemon request");
+    }
+    req.kind = static_cast<RequestKind>(kind);
+    req.backend = static_cast<Backend>(backend);
+    req.showTokens = flags & kShowTokens;
+    req.showAST = flags & kShowAST;
+    req.showIR = flags & kShowIR;
+    req.keepAsm = flags & kKeepAsm;
+    req.autoLanes = flags & kAutoLanes;
+    req.emitPool = flags & kEmitPool;
+    req.emitIR = flags & kEmitIR;
+    req.autoLaneCount = r.u32();
+    req.asmUnits = r.u32();
+    for (uint32_t n = r.u32(); n > 0; --n) {
+        uint32_t core = r.u32();
+        if (core > INT32_MAX) throw std::runtime_error("Malformed daemon request");
+        req.laneCores.push_back(static_cast<int>(core));
+    }
+    for (uint32_t n = r.u32(); n > 0; --n) req.poolPaths.push_back(r.str());
+    req.workDir = r.str();
+    req.input = r.str();
+    req.source = r.str();
+    req.output = r.str();
+    return req;
+}
+
+DaemonResponse decodeResponse(std::string_view payload) {
+    MessageReader r(payload);
+    DaemonResponse resp;
+    resp.status = static_cast<int32_t>(r.u32());
+    resp.log = r.str();
+    resp.output = r.str();
+    return resp;
+}
+
+#ifdef _WIN32
+
+int runDaemon(const std::string&, const CompileOptions&, size_t, std::ostream&) {
+    throw std::runtime_error("--daemon needs Unix domain sockets");
+}
+
+DaemonClient::DaemonClient(const std::string&) {
+    throw std::runtime_error("--client needs Unix domain sockets");
+}
+
+DaemonClient::~DaemonClient() {}
+
+DaemonResponse DaemonClient::request(const DaemonRequest&) {
+    return DaemonResponse{};
+}
+
+#else
+
+namespace {
+
+bool readAll(int fd, char* p, size_t n) {
+    while (n > 0) {
+        ssize_t got = recv(fd, p, n, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        p += got;
+        n -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+bool writeAll(int fd, const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t put = send(fd, p, n, MSG_NOSIGNAL);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return false;
+        p += put;
+        n -= static_cast<size_t>(put);
+    }
+    return true;
+}
+
+bool readFrame(int fd, std::string& payload) {
+    unsigned char header[4];
+    if (!readAll(fd, reinterpret_cast<char*>(header), sizeof(header))) return false;
+    uint32_t len = header[0] | (header[1] << 8) | (header[2] << 16) |
+                   (static_cast<uint32_t>(header[3]) << 24);
+    if (len > kMaxFrame) return false;
+    payload.resize(len);
+    return readAll(fd, &payload[0], len);
+}
+
+// Header and payload go out in one send so small replies are one segment
+bool writeFrame(int fd, std::string_view payload, std::string& frame) {
+    uint32_t len = static_cast<uint32_t>(payload.size());
+    frame.clear();
+    for (int i = 0; i < 4; ++i) {
+        frame.push_back(static_cast<char>(len >> (8 * i)));
+    }
+    frame.append(payload.data(), payload.size());
+    return writeAll(fd, frame.data(), frame.size());
+}
+
+sockaddr_un socketAddress(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + path);
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+}
+
+int connectTo(const std::string& path) {
+    sockaddr_un addr = socketAddress(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+int listenOn(const std::string& path) {
+    sockaddr_un addr = socketAddress(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("Cannot create socket: ") + std::strerror(errno));
+    }
+
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 && errno == EADDRINUSE) {
+        // A socket file from a daemon that died is replaced; a live one is not
+        int probe = connectTo(path);
+        if (probe >= 0) {
+            close(probe);
+            close(fd);
+            throw std::runtime_error("A daemon is already listening on " + path);
+        }
+        unlink(path.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            close(fd);
+            throw std::runtime_error("Cannot bind " + path + ": " + std::strerror(errno));
+        }
+    }
+    if (listen(fd, 128) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot listen on " + path + ": " + std::strerror(errno));
+    }
+    return fd;
+}
+
+volatile std::sig_atomic_t signalled = 0;
+int signalWakeFd = -1;
+
+void onSignal(int) {
+    signalled = 1;
+    char b = 's';
+    ssize_t ignored = write(signalWakeFd, &b, 1);
+    (void)ignored;
+}
+
+struct DaemonState {
+    const CompileOptions& base;
+    std::FILE* noInput;
+    std::atomic<uint64_t> served{0};
+};
+
+DaemonResponse handle(const DaemonRequest& req, DaemonState& state) {
+    DaemonResponse resp;
+    std::ostringstream log;
+
+    if (req.kind == RequestKind::Stats || req.kind == RequestKind::Shutdown) {
+        log << "[Daemon] " << state.served.load() << " requests served\n";
+        if (BuildCache* cache = state.base.cache) {
+            CacheStats stats = cache->stats();
+            log << "[Cache] " << stats.hits << " hits, " << stats.misses << " misses, "
+                << stats.entries << " entries, " << (stats.bytes + 1023) / 1024 << " KB\n";
+        }
+        resp.status = 0;
+        resp.log = log.str();
+        return resp;
+    }
+
+    CompileOptions opts = state.base;
+    opts.optLevel = req.optLevel;
+    opts.backend = req.backend;
+    opts.run = req.kind == RequestKind::Run;
+    opts.check = req.kind == RequestKind::Check;
+    opts.showTokens = req.showTokens;
+    opts.showAST = req.showAST;
+    opts.showIR = req.showIR;
+    opts.keepAsm = req.keepAsm;
+    opts.autoLanes = req.autoLanes;
+    opts.autoLaneCount = req.autoLaneCount;
+    opts.asmUnits = req.asmUnits;
+    opts.emitPool = req.emitPool;
+    opts.emitIR = req.emitIR;
+    opts.codegen.laneCores = req.laneCores;
+    opts.poolPaths = req.poolPaths;
+    opts.runDir = req.workDir;
+    opts.runIn = state.noInput;
+
+    CompileJob job;
+    job.input = req.input.empty() ? "<request>" : req.input;
+    job.output = req.output.empty() ? replaceExtension(job.input, "") : req.output;
+    job.asmFile = replaceExtension(job.output, ".asm");
+
+    // Program output is captured for the response, not the daemon's stdout
+    char* printed = nullptr;
+    size_t printedSize = 0;
+    std::FILE* out = opts.run ? open_memstream(&printed, &printedSize) : nullptr;
+    if (out) opts.runOut = out;
+
+    try {
+        resp.status = req.source.empty() ? compileFile(job, opts, log)
+                                         : compileSource(job, req.source, opts, log);
+    }
+    catch (const std::exception& e) {
+        log << "\n✗ Error: " << e.what() << "\n";
+        resp.status = 1;
+    }
+
+    if (out) {
+        std::fclose(out);
+        resp.output.assign(printed, printedSize);
+        std::free(printed);
+    }
+    resp.log = log.str();
+    return resp;
+}
+
+} // namespace
+
+int runDaemon(const std::string& socketPath, const CompileOptions& base, size_t threads,
+              std::ostream& log) {
+    int listenFd = listenOn(socketPath);
+    int wake[2];
+    if (pipe2(wake, O_CLOEXEC | O_NONBLOCK) != 0) {
+        close(listenFd);
+        throw std::runtime_error(std::string("Cannot create wake pipe: ") + std::strerror(errno));
+    }
+
+    signalled = 0;
+    signalWakeFd = wake[1];
+    struct sigaction action{};
+    action.sa_handler = onSignal;
+    sigemptyset(&action.sa_mask);
+    struct sigaction oldInt, oldTerm;
+    sigaction(SIGINT, &action, &oldInt);
+    sigaction(SIGTERM, &action, &oldTerm);
+
+    DaemonState state{base, std::fopen("/dev/null", "r")};
+    std::mutex readyMutex;
+    std::vector<int> ready;            // connections whose request finished
+    std::atomic<bool> stopping{false};
+
+    auto serve = [&](int fd) {
+        // Buffers stay with the worker between requests
+        thread_local std::string payload;
+        thread_local std::string frame;
+
+        bool keep = readFrame(fd, payload);
+        if (keep) {
+            DaemonResponse resp;
+            bool shutdown = false;
+            try {
+                DaemonRequest req = decodeRequest(payload);
+                shutdown = req.kind == RequestKind::Shutdown;
+                resp = handle(req, state);
+            }
+            catch (const std::exception& e) {
+                resp.status = 1;
+                resp.log = std::string("✗ Error: ") + e.what() + "\n";
+                keep = false;
+            }
+            state.served++;
+            keep = writeFrame(fd, encodeResponse(resp), frame) && keep;
+            if (shutdown) stopping = true;
+        }
+
+        if (keep) {
+            std::lock_guard<std::mutex> lock(readyMutex);
+            ready.push_back(fd);
+        }
+        else {
+            close(fd);
+        }
+        char b = 'r';
+        ssize_t ignored = write(wake[1], &b, 1);
+        (void)ignored;
+    };
+
+    std::vector<int> idle;             // connections waiting for a request
+    {
+        ThreadPool pool(threads);
+        log << "[Daemon] Listening on " << socketPath << " with " << pool.size() << " workers\n";
+        log.flush();
+
+        std::vector<pollfd> fds;
+        while (!stopping && !signalled) {
+            fds.clear();
+            fds.push_back(pollfd{listenFd, POLLIN, 0});
+            fds.push_back(pollfd{wake[0], POLLIN, 0});
+            for (int fd : idle) {
+                fds.push_back(pollfd{fd, POLLIN, 0});
+            }
+
+            if (poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+
+            // A connection is polled only while idle, so at most one
+            // worker ever reads or writes it
+            idle.clear();
+            for (size_t i = 2; i < fds.size(); ++i) {
+                if (fds[i].revents) {
+                    int fd = fds[i].fd;
+                    pool.submit([&serve, fd] { serve(fd); });
+                }
+                else {
+                    idle.push_back(fds[i].fd);
+                }
+            }
+            if (fds[0].revents & POLLIN) {
+                int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+                if (fd >= 0) idle.push_back(fd);
+            }
+            if (fds[1].revents & POLLIN) {
+                char drain[64];
+                while (read(wake[0], drain, sizeof(drain)) > 0) {}
+                std::lock_guard<std::mutex> lock(readyMutex);
+                idle.insert(idle.end(), ready.begin(), ready.end());
+                ready.clear();
+            }
+        }
+
+        pool.wait();
+    }
+
+    for (int fd : idle) close(fd);
+    for (int fd : ready) close(fd);
+    close(listenFd);
+    unlink(socketPath.c_str());
+    sigaction(SIGINT, &oldInt, nullptr);
+    sigaction(SIGTERM, &oldTerm, nullptr);
+    signalWakeFd = -1;
+    close(wake[0]);
+    close(wake[1]);
+    if (state.noInput) std::fclose(state.noInput);
+
+    log << "[Daemon] Stopped after " << state.served.load() << " requests\n";
+    return 0;
+}
+
+DaemonClient::DaemonClient(const std::string& socketPath) {
+    fd = connectTo(socketPath);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot connect to daemon at " + socketPath + ": " +
+                                 std::strerror(errno));
+    }
+}
+
+DaemonClient::~DaemonClient() {
+    if (fd >= 0) close(fd);
+}
+
+DaemonResponse DaemonClient::request(const DaemonRequest& req) {
+    std::string frame;
+    std::string payload;
+    if (!writeFrame(fd, encodeRequest(req), frame) || !readFrame(fd, payload)) {
+        throw std::runtime_error("Lost connection to daemon");
+    }
+    return decodeResponse(payload);
+}
+
+#endif
+
+} // namespace EScript
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "driver.hpp"
+
+namespace EScript {
+
+// Compile server for build orchestrators (--daemon / --client).
+//
+// Every message is a frame: a little-endian u32 payload length, then
+// the payload. Strings inside a payload are a u32 length and the bytes.
+//
+//   request:  u8 version, u8 kind, u8 optLevel, u8 backend, u8 flags,
+//             u32 autoLaneCount, u32 asmUnits, u32 n, n x u32 laneCores,
+//             u32 n, n x str poolPaths, str workDir,
+//             str input, str source, str output
+//   response: u8 version, i32 status, str log, str output
+//
+// flags are the client's -tokens (1), -ast (2), -ir (4), -asm (8),
+// -auto-lanes (16), -emit-pool (32) and -emit-ir-bin (64). input is a
+// path the daemon reads unless source is non-empty; output is the
+// executable path (empty: input without its extension); paths are
+// absolute. workDir is the client's working directory, which relative
+// `process read` paths of a Run request resolve against. log is the
+// compiler's progress output, output is what a Run request printed.
+// A connection carries any number of request/response pairs in order.
+
+constexpr uint8_t kProtocolVersion = 2;
+
+enum class RequestKind : uint8_t {
+    Compile = 1,    // build an executable
+    Run = 2,        // interpret in-process, like -run
+    Check = 3,      // front end and optimizer only, like -check
+    Stats = 4,      // cache and request counters in log
+    Shutdown = 5    // stop accepting, finish in-flight requests, exit
+};
+
+struct DaemonRequest {
+    RequestKind kind = RequestKind::Compile;
+    uint8_t optLevel = 0;
+    Backend backend = Backend::Direct;
+    bool showTokens = false;
+    bool showAST = false;
+    bool showIR = false;
+    bool keepAsm = false;
+    bool autoLanes = false;
+    bool emitPool = false;
+    bool emitIR = false;
+    uint32_t autoLaneCount = 0;
+    uint32_t asmUnits = 1;
+    std::vector<int> laneCores;
+    std::vector<std::string> poolPaths;
+    std::string workDir;
+    std::string input;
+    std::string source;
+    std::string output;
+};
+
+struct DaemonResponse {
+    int32_t status = 1;
+    std::string log;
+    std::string output;
+};
+
+std::string encodeRequest(const DaemonRequest& req);
+std::string encodeResponse(const DaemonResponse& resp);
+// Both throw std::runtime_error on a malformed payload
+DaemonRequest decodeRequest(std::string_view payload);
+DaemonResponse decodeResponse(std::string_view payload);
+
+// Serves requests on a Unix domain socket at socketPath until a Shutdown
+// request or SIGINT/SIGTERM. One poll loop accepts connections and hands
+// each complete request to a pool of `threads` workers (0 = one per
+// core); base supplies the cache and codegen settings every request
+// shares. Returns the process exit status.
+int runDaemon(const std::string& socketPath, const CompileOptions& base, size_t threads,
+              std::ostream& log = std::cout);
+
+// Blocking client connection; throws std::runtime_error on I/O errors
+class DaemonClient {
+    int fd = -1;
+
+public:
+    explicit DaemonClient(const std::string& socketPath);
+    ~DaemonClient();
+
+    DaemonClient(const DaemonClient&) = delete;
+    DaemonClient& operator=(const DaemonClient&) = delete;
+
+    DaemonResponse request(const DaemonRequest& req);
+};
+
+} // namespace EScript
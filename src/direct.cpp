@@ -0,0 +1,101 @@
+#include "ir.hpp"
+#include "elf.hpp"
+#include "lower.hpp"
+#include "profile.hpp"
+#include "x64.hpp"
+#include <string>
+
+namespace EScript {
+
+namespace {
+
+uint64_t alignUp(uint64_t v, uint64_t a) {
+    return (v + a - 1) / a * a;
+}
+
+// Encodes lowered code into an ElfImage. Symbols are recorded as
+// section offsets and resolved to addresses once the text size is known.
+class DirectStreamer : public MachineStreamer {
+    const MachineSymbols& syms;
+    X64Assembler as;
+    std::vector<uint8_t> data;
+    uint64_t bssSize = 0;
+    std::vector<uint64_t> offset;   // per symbol, within its section
+
+public:
+    explicit DirectStreamer(const MachineSymbols& s) : syms(s), offset(s.size(), 0) {}
+
+    void section(MSection) override {}
+
+    // Same bytes as `name db '<text>', 0Ah, 0` in the NASM data section
+    void dataLine(MSym sym, MSym, std::string_view text) override {
+        offset[sym] = data.size();
+        data.insert(data.end(), text.begin(), text.end());
+        data.push_back(0x0A);
+        data.push_back(0x00);
+    }
+
+    void dataBytes(MSym sym, const std::vector<uint8_t>& bytes) override {
+        offset[sym] = data.size();
+        data.insert(data.end(), bytes.begin(), bytes.end());
+    }
+
+    void reserve(MSym sym, uint32_t bytes, uint32_t align) override {
+        bssSize = alignUp(bssSize, align);
+        offset[sym] = bssSize;
+        bssSize += bytes;
+    }
+
+    void label(MSym sym) override { offset[sym] = as.size(); }
+    void comment(std::initializer_list<std::string_view>) override {}
+    void blank() override {}
+    void emit(const MInstr& in) override { as.encode(in); }
+
+    void finish(MSym entry, ElfImage& image) {
+        // bss follows the data on a cache-line boundary
+        const uint64_t textAddr = elfTextAddress();
+        const uint64_t dataAddr = elfDataAddress(as.size());
+        const uint64_t bssAddr = dataAddr + alignUp(data.size(), 64);
+
+        std::vector<uint64_t> address(syms.size());
+        for (MSym s = 0; s < syms.size(); ++s) {
+            switch (syms[s].section) {
+            case MSection::Text:  address[s] = textAddr + offset[s]; break;
+            case MSection::Data:  address[s] = dataAddr + offset[s]; break;
+            case MSection::Bss:   address[s] = bssAddr + offset[s]; break;
+            case MSection::Const: address[s] = static_cast<uint64_t>(syms[s].value); break;
+            }
+        }
+        as.link(address, textAddr);
+
+        image.text = as.code();
+        image.bssSize = bssSize ? bssAddr + bssSize - (dataAddr + data.size()) : 0;
+        image.data = std::move(data);
+        image.entryOffset = offset[entry];
+    }
+};
+
+} // namespace
+
+void encodeX64(const IRProgram& ir, const CodegenOptions& opts, ElfImage& image) {
+    MachineLowering lowering(ir, opts);
+    DirectStreamer streamer(lowering.symbols());
+    lowering.lowerAll(streamer);
+    streamer.finish(lowering.entry(), image);
+}
+
+int emitDirect(const IRProgram& ir, const std::string& outFile, const CodegenOptions& opts, std::ostream& log) {
+    ES_TIME_SCOPE("emitDirect");
+    log << "[Direct] Encoding x86-64 machine code...\n";
+    ElfImage image;
+    encodeX64(ir, opts, image);
+    log << "[Direct] " << image.text.size() << " bytes of code, "
+        << image.data.size() << " bytes of data\n";
+
+    writeElfExecutable(outFile, image);
+    log << "[Direct] Build complete!\n";
+    log << "  Executable: " << outFile << "\n";
+    return 0;
+}
+
+} // namespace EScript
@@ -0,0 +1,440 @@
+#include "all.hpp"
+#include "driver.hpp"
+#include "autolanes.hpp"
+#include "cache.hpp"
+#include "frontend.hpp"
+#include "interp.hpp"
+#include "profile.hpp"
+#include "passes.hpp"
+#include "pool.hpp"
+#include "threadpool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace EScript {
+
+namespace {
+
+bool hasExtension(const std::string& path, std::string_view ext) {
+    return path.size() > ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+} // namespace
+
+std::string artifactPath(const CompileJob& job, const CompileOptions& opts) {
+    if (opts.emitPool) {
+        return hasExtension(job.output, ".pool") ? job.output : job.output + ".pool";
+    }
+    if (opts.emitIR) {
+        return hasExtension(job.output, ".esir") ? job.output : job.output + ".esir";
+    }
+    return opts.backend == Backend::Direct ? job.output : executableName(job.output);
+}
+
+void printTokens(const std::vector<Token>& tokens, std::string_view source, std::ostream& out) {
+    out << "\n=== TOKENS ===\n";
+    for (const auto& tok : tokens) {
+        out << "[" << tok.line << ":" << tok.column << "] " 
+            << tokenKindName(tok.kind) << " : '" << tok.text(source) << "'\n";
+    }
+    out << "=============\n\n";
+}
+
+void printAST(const Program& prog, std::ostream& out) {
+    out << "\n=== AST ===\n";
+    out << "Program {\n";
+    for (size_t i = 0; i < prog.size(); ++i) {
+        const Operation& op = prog.op(i);
+        out << "  Operation {\n";
+        out << "    op: " << op.op << "\n";
+        out << "    ident: " << op.ident << "\n";
+        out << "    value: " << op.value << "\n";
+        if (const Operation* nested = prog.nestedOf(op)) {
+            out << "    nested: { op: " << nested->op 
+                << ", ident: " << nested->ident 
+                << ", value: " << nested->value << " }\n";
+        }
+        out << "  }\n";
+    }
+    out << "}\n";
+    out << "===========\n\n";
+}
+
+void printIR(const IRProgram& ir, std::ostream& out) {
+    out << "\n=== IR ===\n";
+    for (size_t i = 0; i < ir.size(); ++i) {
+        const IRInstr instr = ir.at(i);
+        out << irOpName(instr.op) << " " << ir.text(instr.arg1) << " " << ir.text(instr.arg2);
+        if (instr.lane != kNoSymbol) {
+            out << " [" << ir.text(instr.lane) << "]";
+        }
+        out << "\n";
+    }
+    out << "==========\n\n";
+}
+
+namespace {
+
+// Directories `use pool` searches: the input's own, then -pool-path
+std::vector<std::string> poolSearchPaths(const CompileJob& job, const CompileOptions& opts) {
+    std::string dir = std::filesystem::path(job.input).parent_path().string();
+    std::vector<std::string> paths = {dir.empty() ? "." : dir};
+    paths.insert(paths.end(), opts.poolPaths.begin(), opts.poolPaths.end());
+    return paths;
+}
+
+// Identity of a pool file the build read, one line per pool
+std::string poolStamp(const std::string& path) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) return {};
+    return path + "\t" + std::to_string(size) + "\t" +
+           std::to_string(time.time_since_epoch().count()) + "\n";
+}
+
+// Lanes -auto-lanes may use
+size_t autoLaneCount(const CompileOptions& opts) {
+    return opts.autoLaneCount ? opts.autoLaneCount : std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Everything that changes the artifacts: compiler, source and flags
+CacheKey cacheKey(std::string_view source, const CompileJob& job, const CompileOptions& opts) {
+    CacheHasher hasher;
+    hasher.add(kCompilerVersion);
+#ifdef _WIN32
+    hasher.add("win64");
+#else
+    hasher.add("elf64");
+#endif
+    hasher.add(static_cast<uint64_t>(opts.optLevel));
+    hasher.add(static_cast<uint64_t>(opts.backend));
+    hasher.add(static_cast<uint64_t>(opts.autoLanes));
+    hasher.add(static_cast<uint64_t>(opts.autoLanes ? autoLaneCount(opts) : 0));
+    hasher.add(static_cast<uint64_t>(opts.codegen.laneCores.size()));
+    for (int core : opts.codegen.laneCores) {
+        hasher.add(static_cast<uint64_t>(core));
+    }
+    hasher.add(static_cast<uint64_t>(opts.emitPool));
+    hasher.add(static_cast<uint64_t>(opts.emitIR));
+    for (const auto& dir : poolSearchPaths(job, opts)) {
+        hasher.add(dir);
+    }
+    hasher.add(source);
+    return hasher.finish();
+}
+
+int runIR(const IRProgram& ir, const CompileOptions& opts, std::ostream& log) {
+    log << "[Run] Executing " << ir.size() << " instructions...\n";
+    log.flush();
+    auto start = std::chrono::steady_clock::now();
+    Interpreter interp(ir);
+    RunOptions runOpts;
+    runOpts.out = opts.runOut;
+    runOpts.in = opts.runIn;
+    runOpts.dir = opts.runDir;
+    runOpts.threads = opts.runThreads;
+    uint64_t executed = interp.run(runOpts);
+    auto end = std::chrono::steady_clock::now();
+    log << "[Run] " << executed << " ops in "
+        << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us\n";
+    return 0;
+}
+
+bool loadCachedIR(BuildCache& cache, const CacheKey& key, IRProgram& ir) {
+    std::string bytes;
+    if (!cache.load(key, "ir", bytes)) return false;
+    try {
+        ir = deserializeIR(bytes);
+    }
+    catch (const std::runtime_error&) {
+        return false;
+    }
+    return true;
+}
+
+// Restores job's artifacts from the cache; false on a miss, including a
+// change to any pool the cached build used. -run and -check only need
+// the IR, the backends need their executable (and NASM its .asm, when it
+// wrote a single unit).
+bool restoreCached(const CompileJob& job, const CompileOptions& opts, const CacheKey& key,
+                   std::ostream& log, int& status) {
+    ES_TIME_SCOPE("cache");
+    BuildCache& cache = *opts.cache;
+    std::string stamps;
+    if (cache.load(key, "pools", stamps)) {
+        std::istringstream lines(stamps);
+        std::string line;
+        while (std::getline(lines, line)) {
+            std::string path = line.substr(0, line.find('\t'));
+            if (poolStamp(path) != line + "\n") return false;
+        }
+    }
+
+    IRProgram ir;
+    if ((opts.run || opts.check || opts.showIR) && !loadCachedIR(cache, key, ir)) return false;
+
+    if (!opts.run && !opts.check) {
+        if (opts.backend == Backend::Nasm && opts.asmUnits == 1 && !opts.emitPool && !opts.emitIR &&
+            !cache.fetch(key, "asm", job.asmFile)) {
+            return false;
+        }
+        if (!cache.fetch(key, "exe", artifactPath(job, opts))) return false;
+    }
+
+    cache.recordHit();
+    log << "[Cache] Hit " << key.hex() << "\n";
+    if (opts.showIR) {
+        printIR(ir, log);
+    }
+    if (opts.check) {
+        log << "[Check] " << job.input << ": OK\n";
+    }
+    status = opts.run ? runIR(ir, opts, log) : 0;
+    return true;
+}
+
+// Everything after IR generation: optimization, dumps, then -check,
+// -emit-ir-bin, -run or a backend. key is only used with opts.cache.
+int compileIR(const CompileJob& job, IRProgram& ir, const CompileOptions& opts, const CacheKey& key,
+              std::ostream& log) {
+    // Optimization
+    if (opts.optLevel > 0) {
+        log << "[Opt] Running -O" << opts.optLevel << " pipeline...\n";
+        PassManager::forLevel(opts.optLevel).run(ir, log);
+        log << "[Opt] " << ir.size() << " instructions after optimization\n";
+    }
+
+    // Automatic parallelization, on the optimized IR
+    if (opts.autoLanes) {
+        ES_TIME_SCOPE("auto-lanes");
+        AutoLaneResult lanes = autoLanes(ir, autoLaneCount(opts));
+        if (lanes.applied) {
+            log << "[Lanes] Auto: " << lanes.statements << " statements on " << lanes.lanes << " lanes with "
+                << lanes.syncs << " syncs; critical path " << lanes.criticalPath << " of " << lanes.work
+                << " work, schedule length " << lanes.makespan << "\n";
+        } else {
+            log << "[Lanes] Auto: left serial (" << lanes.skipped << ")\n";
+        }
+    }
+        
+    if (opts.showIR) {
+        printIR(ir, log);
+    }
+        
+    if (opts.cache) {
+        opts.cache->store(key, "ir", serializeIR(ir));
+    }
+
+    if (opts.check) {
+        log << "[Check] " << job.input << ": OK\n";
+        return 0;
+    }
+
+    if (opts.emitIR) {
+        std::string path = artifactPath(job, opts);
+        writeIR(ir, path);
+        log << "[IR] Wrote binary IR: " << path << "\n";
+        if (opts.cache) {
+            opts.cache->storeFile(key, "exe", path);
+        }
+        return 0;
+    }
+
+    if (opts.run) {
+        return runIR(ir, opts, log);
+    }
+
+    int status;
+    if (opts.backend == Backend::Direct) {
+        log << "[CodeGen] Generating machine code...\n";
+        status = emitDirect(ir, artifactPath(job, opts), opts.codegen, log);
+    }
+    else {
+        // Code Generation
+        log << "[CodeGen] Generating assembly...\n";
+        auto units = emitNASMUnits(ir, job.asmFile, opts.asmUnits, opts.codegen, log);
+
+        // Linking
+        log << "[Linker] Building executable...\n";
+        status = autoLink(units, job.output, log);
+        if (status == 0 && opts.cache && units.size() == 1) {
+            opts.cache->storeFile(key, "asm", job.asmFile);
+        }
+    }
+
+    if (status == 0 && opts.cache) {
+        opts.cache->storeFile(key, "exe", artifactPath(job, opts));
+    }
+    return status;
+}
+
+} // namespace
+
+int compileFile(const CompileJob& job, const CompileOptions& opts, std::ostream& log) {
+    // Binary IR from -emit-ir-bin goes straight to the back end
+    if (hasExtension(job.input, ".esir")) {
+        log << "[E-Script] Loading IR: " << job.input << "\n";
+        MappedIR image(job.input);
+        log << "[IR] Loaded " << image.program().size() << " instructions\n";
+        CompileOptions backendOpts = opts;
+        backendOpts.cache = nullptr;
+        return compileIR(job, image.program(), backendOpts, CacheKey(), log);
+    }
+
+    // Map source file; it stays mapped until the compile finishes
+    SourceManager sources;
+    std::string_view source;
+    {
+        ES_TIME_SCOPE("load");
+        source = sources.load(job.input).text();
+    }
+    return compileSource(job, source, opts, log);
+}
+
+int compileSource(const CompileJob& job, std::string_view source, const CompileOptions& opts,
+                  std::ostream& log) {
+    log << "[E-Script] Compiling: " << job.input << "\n";
+
+    // The token and AST dumps need the front end, so they always miss
+    CacheKey key;
+    if (opts.cache) {
+        key = cacheKey(source, job, opts);
+        int status = 0;
+        if (!opts.showTokens && !opts.showAST && restoreCached(job, opts, key, log, status)) {
+            return status;
+        }
+        opts.cache->recordMiss();
+        log << "[Cache] Miss " << key.hex() << "\n";
+    }
+        
+    std::unique_ptr<Program> ast;
+    if (opts.frontendThreads != 1) {
+        // Lexing and parsing run chunk by chunk on the workers
+        log << "[Lexer] Tokenizing and parsing in parallel...\n";
+        std::vector<Token> tokens;
+        ParallelParse parsed = parseParallel(source, opts.frontendThreads, opts.showTokens ? &tokens : nullptr);
+        log << "[Lexer] Generated " << parsed.tokenCount << " tokens in " << parsed.chunks
+            << (parsed.chunks == 1 ? " chunk\n" : " chunks\n");
+        if (opts.showTokens) {
+            printTokens(tokens, source, log);
+        }
+        ast = std::move(parsed.program);
+    } else {
+        // Lexical analysis
+        log << "[Lexer] Tokenizing...\n";
+        auto tokens = tokenize(source);
+        log << "[Lexer] Generated " << tokens.size() << " tokens\n";
+
+        if (opts.showTokens) {
+            printTokens(tokens, source, log);
+        }
+
+        // Parsing
+        log << "[Parser] Building AST...\n";
+        Parser parser(source, std::move(tokens));
+        ast = parser.parse();
+    }
+    log << "[Parser] Parsed " << ast->size() << " operations\n";
+  
+    if (opts.showAST) {
+        printAST(*ast, log);
+    }
+        
+    // Pools are mapped on first use; a cache entry remembers which
+    PoolSet pools(poolSearchPaths(job, opts));
+    auto storePoolStamps = [&] {
+        if (!opts.cache || pools.modules().empty()) return;
+        std::string stamps;
+        for (const auto& pool : pools.modules()) stamps += poolStamp(pool->path());
+        opts.cache->store(key, "pools", stamps);
+    };
+
+    if (opts.emitPool) {
+        log << "[Pool] Building pool module...\n";
+        std::vector<PoolEntryRange> entries;
+        auto ir = generatePoolIR(*ast, entries, &pools);
+        if (opts.showIR) {
+            printIR(ir, log);
+        }
+        if (opts.check) {
+            log << "[Check] " << job.input << ": OK\n";
+            return 0;
+        }
+        std::string path = artifactPath(job, opts);
+        writePool(ir, entries, path);
+        log << "[Pool] Wrote " << entries.size() << " entries, " << ir.size() << " instructions: " << path << "\n";
+        if (opts.cache) {
+            storePoolStamps();
+            opts.cache->storeFile(key, "exe", path);
+        }
+        return 0;
+    }
+
+    // IR Generation
+    log << "[IR] Generating intermediate representation...\n";
+    auto ir = generateIR(*ast, &pools);
+    log << "[IR] Generated " << ir.size() << " instructions\n";
+    if (!pools.modules().empty()) {
+        log << "[Pool] " << pools.materialized() << " entries from " << pools.modules().size() << " pools\n";
+    }
+
+    if (opts.cache) {
+        storePoolStamps();
+    }
+    return compileIR(job, ir, opts, key, log);
+}
+
+std::vector<CompileResult> compileBatch(const std::vector<CompileJob>& jobs,
+                                        const CompileOptions& opts, size_t threads) {
+    std::vector<CompileResult> results(jobs.size());
+    ThreadPool pool(threads);
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        pool.submit([&jobs, &opts, &results, i] {
+            const CompileJob& job = jobs[i];
+            CompileResult& result = results[i];
+            std::ostringstream log;
+            result.input = job.input;
+
+            try {
+                result.status = compileFile(job, opts, log);
+                if (result.status != 0) {
+                    log << "\n✗ Compilation failed!\n";
+                }
+            }
+            catch (const std::exception& e) {
+                log << "\n✗ Error: " << e.what() << "\n";
+                result.status = 1;
+            }
+            result.log = log.str();
+        });
+    }
+
+    pool.wait();
+    return results;
+}
+
+std::vector<std::string> readManifest(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Cannot open manifest: " + path);
+    }
+
+    std::vector<std::string> inputs;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '*') continue;
+        size_t end = line.find_last_not_of(" \t\r");
+        inputs.push_back(line.substr(begin, end - begin + 1));
+    }
+    return inputs;
+}
+
+} // namespace EScript
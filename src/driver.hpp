@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "tokens.hpp"
+#include "parser.hpp"
+#include "ir.hpp"
+
+namespace EScript {
+
+class BuildCache;
+
+constexpr const char* kCompilerVersion = "1.0.0";
+
+enum class Backend : uint8_t {
+    Nasm,      // emit NASM text, then assemble and link via autoLink
+    Direct     // encode machine code and write the ELF executable in-process
+};
+
+struct CompileOptions {
+    bool keepAsm = false;
+    bool showTokens = false;
+    bool showAST = false;
+    bool showIR = false;
+    int optLevel = 0;      // -O0 / -O1 / -O2
+    bool autoLanes = false;       // -auto-lanes: schedule independent statements onto lanes
+    size_t autoLaneCount = 0;     // -auto-lanes=<n>: most lanes used, 0 = one per core
+    Backend backend = Backend::Nasm;
+    size_t asmUnits = 1;   // -asm-units: NASM sources assembled in parallel, 0 = one per core
+    CodegenOptions codegen;
+    bool run = false;      // -run: interpret the IR instead of building
+    bool check = false;    // -check: stop after IR generation and optimization
+    bool emitPool = false; // -emit-pool: write <output>.pool instead of an executable
+    bool emitIR = false;   // -emit-ir-bin: write <output>.esir instead of an executable
+    std::vector<std::string> poolPaths;   // -pool-path: searched after the input's directory
+    size_t runThreads = 0; // lane workers for -run, 0 = one per core
+    size_t frontendThreads = 1;   // -j on one input: lex and parse in chunks, 0 = one per core
+    std::FILE* runOut = stdout;    // -run: process write
+    std::FILE* runIn = stdin;      // -run: process read <ident>
+    std::string runDir;            // -run: base of relative read paths, empty = working directory
+    BuildCache* cache = nullptr;   // -cache: reuse artifacts of unchanged inputs
+};
+
+// One input and the paths its artifacts are written to
+struct CompileJob {
+    std::string input;
+    std::string output;    // executable name, as passed to autoLink
+    std::string asmFile;
+};
+
+struct CompileResult {
+    std::string input;
+    int status = 1;        // 0 on success
+    std::string log;       // captured progress output and diagnostics
+};
+
+// Path of the executable (or pool, or IR image) compileFile produces for job
+std::string artifactPath(const CompileJob& job, const CompileOptions& opts);
+
+// Debug dumps
+void printTokens(const std::vector<Token>& tokens, std::string_view source, std::ostream& out = std::cout);
+void printAST(const Program& prog, std::ostream& out = std::cout);
+void printIR(const IRProgram& ir, std::ostream& out = std::cout);
+
+// Runs tokenize -> Parser -> generateIR -> emitNASM -> autoLink (or the
+// direct backend, or the interpreter for -run) for one file, reporting
+// progress to log. An .esir input (see serializeIR) skips the front end.
+// -check stops once the IR is built. With opts.cache, an input whose
+// source, flags and compiler version were built before restores the
+// cached IR, assembly and executable instead. Returns the backend's
+// status and throws std::runtime_error on front-end and run-time errors.
+int compileFile(const CompileJob& job, const CompileOptions& opts, std::ostream& log = std::cout);
+
+// compileFile on source text already in memory (job.input only names it
+// in the log); source must stay valid until the call returns
+int compileSource(const CompileJob& job, std::string_view source, const CompileOptions& opts,
+                  std::ostream& log = std::cout);
+
+// Compiles every job on a work-stealing pool of `threads` workers
+// (0 = one per core). Results are returned in job order.
+std::vector<CompileResult> compileBatch(const std::vector<CompileJob>& jobs,
+                                        const CompileOptions& opts, size_t threads);
+
+// Reads input paths from a manifest: one per line, blank lines and
+// lines starting with '*' are ignored
+std::vector<std::string> readManifest(const std::string& path);
+
+} // namespace EScript
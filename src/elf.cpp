@@ -0,0 +1,138 @@
+#include "elf.hpp"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace EScript {
+
+namespace {
+
+constexpr uint64_t kImageBase = 0x400000;
+constexpr uint64_t kPageSize = 0x1000;
+
+uint64_t alignUp(uint64_t v, uint64_t a) {
+    return (v + a - 1) & ~(a - 1);
+}
+
+// ELF64 structures (see the System V ABI); written field by field so the
+// host's struct layout never matters
+class ByteWriter {
+    std::vector<uint8_t>& out;
+
+public:
+    explicit ByteWriter(std::vector<uint8_t>& o) : out(o) {}
+
+    void u8(uint8_t v) { out.push_back(v); }
+    void u16(uint16_t v) { for (int i = 0; i < 2; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i))); }
+    void u32(uint32_t v) { for (int i = 0; i < 4; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i))); }
+    void u64(uint64_t v) { for (int i = 0; i < 8; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i))); }
+    void pad(size_t toSize) { if (out.size() < toSize) out.resize(toSize, 0); }
+    void bytes(const std::vector<uint8_t>& b) { out.insert(out.end(), b.begin(), b.end()); }
+};
+
+constexpr uint16_t kEhdrSize = 64;
+constexpr uint16_t kPhdrSize = 56;
+constexpr uint16_t kShdrSize = 64;
+
+void programHeader(ByteWriter& w, uint32_t flags, uint64_t offset, uint64_t vaddr,
+                   uint64_t fileSize, uint64_t memSize) {
+    w.u32(1);               // PT_LOAD
+    w.u32(flags);
+    w.u64(offset);
+    w.u64(vaddr);
+    w.u64(vaddr);           // p_paddr
+    w.u64(fileSize);        // p_filesz
+    w.u64(memSize);         // p_memsz
+    w.u64(kPageSize);
+}
+
+void sectionHeader(ByteWriter& w, uint32_t name, uint32_t type, uint64_t flags,
+                   uint64_t addr, uint64_t offset, uint64_t size, uint64_t align) {
+    w.u32(name);
+    w.u32(type);
+    w.u64(flags);
+    w.u64(addr);
+    w.u64(offset);
+    w.u64(size);
+    w.u32(0);               // sh_link
+    w.u32(0);               // sh_info
+    w.u64(align);
+    w.u64(0);               // sh_entsize
+}
+
+} // namespace
+
+uint64_t elfTextAddress() {
+    return kImageBase + kPageSize;
+}
+
+uint64_t elfDataAddress(size_t textSize) {
+    return kImageBase + alignUp(kPageSize + textSize, kPageSize);
+}
+
+void writeElfExecutable(const std::string& path, const ElfImage& image) {
+    const uint64_t textOffset = kPageSize;
+    const uint64_t dataOffset = alignUp(textOffset + image.text.size(), kPageSize);
+    const char shstrtab[] = "\0.text\0.data\0.bss\0.shstrtab";
+    const uint64_t shstrOffset = dataOffset + image.data.size();
+    const uint64_t shOffset = alignUp(shstrOffset + sizeof(shstrtab), 8);
+
+    std::vector<uint8_t> file;
+    file.reserve(shOffset + 5 * kShdrSize);
+    ByteWriter w(file);
+
+    // ELF header
+    const uint8_t ident[16] = {0x7F, 'E', 'L', 'F', 2 /*64-bit*/, 1 /*LE*/, 1 /*version*/, 0 /*SysV*/};
+    for (uint8_t b : ident) w.u8(b);
+    w.u16(2);               // ET_EXEC
+    w.u16(62);              // EM_X86_64
+    w.u32(1);
+    w.u64(elfTextAddress() + image.entryOffset);
+    w.u64(kEhdrSize);       // e_phoff
+    w.u64(shOffset);        // e_shoff
+    w.u32(0);               // e_flags
+    w.u16(kEhdrSize);
+    w.u16(kPhdrSize);
+    w.u16(2);               // e_phnum
+    w.u16(kShdrSize);
+    w.u16(5);               // e_shnum
+    w.u16(4);               // e_shstrndx
+
+    programHeader(w, 5 /*R+X*/, textOffset, elfTextAddress(), image.text.size(), image.text.size());
+    programHeader(w, 6 /*R+W*/, dataOffset, kImageBase + dataOffset, image.data.size(),
+                  image.data.size() + image.bssSize);
+
+    w.pad(textOffset);
+    w.bytes(image.text);
+    w.pad(dataOffset);
+    w.bytes(image.data);
+    for (char c : shstrtab) w.u8(static_cast<uint8_t>(c));
+    w.pad(shOffset);
+
+    // Section headers: null, .text, .data, .bss, .shstrtab
+    sectionHeader(w, 0, 0, 0, 0, 0, 0, 0);
+    sectionHeader(w, 1, 1 /*PROGBITS*/, 6 /*ALLOC|EXEC*/, elfTextAddress(), textOffset, image.text.size(), 16);
+    sectionHeader(w, 7, 1 /*PROGBITS*/, 3 /*WRITE|ALLOC*/, kImageBase + dataOffset, dataOffset, image.data.size(), 4);
+    sectionHeader(w, 13, 8 /*NOBITS*/, 3 /*WRITE|ALLOC*/, kImageBase + dataOffset + image.data.size(),
+                  dataOffset + image.data.size(), image.bssSize, 1);
+    sectionHeader(w, 18, 3 /*STRTAB*/, 0, 0, shstrOffset, sizeof(shstrtab), 1);
+
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) {
+        throw std::runtime_error("Cannot open file for writing: " + path);
+    }
+    size_t written = std::fwrite(file.data(), 1, file.size(), out);
+    if (std::fclose(out) != 0 || written != file.size()) {
+        throw std::runtime_error("Failed writing executable: " + path);
+    }
+
+#ifndef _WIN32
+    chmod(path.c_str(), 0755);
+#endif
+}
+
+} // namespace EScript
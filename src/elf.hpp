@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace EScript {
+
+// A static executable: one R-X text segment and one RW data segment
+struct ElfImage {
+    std::vector<uint8_t> text;
+    std::vector<uint8_t> data;
+    uint64_t bssSize = 0;       // zero-filled bytes mapped after the data
+    uint64_t entryOffset = 0;   // entry point, relative to the text start
+};
+
+// Load addresses used by writeElfExecutable. Text sits one page above the
+// image base; data follows on the next page boundary after the text.
+uint64_t elfTextAddress();
+uint64_t elfDataAddress(size_t textSize);
+
+// Writes an x86-64 ELF64 static executable and marks it executable.
+// Throws std::runtime_error on I/O failure.
+void writeElfExecutable(const std::string& path, const ElfImage& image);
+
+} // namespace EScript
@@ -0,0 +1,178 @@
+#include "frontend.hpp"
+#include "all.hpp"
+#include "threadpool.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <thread>
+
+namespace EScript {
+
+namespace {
+
+struct Chunk {
+    size_t begin = 0;
+    size_t end = 0;
+    std::vector<Token> tokens;   // offsets from begin until rebased
+    LexStatus status;
+    size_t newlines = 0;
+    std::unique_ptr<Program> program;
+    std::exception_ptr error;
+
+    void lex(std::string_view source) {
+        std::string_view text = source.substr(begin, end - begin);
+        status = LexStatus();
+        tokens = tokenize(text, status);
+        newlines = static_cast<size_t>(std::count(text.begin(), text.end(), '\n'));
+    }
+
+    // The tokens end on the '#' the chunk was cut after, with nothing
+    // left open that later text could close
+    bool closed() const {
+        return status.openComment == SIZE_MAX && !status.openString && !tokens.empty() &&
+               tokens.back().kind == TokenKind::HASH && tokens.back().offset + 1 == end - begin;
+    }
+};
+
+ParallelParse parseSerial(std::string_view source, std::vector<Token>* tokens) {
+    ParallelParse out;
+    auto toks = tokenize(source);
+    out.tokenCount = toks.size();
+    if (tokens) *tokens = toks;
+    Parser parser(source, std::move(toks));
+    out.program = parser.parse();
+    return out;
+}
+
+} // namespace
+
+ParallelParse parseParallel(std::string_view source, size_t threads, std::vector<Token>* tokens) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    // A few chunks per worker so stealing evens out uneven statements
+    const size_t want = std::min(threads * 4, source.size() / kMinFrontendChunk);
+    if (threads < 2 || want < 2 || source.size() > UINT32_MAX) {
+        return parseSerial(source, tokens);
+    }
+
+    std::vector<Chunk> chunks;
+    size_t begin = 0;
+    for (size_t c = 1; c < want; ++c) {
+        size_t hash = source.find('#', std::max(begin, source.size() * c / want));
+        if (hash == std::string_view::npos) break;
+        chunks.emplace_back();
+        chunks.back().begin = begin;
+        chunks.back().end = hash + 1;
+        begin = hash + 1;
+    }
+    if (begin < source.size() || chunks.empty()) {
+        chunks.emplace_back();
+        chunks.back().begin = begin;
+        chunks.back().end = source.size();
+    }
+
+    ThreadPool pool(std::min(threads, chunks.size()));
+    for (Chunk& chunk : chunks) {
+        pool.submit([&chunk, source] { chunk.lex(source); });
+    }
+    pool.wait();
+
+    // A cut inside a string or comment leaves its chunk open: lex it
+    // again together with the next. The first chunk starts at a real
+    // statement boundary, so every closed chunk's successor does too.
+    std::vector<Chunk> merged;
+    for (size_t i = 0; i < chunks.size();) {
+        Chunk chunk = std::move(chunks[i++]);
+        while (i < chunks.size() && !chunk.closed()) {
+            chunk.end = chunks[i++].end;
+            chunk.lex(source);
+        }
+        // Let the serial lexer report the error it would have
+        if (!chunk.status.errors.empty()) return parseSerial(source, tokens);
+        merged.push_back(std::move(chunk));
+    }
+    chunks.clear();
+
+    ParallelParse out;
+    out.chunks = merged.size();
+    size_t line = 1;
+    for (Chunk& chunk : merged) {
+        // Chunks start right after a '#', usually mid-line
+        size_t lineStart = chunk.begin;
+        while (lineStart > 0 && source[lineStart - 1] != '\n') lineStart--;
+        const uint32_t startLine = static_cast<uint32_t>(line);
+        const uint32_t startColumn = static_cast<uint32_t>(chunk.begin - lineStart + 1);
+        line += chunk.newlines;
+        out.tokenCount += chunk.tokens.size();
+
+        pool.submit([&chunk, source, startLine, startColumn, tokens] {
+            for (Token& tok : chunk.tokens) {
+                if (tok.line == 1) {
+                    uint32_t column = startColumn + tok.column - 1;
+                    tok.column = static_cast<uint16_t>(column < UINT16_MAX ? column : UINT16_MAX);
+                }
+                tok.line += startLine - 1;
+                tok.offset += static_cast<uint32_t>(chunk.begin);
+            }
+            try {
+                if (tokens) {
+                    Parser parser(source, chunk.tokens);
+                    chunk.program = parser.parse();
+                } else {
+                    Parser parser(source, std::move(chunk.tokens));
+                    chunk.program = parser.parse();
+                }
+            } catch (...) {
+                chunk.error = std::current_exception();
+            }
+        });
+    }
+    pool.wait();
+
+    // The first failing chunk holds the statement the serial parser stops at
+    size_t nodes = 0;
+    size_t ops = 0;
+    for (const Chunk& chunk : merged) {
+        if (chunk.error) std::rethrow_exception(chunk.error);
+        nodes += chunk.program->nodeCount;
+        ops += chunk.program->opCount;
+    }
+
+    out.program = std::make_unique<Program>();
+    Program& program = *out.program;
+    program.nodes = static_cast<Operation*>(program.arena.allocate(sizeof(Operation) * nodes, alignof(Operation)));
+    program.ops = static_cast<uint32_t*>(program.arena.allocate(sizeof(uint32_t) * ops, alignof(uint32_t)));
+    program.nodeCount = static_cast<uint32_t>(nodes);
+    program.opCount = static_cast<uint32_t>(ops);
+    if (tokens) tokens->resize(out.tokenCount);
+
+    // Concatenate in parallel, shifting nested-node indices
+    size_t nodeBase = 0;
+    size_t opBase = 0;
+    size_t tokenBase = 0;
+    for (Chunk& chunk : merged) {
+        pool.submit([&chunk, &program, tokens, nodeBase, opBase, tokenBase] {
+            const Program& part = *chunk.program;
+            const uint32_t shift = static_cast<uint32_t>(nodeBase);
+            for (uint32_t n = 0; n < part.nodeCount; ++n) {
+                Operation node = part.nodes[n];
+                if (node.nested != kNoNode) node.nested += shift;
+                new (&program.nodes[nodeBase + n]) Operation(node);
+            }
+            for (uint32_t o = 0; o < part.opCount; ++o) {
+                program.ops[opBase + o] = part.ops[o] + shift;
+            }
+            if (tokens && !chunk.tokens.empty()) {
+                std::memcpy(tokens->data() + tokenBase, chunk.tokens.data(), chunk.tokens.size() * sizeof(Token));
+            }
+        });
+        nodeBase += chunk.program->nodeCount;
+        opBase += chunk.program->opCount;
+        tokenBase += chunk.tokens.size();
+    }
+    pool.wait();
+    return out;
+}
+
+} // namespace EScript
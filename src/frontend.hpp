@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "parser.hpp"
+#include "tokens.hpp"
+
+namespace EScript {
+
+// Chunks smaller than this are not worth a worker
+constexpr size_t kMinFrontendChunk = 256 * 1024;
+
+// Parallel front end for large inputs. The source is cut after a '#'
+// near every 1/n of its length and each chunk is lexed on its own. A cut
+// only counts if the chunk's tokens end on that '#' with no string or
+// "**" comment left open; otherwise the chunk is merged with the next
+// and lexed again. The chunks' tokens are then rebased to source lines
+// and columns, parsed in parallel and the programs concatenated.
+//
+// Tokens, AST and error messages are identical to tokenize followed by
+// Parser::parse, which this falls back to when the source is too small
+// to split or fails to lex. threads == 0 uses one worker per core.
+struct ParallelParse {
+    std::unique_ptr<Program> program;
+    size_t tokenCount = 0;
+    size_t chunks = 1;
+};
+
+ParallelParse parseParallel(std::string_view source, size_t threads, std::vector<Token>* tokens = nullptr);
+
+} // namespace EScript
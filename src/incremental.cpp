@@ -0,0 +1,560 @@
+#include "incremental.hpp"
+#include "all.hpp"
+#include "profile.hpp"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace EScript {
+
+namespace {
+
+// Blocks are split past twice this many statements
+constexpr size_t kBlockStatements = 256;
+
+bool isIdentifier(std::string_view text) {
+    if (text.empty()) return false;
+    char c = text[0];
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+uint16_t clampColumn(uint32_t column) {
+    return static_cast<uint16_t>(column < UINT16_MAX ? column : UINT16_MAX);
+}
+
+} // namespace
+
+struct IncrementalDocument::Statement {
+    std::string text;
+    // Offsets into text; line 1 and the columns on it count from the
+    // start of text
+    std::vector<Token> tokens;
+    std::vector<Operation> nodes;   // views into text; empty on error
+    size_t lexErrorAt = SIZE_MAX;   // offset in text of the first lexer error
+    bool parseFailed = false;
+    bool openComment = false;
+    bool stars = false;             // text holds a "**"
+    bool dropped = false;           // being replaced
+    uint32_t newlines = 0;
+    size_t tail = 0;                // bytes after the last newline
+    Block* block = nullptr;
+    size_t slot = 0;
+
+    bool blank() const { return tokens.empty() && lexErrorAt == SIZE_MAX; }
+
+    // Counts lines and parses the tokens
+    void build() {
+        size_t lastNewline = std::string::npos;
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == '\n') {
+                newlines++;
+                lastNewline = i;
+            }
+        }
+        tail = lastNewline == std::string::npos ? text.size() : text.size() - lastNewline - 1;
+        stars = text.find("**") != std::string::npos;
+
+        if (tokens.empty() || lexErrorAt != SIZE_MAX) return;
+        try {
+            Parser parser(text, tokens);
+            auto prog = parser.parse();
+            nodes.assign(prog->nodes, prog->nodes + prog->nodeCount);
+        } catch (const std::runtime_error&) {
+            parseFailed = true;
+        }
+    }
+
+    // Symbols the statement names, each once
+    std::vector<std::string_view> names() const {
+        std::vector<std::string_view> out;
+        for (const Operation& node : nodes) {
+            // process names an action and call's value a pool
+            if (!node.ident.empty() && node.kind != TokenKind::KW_PROCESS) out.push_back(node.ident);
+            if (isIdentifier(node.value) && node.kind != TokenKind::KW_CALL) out.push_back(node.value);
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+        return out;
+    }
+};
+
+struct IncrementalDocument::Block {
+    std::vector<std::unique_ptr<Statement>> statements;
+    size_t bytes = 0;
+    size_t newlines = 0;
+    size_t stars = 0;               // statements holding a "**"
+    size_t index = 0;
+
+    // Recomputes the totals and the statements' back-references
+    void refresh() {
+        bytes = 0;
+        newlines = 0;
+        stars = 0;
+        for (size_t slot = 0; slot < statements.size(); ++slot) {
+            Statement& st = *statements[slot];
+            st.block = this;
+            st.slot = slot;
+            bytes += st.text.size();
+            newlines += st.newlines;
+            stars += st.stars;
+        }
+    }
+};
+
+IncrementalDocument::IncrementalDocument(std::string_view text) {
+    // The document always ends in its (here empty) text after the last '#'
+    blocks.push_back(std::make_unique<Block>());
+    blocks[0]->statements.push_back(std::make_unique<Statement>());
+    blocks[0]->refresh();
+    renumber();
+    if (!text.empty()) edit(0, 0, text);
+}
+
+IncrementalDocument::~IncrementalDocument() = default;
+
+void IncrementalDocument::renumber() {
+    blockOffset.resize(blocks.size());
+    blockLine.resize(blocks.size());
+    blockFirst.resize(blocks.size());
+    size_t offset = 0;
+    size_t line = 1;
+    size_t first = 0;
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        Block& block = *blocks[b];
+        block.index = b;
+        blockOffset[b] = offset;
+        blockLine[b] = line;
+        blockFirst[b] = first;
+        offset += block.bytes;
+        line += block.newlines;
+        first += block.statements.size();
+    }
+    bytes = offset;
+    statements = first;
+}
+
+const IncrementalDocument::Statement& IncrementalDocument::at(const Position& p) const {
+    return *blocks[p.block]->statements[p.slot];
+}
+
+IncrementalDocument::Position IncrementalDocument::locate(size_t offset) const {
+    size_t b = static_cast<size_t>(std::upper_bound(blockOffset.begin(), blockOffset.end(), offset) -
+                                   blockOffset.begin()) - 1;
+    const Block& block = *blocks[b];
+    size_t start = blockOffset[b];
+    for (size_t slot = 0; slot < block.statements.size(); ++slot) {
+        size_t size = block.statements[slot]->text.size();
+        if (offset < start + size) return {b, slot, start};
+        start += size;
+    }
+    // The end of the document belongs to the last statement
+    const size_t slot = block.statements.size() - 1;
+    return {b, slot, start - block.statements[slot]->text.size()};
+}
+
+IncrementalDocument::Position IncrementalDocument::positionOf(const Statement* st) const {
+    const Block& block = *st->block;
+    size_t offset = blockOffset[block.index];
+    for (size_t slot = 0; slot < st->slot; ++slot) offset += block.statements[slot]->text.size();
+    return {block.index, st->slot, offset};
+}
+
+uint32_t IncrementalDocument::lineOf(const Position& p) const {
+    const Block& block = *blocks[p.block];
+    size_t line = blockLine[p.block];
+    for (size_t slot = 0; slot < p.slot; ++slot) line += block.statements[slot]->newlines;
+    return static_cast<uint32_t>(line);
+}
+
+uint32_t IncrementalDocument::columnOf(const Position& p) const {
+    // Back to the nearest newline, which is almost always in the
+    // previous statement
+    size_t column = 1;
+    size_t b = p.block;
+    size_t slot = p.slot;
+    while (b > 0 || slot > 0) {
+        if (slot == 0) slot = blocks[--b]->statements.size();
+        const Statement& st = *blocks[b]->statements[--slot];
+        if (st.newlines > 0) return static_cast<uint32_t>(column + st.tail);
+        column += st.text.size();
+    }
+    return static_cast<uint32_t>(column);
+}
+
+void IncrementalDocument::index(const Statement& st) {
+    for (std::string_view name : st.names()) symbols[std::string(name)].push_back(&st);
+}
+
+void IncrementalDocument::unindex(const std::vector<Statement*>& gone) {
+    // One pass over each named symbol's references, however many of
+    // them go: a comment opened near the top drops most of the file
+    std::unordered_set<std::string_view> names;
+    for (Statement* st : gone) {
+        st->dropped = true;
+        for (std::string_view name : st->names()) names.insert(name);
+    }
+    for (std::string_view name : names) {
+        auto it = symbols.find(std::string(name));
+        if (it == symbols.end()) continue;
+        auto& refs = it->second;
+        refs.erase(std::remove_if(refs.begin(), refs.end(), [](const Statement* st) { return st->dropped; }),
+                   refs.end());
+        if (refs.empty()) symbols.erase(it);
+    }
+}
+
+void IncrementalDocument::replace(const Position& first, const Position& last,
+                                  std::vector<std::unique_ptr<Statement>> fresh) {
+    std::vector<Statement*> gone;
+    for (Position p = first;; p.slot++) {
+        if (p.slot == blocks[p.block]->statements.size()) {
+            p.block++;
+            p.slot = 0;
+        }
+        gone.push_back(blocks[p.block]->statements[p.slot].get());
+        if (gone.back() == openComment) openComment = nullptr;
+        if (p.block == last.block && p.slot == last.slot) break;
+    }
+    unindex(gone);
+    for (size_t b = first.block; b <= last.block; ++b) {
+        auto& list = blocks[b]->statements;
+        size_t from = b == first.block ? first.slot : 0;
+        size_t to = b == last.block ? last.slot + 1 : list.size();
+        list.erase(list.begin() + from, list.begin() + to);
+    }
+    for (const auto& st : fresh) {
+        index(*st);
+        if (st->openComment) openComment = st.get();
+    }
+
+    auto& head = blocks[first.block]->statements;
+    head.insert(head.begin() + first.slot, std::make_move_iterator(fresh.begin()),
+                std::make_move_iterator(fresh.end()));
+
+    // Split an oversized block, or fold a small one into its successor
+    size_t touched = last.block - first.block + 1;
+    if (head.size() > 2 * kBlockStatements) {
+        std::vector<std::unique_ptr<Block>> pieces;
+        for (size_t from = kBlockStatements; from < head.size(); from += kBlockStatements) {
+            auto piece = std::make_unique<Block>();
+            size_t to = std::min(head.size(), from + kBlockStatements);
+            piece->statements.assign(std::make_move_iterator(head.begin() + from),
+                                     std::make_move_iterator(head.begin() + to));
+            pieces.push_back(std::move(piece));
+        }
+        head.resize(kBlockStatements);
+        touched += pieces.size();
+        blocks.insert(blocks.begin() + first.block + 1, std::make_move_iterator(pieces.begin()),
+                      std::make_move_iterator(pieces.end()));
+    } else if (first.block + touched < blocks.size() &&
+               head.size() + blocks[first.block + touched]->statements.size() <= kBlockStatements) {
+        auto& next = blocks[first.block + touched]->statements;
+        head.insert(head.end(), std::make_move_iterator(next.begin()), std::make_move_iterator(next.end()));
+        next.clear();
+        touched++;
+    }
+
+    for (size_t b = first.block; b < first.block + touched; ++b) blocks[b]->refresh();
+    blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                                [](const std::unique_ptr<Block>& block) { return block->statements.empty(); }),
+                 blocks.end());
+    renumber();
+}
+
+DocumentEdit IncrementalDocument::edit(size_t offset, size_t length, std::string_view text) {
+    ES_TIME_SCOPE("incremental");
+    if (offset > bytes || length > bytes - offset) {
+        throw std::out_of_range("Edit past the end of the document");
+    }
+
+    auto next = [&](Position p) {
+        p.offset += at(p).text.size();
+        if (++p.slot == blocks[p.block]->statements.size()) {
+            p.block++;
+            p.slot = 0;
+        }
+        return p;
+    };
+    auto gather = [&](Position from, const Position& to, std::string& out) {
+        for (;; from = next(from)) {
+            out += at(from).text;
+            if (from.block == to.block && from.slot == to.slot) break;
+        }
+    };
+
+    // The region: whole statements around the edit, with the edit applied
+    Position first = locate(offset);
+    Position last = length ? locate(offset + length - 1) : first;
+    std::string region;
+    gather(first, last, region);
+    region.replace(offset - first.offset, length, text);
+
+    // A "**" that nothing closed closes on the first one after it, which
+    // may now be in the region
+    if (openComment) {
+        Position open = positionOf(openComment);
+        if (indexOf(open) < indexOf(first) && region.find("**") != std::string::npos) {
+            std::string before;
+            for (Position p = open; indexOf(p) < indexOf(first); p = next(p)) before += at(p).text;
+            region.insert(0, before);
+            first = open;
+        }
+    }
+
+    // The first statement after p whose text holds a "**"; blocks
+    // without one are skipped whole
+    auto nextStars = [&](Position p, Position& hit) {
+        p = next(p);
+        while (p.block < blocks.size()) {
+            const Block& block = *blocks[p.block];
+            if (p.slot == 0 && block.stars == 0) {
+                p.offset += block.bytes;
+                p.block++;
+            } else if (at(p).stars) {
+                hit = p;
+                return true;
+            } else {
+                p = next(p);
+            }
+        }
+        return false;
+    };
+
+    // Lex until the tokens end on an old statement boundary. A comment
+    // left open pulls in the statement holding the next "**" (it stays
+    // a line comment if there is none); an open string pulls in twice as
+    // many following statements as the round before. Each round keeps
+    // the tokens before whatever was left open and lexes on from the
+    // comment's "**" or the end of the last token, where the lexer is
+    // between tokens, so a comment running past many statements is
+    // lexed about once.
+    DocumentEdit result;
+    result.first = indexOf(first);
+    size_t regionEnd = last.offset + at(last).text.size();
+    size_t more = 1;
+    size_t resume = 0;
+    uint32_t resumeLine = 1;
+    LexStatus status;
+    std::vector<Token> toks;
+    for (;;) {
+        LexStatus part;
+        std::vector<Token> fresh = tokenize(std::string_view(region).substr(resume), part);
+        result.relexed += region.size() - resume;
+        const size_t lexed = region.size();
+
+        // Rebase onto the region
+        const size_t lineStart = resume == 0 ? 0 : region.rfind('\n', resume - 1) + 1;
+        const uint32_t startColumn = static_cast<uint32_t>(resume - lineStart + 1);
+        for (Token tok : fresh) {
+            if (tok.line == 1) tok.column = clampColumn(startColumn + tok.column - 1);
+            tok.line += resumeLine - 1;
+            tok.offset += static_cast<uint32_t>(resume);
+            toks.push_back(tok);
+        }
+        for (LexError& e : part.errors) {
+            e.offset += resume;
+            status.errors.push_back(std::move(e));
+        }
+        status.openComment = part.openComment == SIZE_MAX ? SIZE_MAX : part.openComment + resume;
+        status.openString = part.openString;
+
+        Position hit;
+        if (status.openComment != SIZE_MAX && nextStars(last, hit)) {
+            while (indexOf(last) < indexOf(hit)) {
+                last = next(last);
+                region += at(last).text;
+                regionEnd += at(last).text.size();
+            }
+        } else {
+            bool synced = !status.openString && !toks.empty() && toks.back().kind == TokenKind::HASH &&
+                          toks.back().offset + 1 == region.size();
+            if (synced || regionEnd == bytes) break;
+            for (size_t i = 0; i < more && regionEnd < bytes; ++i) {
+                last = next(last);
+                region += at(last).text;
+                regionEnd += at(last).text.size();
+            }
+            more *= 2;
+        }
+
+        // Tokens after an open comment's "**" lexed it as a line comment;
+        // one running into the end of the text may run on
+        size_t from = resume;
+        if (status.openComment != SIZE_MAX) {
+            while (!toks.empty() && toks.back().offset >= status.openComment) toks.pop_back();
+            resume = status.openComment;
+        } else {
+            while (!toks.empty() && toks.back().offset + toks.back().length >= lexed) toks.pop_back();
+            if (!toks.empty()) resume = std::max<size_t>(resume, toks.back().offset + toks.back().length);
+        }
+        resumeLine += static_cast<uint32_t>(std::count(region.begin() + from, region.begin() + resume, '\n'));
+        while (!status.errors.empty() && status.errors.back().offset >= resume) status.errors.pop_back();
+    }
+    // Reaching the last byte is not reaching the last statement: the
+    // blank tail after the final '#' has no bytes, but is replaced too
+    const bool toEnd = regionEnd == bytes;
+    if (toEnd) {
+        while (indexOf(last) + 1 < statements) last = next(last);
+    }
+    result.removed = indexOf(last) - result.first + 1;
+
+    // Cut the region after every '#', rebasing tokens onto each statement
+    std::vector<std::unique_ptr<Statement>> fresh;
+    size_t begin = 0;
+    size_t firstToken = 0;
+    size_t error = 0;
+    uint32_t line = 1;
+    uint32_t column = 1;
+    auto cut = [&](size_t end, size_t endToken) {
+        auto st = std::make_unique<Statement>();
+        st->text.assign(region, begin, end - begin);
+        st->tokens.reserve(endToken - firstToken);
+        for (size_t t = firstToken; t < endToken; ++t) {
+            Token tok = toks[t];
+            tok.offset -= static_cast<uint32_t>(begin);
+            if (tok.line == line) tok.column = clampColumn(tok.column - column + 1);
+            tok.line -= line - 1;
+            st->tokens.push_back(tok);
+        }
+        while (error < status.errors.size() && status.errors[error].offset < end) {
+            if (st->lexErrorAt == SIZE_MAX) st->lexErrorAt = status.errors[error].offset - begin;
+            error++;
+        }
+        st->openComment = status.openComment >= begin && status.openComment < end;
+        st->build();
+        fresh.push_back(std::move(st));
+    };
+    for (size_t t = 0; t < toks.size(); ++t) {
+        if (toks[t].kind != TokenKind::HASH) continue;
+        cut(toks[t].offset + 1, t + 1);
+        begin = toks[t].offset + 1;
+        firstToken = t + 1;
+        line = toks[t].line;
+        column = toks[t].column + 1u;
+    }
+    if (toEnd) cut(region.size(), toks.size());
+
+    result.inserted = fresh.size();
+    replace(first, last, std::move(fresh));
+    return result;
+}
+
+size_t IncrementalDocument::statementCount() const {
+    const Block& tail = *blocks.back();
+    return statements - (tail.statements.back()->blank() ? 1 : 0);
+}
+
+size_t IncrementalDocument::statementAt(size_t offset) const {
+    if (offset > bytes) {
+        throw std::out_of_range("Offset past the end of the document");
+    }
+    return indexOf(locate(offset));
+}
+
+DocumentStatement IncrementalDocument::statement(size_t index) const {
+    if (index >= statements) {
+        throw std::out_of_range("No statement " + std::to_string(index));
+    }
+    size_t b = static_cast<size_t>(std::upper_bound(blockFirst.begin(), blockFirst.end(), index) -
+                                   blockFirst.begin()) - 1;
+    Position p{b, index - blockFirst[b], blockOffset[b]};
+    for (size_t slot = 0; slot < p.slot; ++slot) p.offset += blocks[b]->statements[slot]->text.size();
+    const Statement& st = at(p);
+
+    const uint32_t startLine = lineOf(p);
+    const uint32_t startColumn = columnOf(p);
+    auto absolute = [&](Token tok) {
+        if (tok.line == 1) tok.column = clampColumn(startColumn + tok.column - 1);
+        tok.line += startLine - 1;
+        return tok;
+    };
+
+    DocumentStatement out;
+    out.index = index;
+    out.offset = p.offset;
+    out.source = st.text;
+    out.line = startLine;
+    out.column = startColumn;
+    if (!st.tokens.empty()) {
+        Token tok = absolute(st.tokens[0]);
+        out.line = tok.line;
+        out.column = tok.column;
+    }
+    if (!st.nodes.empty()) out.nodes = st.nodes.data();
+
+    if (st.lexErrorAt != SIZE_MAX) {
+        uint32_t line = startLine;
+        uint32_t column = startColumn;
+        for (size_t i = 0; i < st.lexErrorAt; ++i) {
+            if (st.text[i] == '\n') {
+                line++;
+                column = 1;
+            } else {
+                column++;
+            }
+        }
+        // The lexer quotes up to ten bytes, which may run into the next statements
+        std::string near = st.text.substr(st.lexErrorAt, 10);
+        for (size_t bb = b, slot = p.slot + 1; near.size() < 10 && bb < blocks.size(); ++bb, slot = 0) {
+            for (; slot < blocks[bb]->statements.size() && near.size() < 10; ++slot) {
+                near += blocks[bb]->statements[slot]->text.substr(0, 10 - near.size());
+            }
+        }
+        out.error = "Lexer error at line " + std::to_string(line) + ", column " + std::to_string(column) +
+                    ": Unknown token near '" + near + "...'";
+    } else if (st.parseFailed) {
+        // Parse again at document positions for the message
+        std::vector<Token> tokens;
+        tokens.reserve(st.tokens.size());
+        for (const Token& tok : st.tokens) tokens.push_back(absolute(tok));
+        try {
+            Parser(st.text, std::move(tokens)).parse();
+        } catch (const std::runtime_error& e) {
+            out.error = e.what();
+        }
+    }
+    return out;
+}
+
+std::vector<size_t> IncrementalDocument::references(std::string_view symbol) const {
+    std::vector<size_t> out;
+    auto it = symbols.find(std::string(symbol));
+    if (it == symbols.end()) return out;
+    out.reserve(it->second.size());
+    for (const Statement* st : it->second) out.push_back(blockFirst[st->block->index] + st->slot);
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+std::string IncrementalDocument::text() const {
+    std::string out;
+    out.reserve(bytes);
+    for (const auto& block : blocks) {
+        for (const auto& st : block->statements) out += st->text;
+    }
+    return out;
+}
+
+std::vector<Token> IncrementalDocument::tokens() const {
+    std::vector<Token> out;
+    size_t offset = 0;
+    uint32_t line = 1;
+    uint32_t column = 1;
+    for (const auto& block : blocks) {
+        for (const auto& st : block->statements) {
+            for (Token tok : st->tokens) {
+                tok.offset += static_cast<uint32_t>(offset);
+                if (tok.line == 1) tok.column = clampColumn(column + tok.column - 1);
+                tok.line += line - 1;
+                out.push_back(tok);
+            }
+            offset += st->text.size();
+            line += st->newlines;
+            column = st->newlines > 0 ? static_cast<uint32_t>(st->tail + 1) : column + static_cast<uint32_t>(st->text.size());
+        }
+    }
+    return out;
+}
+
+} // namespace EScript
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "parser.hpp"
+#include "tokens.hpp"
+
+namespace EScript {
+
+// Incremental front end for editors and feeders. The document is kept as
+// a run of statements, each the source from just after the previous '#'
+// through its own, with that statement's tokens and AST; the text after
+// the last '#' is a final, possibly blank, statement. An edit re-lexes
+// from the start of the first statement it touches until the tokens end
+// on an old statement boundary again, and re-parses only the statements
+// in between. That is usually just the edited statement; opening or
+// closing a string or "**" comment runs on to wherever it now ends.
+// Statements live in blocks with per-block byte and line totals, so
+// positions resolve without renumbering the rest of the file.
+
+// The statements one edit replaced
+struct DocumentEdit {
+    size_t first = 0;      // index of the first statement replaced
+    size_t removed = 0;    // old statements replaced
+    size_t inserted = 0;   // new statements in their place
+    size_t relexed = 0;    // bytes lexed again
+};
+
+// One statement as published to tooling; the views stay valid until the
+// next edit. Operation line and column count from the statement: line 1
+// is the line it starts on.
+struct DocumentStatement {
+    size_t index = 0;
+    size_t offset = 0;         // byte offset of the statement's source
+    uint32_t line = 0;         // of its first token, or of its source if it has none
+    uint32_t column = 0;
+    std::string_view source;
+    const Operation* nodes = nullptr;   // nodes[0] is the statement; nullptr on error
+    std::string error;         // lexer or parser error, positioned in the document
+
+    const Operation* op() const { return nodes; }
+    const Operation* nestedOf(const Operation& o) const {
+        return o.nested == kNoNode ? nullptr : &nodes[o.nested];
+    }
+};
+
+class IncrementalDocument {
+public:
+    explicit IncrementalDocument(std::string_view text = {});
+    ~IncrementalDocument();
+
+    IncrementalDocument(const IncrementalDocument&) = delete;
+    IncrementalDocument& operator=(const IncrementalDocument&) = delete;
+
+    // Replaces [offset, offset + length) with text; throws
+    // std::out_of_range if the range runs past the end
+    DocumentEdit edit(size_t offset, size_t length, std::string_view text);
+
+    size_t size() const { return bytes; }
+    // Statements, not counting blank text after the last '#'
+    size_t statementCount() const;
+    DocumentStatement statement(size_t index) const;
+    // Index of the statement whose source holds offset
+    size_t statementAt(size_t offset) const;
+    // Statements naming symbol as their identifier or an identifier
+    // value, nested operations included, in document order
+    std::vector<size_t> references(std::string_view symbol) const;
+
+    // The whole text, and its tokens with document positions: what
+    // tokenize(text()) returns when the text lexes
+    std::string text() const;
+    std::vector<Token> tokens() const;
+
+private:
+    struct Statement;
+    struct Block;
+    struct Position {
+        size_t block;
+        size_t slot;
+        size_t offset;     // of the statement's source
+    };
+
+    std::vector<std::unique_ptr<Block>> blocks;
+    // Per-block prefix sums, rebuilt after every edit
+    std::vector<size_t> blockOffset;
+    std::vector<size_t> blockLine;
+    std::vector<size_t> blockFirst;
+    size_t bytes = 0;
+    size_t statements = 0;
+    const Statement* openComment = nullptr;   // holds a "**" nothing closes
+    std::unordered_map<std::string, std::vector<const Statement*>> symbols;
+
+    Position locate(size_t offset) const;
+    Position positionOf(const Statement* st) const;
+    const Statement& at(const Position& p) const;
+    size_t indexOf(const Position& p) const { return blockFirst[p.block] + p.slot; }
+    uint32_t lineOf(const Position& p) const;
+    uint32_t columnOf(const Position& p) const;
+    void index(const Statement& st);
+    void unindex(const std::vector<Statement*>& gone);
+    void replace(const Position& first, const Position& last, std::vector<std::unique_ptr<Statement>> fresh);
+    void renumber();
+};
+
+} // namespace EScript
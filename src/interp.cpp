@@ -0,0 +1,542 @@
+#include "interp.hpp"
+#include "profile.hpp"
+#include "storage.hpp"
+#include "threadpool.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_map>
+
+#if defined(__GNUC__)
+#define ES_THREADED_DISPATCH 1
+#endif
+
+namespace EScript {
+
+namespace {
+
+// Output is buffered per thread and handed to stdio in large writes
+constexpr size_t kFlushBytes = 64 * 1024;
+
+[[noreturn]] void runError(const std::string& message) {
+    throw std::runtime_error("Run error: " + message);
+}
+
+// Holds the store lock only while other threads can race on it
+class StoreLock {
+    std::unique_lock<std::mutex> lock;
+
+public:
+    StoreLock(std::mutex& m, bool shared) : lock(m, std::defer_lock) {
+        if (shared) lock.lock();
+    }
+};
+
+} // namespace
+
+struct Interpreter::Context {
+    std::string out;        // pending output of this thread
+    bool shared = false;    // other threads may touch the store
+    size_t running = 0;     // lanes started here and not yet joined
+};
+
+struct Interpreter::LaneState {
+    std::mutex m;
+    std::condition_variable cv;
+    bool started = false;
+    bool joined = false;
+    bool done = false;
+    std::exception_ptr error;
+    uint64_t executed = 0;
+};
+
+Interpreter::Interpreter(const IRProgram& ir) {
+    compile(ir);
+}
+
+Interpreter::~Interpreter() = default;
+
+bool Interpreter::threadedDispatchAvailable() {
+#ifdef ES_THREADED_DISPATCH
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Interpreter::compile(const IRProgram& ir) {
+    plan = planLanes(ir);
+    channelPlan = planChannels(ir, plan);
+
+    std::unordered_map<std::string_view, uint32_t> slotOf;
+    std::unordered_map<SymbolId, uint32_t> lineOf;
+    std::unordered_map<SymbolId, uint32_t> constantOf;
+
+    auto container = [&](std::string_view name) {
+        auto it = slotOf.find(name);
+        if (it != slotOf.end()) return it->second;
+        uint32_t slot = static_cast<uint32_t>(names.size());
+        names.emplace_back(name);
+        slotOf.emplace(name, slot);
+        return slot;
+    };
+
+    // Literal printed by `process write`, with its newline
+    auto line = [&](SymbolId lit) {
+        auto it = lineOf.find(lit);
+        if (it != lineOf.end()) return it->second;
+        uint32_t index = static_cast<uint32_t>(texts.size());
+        texts.push_back(std::string(unquote(ir.text(lit))) + "\n");
+        lineOf.emplace(lit, index);
+        return index;
+    };
+
+    // Numbers become Int (Real when fractional or too large), strings Text
+    auto constant = [&](SymbolId sym) {
+        auto it = constantOf.find(sym);
+        if (it != constantOf.end()) return it->second;
+        std::string_view text = ir.text(sym);
+        Value v;
+        if (ir.symbols.isString(sym)) {
+            v.kind = Value::Kind::Text;
+            v.text = std::string(unquote(text));
+        } else if (isNumberText(text)) {
+            v.kind = Value::Kind::Int;
+            for (char c : text) {
+                if (c < '0' || c > '9' || v.i > (INT64_MAX - 9) / 10) {
+                    v.kind = Value::Kind::Real;
+                    break;
+                }
+                v.i = v.i * 10 + (c - '0');
+            }
+            if (v.kind == Value::Kind::Real) {
+                v.r = std::strtod(std::string(text).c_str(), nullptr);
+                v.i = 0;
+            }
+        } else {
+            // Empty operand
+            v.kind = Value::Kind::Int;
+        }
+        uint32_t index = static_cast<uint32_t>(constants.size());
+        constants.push_back(std::move(v));
+        constantOf.emplace(sym, index);
+        return index;
+    };
+
+    auto lower = [&](size_t i) {
+        const IRInstr in = ir.at(i);
+        std::string_view arg1 = ir.text(in.arg1);
+        std::string_view arg2 = ir.text(in.arg2);
+
+        switch (in.op) {
+        case IROp::PROCESS:
+            if (arg1 == "write") {
+                if (ir.symbols.isString(in.arg2)) {
+                    code.push_back(BInstr{BOp::WriteText, line(in.arg2), 0});
+                } else if (!arg2.empty()) {
+                    code.push_back(BInstr{BOp::WriteVar, container(arg2), 0});
+                }
+            } else if (arg1 == "read") {
+                if (ir.symbols.isString(in.arg2)) {
+                    std::string_view path = unquote(arg2);
+                    uint32_t index = static_cast<uint32_t>(texts.size());
+                    texts.emplace_back(path);
+                    code.push_back(BInstr{BOp::ReadFile, container(fileStem(path)), index});
+                } else if (!arg2.empty()) {
+                    code.push_back(BInstr{BOp::ReadLine, container(arg2), 0});
+                }
+            }
+            break;
+        case IROp::CREATE:
+        case IROp::MODIFY:
+            if (isContainerRef(ir.symbols, in.arg2)) {
+                code.push_back(BInstr{BOp::StoreVar, container(arg1), container(arg2)});
+            } else {
+                code.push_back(BInstr{BOp::Store, container(arg1), constant(in.arg2)});
+            }
+            break;
+        case IROp::ADJUST:
+            if (isContainerRef(ir.symbols, in.arg2)) {
+                code.push_back(BInstr{BOp::AddVar, container(arg1), container(arg2)});
+            } else if (!arg2.empty()) {
+                code.push_back(BInstr{BOp::Add, container(arg1), constant(in.arg2)});
+            }
+            break;
+        case IROp::DELETE:
+            code.push_back(BInstr{BOp::Delete, container(arg1), 0});
+            break;
+        case IROp::SEND:
+            if (isContainerRef(ir.symbols, in.arg2)) {
+                code.push_back(BInstr{BOp::SendVar, channelPlan.of(in.arg1), container(arg2)});
+            } else {
+                code.push_back(BInstr{BOp::Send, channelPlan.of(in.arg1), constant(in.arg2)});
+            }
+            break;
+        case IROp::RECEIVE:
+            code.push_back(BInstr{BOp::Receive, channelPlan.of(in.arg1), container(arg2)});
+            break;
+        default:
+            // BYPASS, DEPLOY, CHANNEL, ping/analyze and lane markers do no work here
+            break;
+        }
+    };
+
+    // Main code; lane statements become a Spawn at their first statement
+    size_t nextJoin = 0;
+    for (size_t i = 0; i < ir.size(); ++i) {
+        if (plan.inLane[i]) {
+            if (plan.spawnAt[i]) {
+                code.push_back(BInstr{BOp::Spawn, plan.spawnAt[i] - 1, 0});
+            }
+        } else {
+            lower(i);
+        }
+        while (nextJoin < plan.joins.size() && plan.joins[nextJoin].at == i) {
+            code.push_back(BInstr{BOp::Join, static_cast<uint32_t>(nextJoin++), 0});
+        }
+    }
+    while (nextJoin < plan.joins.size()) {
+        code.push_back(BInstr{BOp::Join, static_cast<uint32_t>(nextJoin++), 0});
+    }
+    code.push_back(BInstr{BOp::Halt, 0, 0});
+
+    // Lane bodies
+    for (const LaneInstance& lane : plan.instances) {
+        laneEntry.push_back(static_cast<uint32_t>(code.size()));
+        laneNames.emplace_back(ir.text(lane.lane));
+        for (uint32_t i : lane.body) lower(i);
+        code.push_back(BInstr{BOp::LaneExit, 0, 0});
+    }
+}
+
+uint64_t Interpreter::run(const RunOptions& opts) {
+    ES_TIME_SCOPE("run");
+    options = &opts;
+    store.assign(names.size(), Value{});
+    laneStates.clear();
+    for (size_t k = 0; k < plan.instances.size(); ++k) {
+        laneStates.push_back(std::make_unique<LaneState>());
+    }
+    channels.clear();
+    cancelCause = nullptr;
+    for (const ChannelInfo& c : channelPlan.channels) {
+        channels.push_back(std::make_unique<Channel<Value>>(c.capacity, c.singleProducer, c.singleConsumer));
+    }
+    if (!plan.instances.empty()) {
+        size_t threads = opts.threads ? opts.threads : std::thread::hardware_concurrency();
+        if (!channels.empty()) threads = plan.slotCount;
+        threads = std::max<size_t>(1, std::min<size_t>(threads, plan.slotCount));
+        pool = std::make_unique<ThreadPool>(threads);
+    }
+
+    Context ctx;
+    uint64_t executed = 0;
+    try {
+        executed = execute(0, ctx);
+        flush(ctx);
+    } catch (...) {
+        flush(ctx);
+        cancelChannels(std::current_exception());
+        // Lanes still running reference this run's state
+        for (size_t k = 0; k < laneStates.size(); ++k) {
+            if (laneStates[k]->started && !laneStates[k]->joined) waitLane(static_cast<uint32_t>(k));
+        }
+        pool.reset();
+        std::fflush(opts.out);
+        // Report the failure that cancelled the channels, not a cancellation
+        if (cancelCause) std::rethrow_exception(cancelCause);
+        throw;
+    }
+    pool.reset();
+
+    for (const auto& lane : laneStates) executed += lane->executed;
+    std::fflush(opts.out);
+    return executed;
+}
+
+uint64_t Interpreter::execute(uint32_t entry, Context& ctx) {
+#ifdef ES_THREADED_DISPATCH
+    if (options->dispatch == Dispatch::Threaded) {
+        return executeThreaded(code.data() + entry, ctx);
+    }
+#endif
+    return executeSwitch(code.data() + entry, ctx);
+}
+
+uint64_t Interpreter::executeSwitch(const BInstr* pc, Context& ctx) {
+    uint64_t executed = 0;
+    for (;; ++pc) {
+        executed++;
+        switch (pc->op) {
+        case BOp::WriteText:
+            ctx.out += texts[pc->a];
+            if (ctx.out.size() >= kFlushBytes) flush(ctx);
+            break;
+        case BOp::WriteVar: opWriteVar(*pc, ctx); break;
+        case BOp::ReadFile: opReadFile(*pc, ctx); break;
+        case BOp::ReadLine: opReadLine(*pc, ctx); break;
+        case BOp::Store:    opStore(*pc, ctx); break;
+        case BOp::StoreVar: opStoreVar(*pc, ctx); break;
+        case BOp::Add:      opAdd(*pc, ctx); break;
+        case BOp::AddVar:   opAddVar(*pc, ctx); break;
+        case BOp::Delete:   opDelete(*pc, ctx); break;
+        case BOp::Send:     opSend(*pc, ctx); break;
+        case BOp::SendVar:  opSendVar(*pc, ctx); break;
+        case BOp::Receive:  opReceive(*pc, ctx); break;
+        case BOp::Spawn:    opSpawn(*pc, ctx); break;
+        case BOp::Join:     opJoin(*pc, ctx); break;
+        case BOp::LaneExit:
+        case BOp::Halt:
+            return executed;
+        }
+    }
+}
+
+#ifdef ES_THREADED_DISPATCH
+uint64_t Interpreter::executeThreaded(const BInstr* pc, Context& ctx) {
+    // One indirect jump per handler instead of a shared switch jump
+    static void* const targets[] = {
+        &&WriteText, &&WriteVar, &&ReadFile, &&ReadLine, &&Store, &&StoreVar,
+        &&Add, &&AddVar, &&Delete, &&Send, &&SendVar, &&Receive, &&Spawn, &&Join,
+        &&Exit, &&Exit
+    };
+    uint64_t executed = 0;
+
+#define ES_DISPATCH() do { executed++; goto *targets[static_cast<size_t>(pc->op)]; } while (0)
+#define ES_NEXT() do { ++pc; ES_DISPATCH(); } while (0)
+
+    ES_DISPATCH();
+WriteText:
+    ctx.out += texts[pc->a];
+    if (ctx.out.size() >= kFlushBytes) flush(ctx);
+    ES_NEXT();
+WriteVar: opWriteVar(*pc, ctx); ES_NEXT();
+ReadFile: opReadFile(*pc, ctx); ES_NEXT();
+ReadLine: opReadLine(*pc, ctx); ES_NEXT();
+Store:    opStore(*pc, ctx); ES_NEXT();
+StoreVar: opStoreVar(*pc, ctx); ES_NEXT();
+Add:      opAdd(*pc, ctx); ES_NEXT();
+AddVar:   opAddVar(*pc, ctx); ES_NEXT();
+Delete:   opDelete(*pc, ctx); ES_NEXT();
+Send:     opSend(*pc, ctx); ES_NEXT();
+SendVar:  opSendVar(*pc, ctx); ES_NEXT();
+Receive:  opReceive(*pc, ctx); ES_NEXT();
+Spawn:    opSpawn(*pc, ctx); ES_NEXT();
+Join:     opJoin(*pc, ctx); ES_NEXT();
+Exit:
+    return executed;
+
+#undef ES_NEXT
+#undef ES_DISPATCH
+}
+#endif
+
+void Interpreter::flush(Context& ctx) {
+    if (ctx.out.empty()) return;
+    std::fwrite(ctx.out.data(), 1, ctx.out.size(), options->out);
+    ctx.out.clear();
+}
+
+const Interpreter::Value& Interpreter::load(uint32_t slot) const {
+    if (store[slot].kind == Value::Kind::None) {
+        runError("container '" + names[slot] + "' does not exist");
+    }
+    return store[slot];
+}
+
+void Interpreter::appendValue(std::string& out, const Value& v) {
+    switch (v.kind) {
+    case Value::Kind::Int:
+        out += std::to_string(v.i);
+        break;
+    case Value::Kind::Real: {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.15g", v.r);
+        out += buf;
+        break;
+    }
+    case Value::Kind::Text:
+        out += v.text;
+        break;
+    case Value::Kind::None:
+        break;
+    }
+}
+
+void Interpreter::addInto(Value& dst, const Value& v, const std::string& name) {
+    if (dst.kind == Value::Kind::None) {
+        dst.kind = Value::Kind::Int;
+        dst.i = 0;
+    }
+    if (dst.kind == Value::Kind::Text || v.kind == Value::Kind::Text) {
+        runError("cannot adjust '" + name + "' by a non-numeric value");
+    }
+    if (dst.kind == Value::Kind::Int && v.kind == Value::Kind::Int) {
+        bool overflow = (v.i > 0 && dst.i > INT64_MAX - v.i) || (v.i < 0 && dst.i < INT64_MIN - v.i);
+        if (!overflow) {
+            dst.i += v.i;
+            return;
+        }
+    }
+    double a = dst.kind == Value::Kind::Int ? static_cast<double>(dst.i) : dst.r;
+    double b = v.kind == Value::Kind::Int ? static_cast<double>(v.i) : v.r;
+    dst.kind = Value::Kind::Real;
+    dst.i = 0;
+    dst.r = a + b;
+}
+
+void Interpreter::opWriteVar(const BInstr& in, Context& ctx) {
+    {
+        StoreLock lock(storeMutex, ctx.shared);
+        appendValue(ctx.out, load(in.a));
+    }
+    ctx.out += '\n';
+    if (ctx.out.size() >= kFlushBytes) flush(ctx);
+}
+
+void Interpreter::opReadFile(const BInstr& in, Context& ctx) {
+    const std::string& path = texts[in.b];
+    std::string resolved;
+    if (!options->dir.empty() && std::filesystem::path(path).is_relative()) {
+        resolved = (std::filesystem::path(options->dir) / path).string();
+    }
+    std::FILE* f = std::fopen(resolved.empty() ? path.c_str() : resolved.c_str(), "rb");
+    if (!f) runError("cannot read '" + path + "'");
+    Value v;
+    v.kind = Value::Kind::Text;
+    char buf[64 * 1024];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) v.text.append(buf, n);
+    std::fclose(f);
+
+    StoreLock lock(storeMutex, ctx.shared);
+    store[in.a] = std::move(v);
+}
+
+void Interpreter::opReadLine(const BInstr& in, Context& ctx) {
+    Value v;
+    v.kind = Value::Kind::Text;
+    {
+        std::lock_guard<std::mutex> input(inputMutex);
+        int c;
+        while ((c = std::fgetc(options->in)) != EOF && c != '\n') {
+            v.text += static_cast<char>(c);
+        }
+    }
+    if (!v.text.empty() && v.text.back() == '\r') v.text.pop_back();
+
+    StoreLock lock(storeMutex, ctx.shared);
+    store[in.a] = std::move(v);
+}
+
+void Interpreter::opStore(const BInstr& in, Context& ctx) {
+    StoreLock lock(storeMutex, ctx.shared);
+    store[in.a] = constants[in.b];
+}
+
+void Interpreter::opStoreVar(const BInstr& in, Context& ctx) {
+    StoreLock lock(storeMutex, ctx.shared);
+    if (in.a != in.b) store[in.a] = load(in.b);
+}
+
+void Interpreter::opAdd(const BInstr& in, Context& ctx) {
+    StoreLock lock(storeMutex, ctx.shared);
+    addInto(store[in.a], constants[in.b], names[in.a]);
+}
+
+void Interpreter::opAddVar(const BInstr& in, Context& ctx) {
+    StoreLock lock(storeMutex, ctx.shared);
+    Value v = load(in.b);
+    addInto(store[in.a], v, names[in.a]);
+}
+
+void Interpreter::opDelete(const BInstr& in, Context& ctx) {
+    StoreLock lock(storeMutex, ctx.shared);
+    store[in.a] = Value{};
+}
+
+void Interpreter::opSend(const BInstr& in, Context&) {
+    channels[in.a]->send(constants[in.b]);
+}
+
+void Interpreter::opSendVar(const BInstr& in, Context& ctx) {
+    // Copy under the store lock; block in send without it
+    Value v;
+    {
+        StoreLock lock(storeMutex, ctx.shared);
+        v = load(in.b);
+    }
+    channels[in.a]->send(std::move(v));
+}
+
+void Interpreter::opReceive(const BInstr& in, Context& ctx) {
+    Value v = channels[in.a]->receive();
+    StoreLock lock(storeMutex, ctx.shared);
+    store[in.b] = std::move(v);
+}
+
+void Interpreter::opSpawn(const BInstr& in, Context& ctx) {
+    // Output written before the spawn stays ahead of the lane's
+    flush(ctx);
+    const uint32_t k = in.a;
+    laneStates[k]->started = true;
+    ctx.running++;
+    ctx.shared = true;
+
+    pool->submit([this, k] {
+        ES_TIME_SCOPE_CAT(laneNames[k], "lane");
+        LaneState& state = *laneStates[k];
+        Context lane;
+        lane.shared = true;
+        uint64_t executed = 0;
+        try {
+            executed = execute(laneEntry[k], lane);
+            flush(lane);
+        } catch (...) {
+            state.error = std::current_exception();
+            // Lanes waiting on this one through a channel would never wake
+            cancelChannels(state.error);
+        }
+        {
+            std::lock_guard<std::mutex> lock(state.m);
+            state.executed = executed;
+            state.done = true;
+        }
+        state.cv.notify_all();
+    });
+}
+
+void Interpreter::waitLane(uint32_t instance) {
+    LaneState& state = *laneStates[instance];
+    std::unique_lock<std::mutex> lock(state.m);
+    state.cv.wait(lock, [&] { return state.done; });
+    state.joined = true;
+}
+
+void Interpreter::cancelChannels(std::exception_ptr cause) {
+    if (channels.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(cancelMutex);
+        if (cancelCause) return;
+        cancelCause = cause;
+    }
+    for (auto& channel : channels) channel->cancel();
+}
+
+void Interpreter::opJoin(const BInstr& in, Context& ctx) {
+    for (uint32_t k : plan.joins[in.a].instances) {
+        waitLane(k);
+        ctx.running--;
+        if (laneStates[k]->error) {
+            ctx.shared = ctx.running > 0;
+            std::rethrow_exception(laneStates[k]->error);
+        }
+    }
+    ctx.shared = ctx.running > 0;
+}
+
+} // namespace EScript
@@ -0,0 +1,143 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "channels.hpp"
+#include "ir.hpp"
+#include "lanes.hpp"
+
+namespace EScript {
+
+class ThreadPool;
+
+// Bytecode dispatch strategy. Threaded uses computed goto where the
+// compiler supports it (GCC, Clang) and falls back to Switch elsewhere.
+enum class Dispatch : uint8_t { Threaded, Switch };
+
+struct RunOptions {
+    std::FILE* out = stdout;        // process write
+    std::FILE* in = stdin;          // process read <ident>
+    Dispatch dispatch = Dispatch::Threaded;
+    size_t threads = 0;             // lane workers, 0 = one per core
+    std::string dir;                // relative read paths resolve here; empty: working directory
+};
+
+// Runs an IRProgram in-process for -run, with no assembler or linker.
+//
+// The IR is lowered once to a flat bytecode. Containers are created,
+// stored and adjusted as the optimizer models them (CREATE/MODIFY store,
+// ADJUST adds, missing containers adjust from 0). `process write` prints
+// a literal or a container, `process read "dir/name.ext"` loads the file
+// into container `name` and `process read name` reads a line of input.
+// Lane instances from planLanes run on a thread pool and syncs wait for
+// them, matching the compiled program's schedule. Channels carry copies
+// of values; a program that uses them gets one pool thread per lane
+// slot, since a lane blocked in send/receive holds its thread.
+class Interpreter {
+public:
+    explicit Interpreter(const IRProgram& ir);
+    ~Interpreter();
+
+    Interpreter(const Interpreter&) = delete;
+    Interpreter& operator=(const Interpreter&) = delete;
+
+    // Runs the program on fresh containers and returns the number of
+    // bytecode ops dispatched. Throws std::runtime_error on runtime errors.
+    uint64_t run(const RunOptions& opts = {});
+
+    size_t codeSize() const { return code.size(); }
+    static bool threadedDispatchAvailable();
+
+private:
+    enum class BOp : uint8_t {
+        WriteText,  // a: text
+        WriteVar,   // a: container
+        ReadFile,   // a: container, b: text holding the path
+        ReadLine,   // a: container
+        Store,      // a: container, b: constant
+        StoreVar,   // a: container, b: source container
+        Add,        // a: container, b: constant
+        AddVar,     // a: container, b: source container
+        Delete,     // a: container
+        Send,       // a: channel, b: constant
+        SendVar,    // a: channel, b: container
+        Receive,    // a: channel, b: container
+        Spawn,      // a: lane instance
+        Join,       // a: lane join
+        LaneExit,
+        Halt
+    };
+
+    struct BInstr {
+        BOp op;
+        uint32_t a;
+        uint32_t b;
+    };
+
+    struct Value {
+        enum class Kind : uint8_t { None, Int, Real, Text };
+        Kind kind = Kind::None;
+        int64_t i = 0;
+        double r = 0.0;
+        std::string text;
+    };
+
+    struct LaneState;
+    struct Context;
+
+    std::vector<BInstr> code;
+    std::vector<uint32_t> laneEntry;        // bytecode offset per lane instance
+    std::vector<std::string> laneNames;     // lane label per instance, for traces
+    std::vector<std::string> texts;         // output lines and read paths
+    std::vector<Value> constants;
+    std::vector<std::string> names;         // container names, for errors
+    LanePlan plan;
+    ChannelPlan channelPlan;
+
+    // Per-run state
+    const RunOptions* options = nullptr;
+    std::vector<Value> store;
+    std::mutex storeMutex;           // held by lane threads and by main while lanes run
+    std::mutex inputMutex;
+    std::vector<std::unique_ptr<LaneState>> laneStates;
+    std::vector<std::unique_ptr<Channel<Value>>> channels;
+    std::mutex cancelMutex;
+    std::exception_ptr cancelCause;         // first failure once channels are cancelled
+    std::unique_ptr<ThreadPool> pool;
+
+    void compile(const IRProgram& ir);
+
+    uint64_t execute(uint32_t entry, Context& ctx);
+    uint64_t executeSwitch(const BInstr* pc, Context& ctx);
+#if defined(__GNUC__)
+    uint64_t executeThreaded(const BInstr* pc, Context& ctx);
+#endif
+
+    void opWriteVar(const BInstr& in, Context& ctx);
+    void opReadFile(const BInstr& in, Context& ctx);
+    void opReadLine(const BInstr& in, Context& ctx);
+    void opStore(const BInstr& in, Context& ctx);
+    void opStoreVar(const BInstr& in, Context& ctx);
+    void opAdd(const BInstr& in, Context& ctx);
+    void opAddVar(const BInstr& in, Context& ctx);
+    void opDelete(const BInstr& in, Context& ctx);
+    void opSend(const BInstr& in, Context& ctx);
+    void opSendVar(const BInstr& in, Context& ctx);
+    void opReceive(const BInstr& in, Context& ctx);
+    void opSpawn(const BInstr& in, Context& ctx);
+    void opJoin(const BInstr& in, Context& ctx);
+
+    void flush(Context& ctx);
+    void waitLane(uint32_t instance);
+    void cancelChannels(std::exception_ptr cause);
+    const Value& load(uint32_t slot) const;
+    static void addInto(Value& dst, const Value& v, const std::string& name);
+    static void appendValue(std::string& out, const Value& v);
+};
+
+} // namespace EScript
@@ -1,64 +1,432 @@
 #include "ir.hpp"
+#include "pool.hpp"
+#include "profile.hpp"
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
 
 namespace EScript {
 
-std::vector<IRInstr> generateIR(const Program& prog) {
-    std::vector<IRInstr> ir;
- int labelCounter = 0;
+const char* irOpName(IROp op) {
+    static const char* const names[] = {
+        "MODIFY", "ADJUST", "BYPASS", "DELETE", "PROCESS", "CREATE",
+        "DEPLOY", "LANE_START", "LANE_END", "SYNC", "SYNC_ALL",
+        "CHANNEL", "SEND", "RECEIVE"
+    };
+    return names[static_cast<size_t>(op)];
+}
+
+void IRProgram::reserve(size_t n) {
+    ops.reserve(n);
+    arg1.reserve(n);
+    arg2.reserve(n);
+    lane.reserve(n);
+    loc.reserve(n);
+}
 
-    for (const auto& opPtr : prog.ops) {
-   const auto& op = *opPtr;
-   
-        // Generate IR based on operation type
- if (op.op == "modify") {
-            ir.push_back(IRInstr("MODIFY", op.ident, op.value));
+void IRProgram::push(IROp op, SymbolId a1, SymbolId a2, SymbolId laneId, SourceLoc where) {
+    ops.push_back(op);
+    arg1.push_back(a1);
+    arg2.push_back(a2);
+    lane.push_back(laneId);
+    loc.push_back(where);
+}
+
+namespace {
+
+std::string where(const Operation& op) {
+    return " at line " + std::to_string(op.line) + ", column " + std::to_string(op.column);
+}
+
+// Lowers AST operations, resolving `call` against the program's own
+// `define`s and then the pools it uses
+class IRLowering {
+public:
+    IRLowering(const Program& p, IRProgram& out, PoolSet* poolSet)
+        : prog(p), ir(out), pools(poolSet ? *poolSet : localPools) {
+        // Defines may follow their calls
+        for (size_t i = 0; i < prog.size(); ++i) {
+            const Operation& op = prog.op(i);
+            if (op.kind != TokenKind::KW_DEFINE) continue;
+            auto [it, added] = defines.try_emplace(op.ident);
+            if (added) order.push_back(op.ident);
+            if (op.nested != kNoNode) it->second.push_back(op.nested);
         }
-        else if (op.op == "adjust") {
-    ir.push_back(IRInstr("ADJUST", op.ident, op.value));
+    }
+
+    void operation(const Operation& op, SymbolId laneId);
+    void entry(std::string_view name, SymbolId laneId, const Operation& site);
+
+    // Names of the program's defines, in order of first definition
+    const std::vector<std::string_view>& defineOrder() const { return order; }
+
+private:
+    const Program& prog;
+    IRProgram& ir;
+    PoolSet localPools{{"."}};
+    PoolSet& pools;
+    std::unordered_map<std::string_view, std::vector<uint32_t>> defines;
+    std::vector<std::string_view> order;
+    std::vector<std::string_view> active;   // entries being expanded
+
+    void call(const Operation& op, SymbolId laneId);
+};
+
+void IRLowering::operation(const Operation& op, SymbolId laneId) {
+    SymbolTable& sym = ir.symbols;
+    const SourceLoc at{op.line, op.column};
+
+    // Generate IR based on operation type
+    switch (op.kind) {
+    case TokenKind::KW_MODIFY:
+        ir.push(IROp::MODIFY, sym.intern(op.ident), sym.intern(op.value), laneId, at);
+        break;
+    case TokenKind::KW_ADJUST:
+        ir.push(IROp::ADJUST, sym.intern(op.ident), sym.intern(op.value), laneId, at);
+        break;
+    case TokenKind::KW_BYPASS:
+        ir.push(IROp::BYPASS, sym.intern(op.ident), kNoSymbol, laneId, at);
+        break;
+    case TokenKind::KW_DELETE:
+        ir.push(IROp::DELETE, sym.intern(op.ident), kNoSymbol, laneId, at);
+        break;
+    case TokenKind::KW_PROCESS:
+        ir.push(IROp::PROCESS, sym.intern(op.ident), sym.intern(op.value), laneId, at);
+        break;
+    case TokenKind::KW_CREATE:
+        ir.push(IROp::CREATE, sym.intern(op.ident), sym.intern(op.value), laneId, at);
+        break;
+    case TokenKind::KW_DEPLOY:
+        ir.push(IROp::DEPLOY, sym.intern(op.ident), sym.intern(op.value), laneId, at);
+        break;
+    case TokenKind::KW_LANE: {
+        // Generate lane label
+        SymbolId ident = sym.intern(op.ident);
+        SymbolId label = sym.internCopy("lane_" + std::string(op.ident));
+        ir.push(IROp::LANE_START, ident, kNoSymbol, label, at);
+
+        // Nested operation runs inside the lane
+        if (const Operation* nested = prog.nestedOf(op)) {
+            operation(*nested, label);
         }
-      else if (op.op == "bypass") {
-  ir.push_back(IRInstr("BYPASS", op.ident, ""));
-     }
-        else if (op.op == "delete") {
-      ir.push_back(IRInstr("DELETE", op.ident, ""));
+
+        ir.push(IROp::LANE_END, ident, kNoSymbol, label, at);
+        break;
+    }
+    case TokenKind::KW_SYNC:
+        if (!op.ident.empty()) {
+            ir.push(IROp::SYNC, sym.intern(op.ident), kNoSymbol, laneId, at);
+        } else {
+            ir.push(IROp::SYNC_ALL, kNoSymbol, kNoSymbol, laneId, at);
         }
-  else if (op.op == "process") {
-       ir.push_back(IRInstr("PROCESS", op.ident, op.value));
+        break;
+    case TokenKind::KW_CHANNEL:
+        ir.push(IROp::CHANNEL, sym.intern(op.ident), sym.intern(op.value), laneId, at);
+        break;
+    case TokenKind::KW_SEND:
+        ir.push(IROp::SEND, sym.intern(op.ident), sym.intern(op.value), laneId, at);
+        break;
+    case TokenKind::KW_RECEIVE:
+        ir.push(IROp::RECEIVE, sym.intern(op.ident), sym.intern(op.value), laneId, at);
+        break;
+    case TokenKind::KW_USE:
+        if (op.ident != "pool" || op.value.size() < 2 || op.value[0] != '"') {
+            throw std::runtime_error("Expected use pool \"<name>\"" + where(op));
         }
-        else if (op.op == "create") {
- ir.push_back(IRInstr("CREATE", op.ident, op.value));
+        pools.use(op.value.substr(1, op.value.size() - 2));
+        break;
+    case TokenKind::KW_CALL:
+        call(op, laneId);
+        break;
+    case TokenKind::KW_DEFINE:
+        // Expanded where it is called
+        if (laneId != kNoSymbol) {
+            throw std::runtime_error("define must be a top-level statement" + where(op));
         }
-        else if (op.op == "deploy") {
-          ir.push_back(IRInstr("DEPLOY", op.ident, op.value));
+        break;
+    default:
+        break;
+    }
+}
+
+void IRLowering::call(const Operation& op, SymbolId laneId) {
+    if (op.ident.empty()) {
+        throw std::runtime_error("call needs an entry name" + where(op));
+    }
+
+    // Without "from", the program's own defines come first
+    if (op.value.empty() && defines.count(op.ident)) {
+        entry(op.ident, laneId, op);
+        return;
+    }
+
+    if (!op.value.empty() && op.value[0] == '"') {
+        std::string_view name = op.value.substr(1, op.value.size() - 2);
+        const PoolModule* pool = pools.used(name);
+        if (!pool) {
+            throw std::runtime_error("Pool '" + std::string(name) + "' is not used" + where(op));
         }
-    else if (op.op == "lane") {
-         // Generate lane label
-      std::string laneLabel = "lane_" + op.ident;
-  ir.push_back(IRInstr("LANE_START", op.ident, "", laneLabel));
-          
-      // Process nested operation
-   if (op.nested) {
- // Recursively generate IR for nested operation
-     if (op.nested->op == "process") {
-  ir.push_back(IRInstr("PROCESS", op.nested->ident, op.nested->value, laneLabel));
-      } else {
- ir.push_back(IRInstr(op.nested->op, op.nested->ident, op.nested->value, laneLabel));
-    }
-         }
-    
-  ir.push_back(IRInstr("LANE_END", op.ident, "", laneLabel));
+        int64_t index = pool->find(op.ident);
+        if (index >= 0) {
+            pool->append(static_cast<uint32_t>(index), ir, laneId, SourceLoc{op.line, op.column});
+            pools.countCall();
+            return;
         }
-        else if (op.op == "sync") {
-      if (!op.ident.empty()) {
-             ir.push_back(IRInstr("SYNC", op.ident, ""));
     } else {
-  ir.push_back(IRInstr("SYNC_ALL", "", ""));
+        for (const auto& pool : pools.modules()) {
+            int64_t index = pool->find(op.ident);
+            if (index >= 0) {
+                pool->append(static_cast<uint32_t>(index), ir, laneId, SourceLoc{op.line, op.column});
+                pools.countCall();
+                return;
             }
+        }
     }
+    throw std::runtime_error("Unknown entry '" + std::string(op.ident) + "'" + where(op));
 }
+
+void IRLowering::entry(std::string_view name, SymbolId laneId, const Operation& site) {
+    if (std::find(active.begin(), active.end(), name) != active.end()) {
+        throw std::runtime_error("Entry '" + std::string(name) + "' calls itself" + where(site));
+    }
+    active.push_back(name);
+    for (uint32_t node : defines.at(name)) {
+        operation(prog.node(node), laneId);
+    }
+    active.pop_back();
+}
+
+} // namespace
+
+IRProgram generateIR(const Program& prog, PoolSet* pools) {
+    ES_TIME_SCOPE("generateIR");
+    IRProgram ir;
+    ir.reserve(prog.nodeCount + prog.size());
+
+    IRLowering lowering(prog, ir, pools);
+    for (size_t i = 0; i < prog.size(); ++i) {
+        lowering.operation(prog.op(i), kNoSymbol);
+    }
     
     return ir;
 }
 
+IRProgram generatePoolIR(const Program& prog, std::vector<PoolEntryRange>& entries, PoolSet* pools) {
+    ES_TIME_SCOPE("generateIR");
+    IRProgram ir;
+    ir.reserve(prog.nodeCount);
+
+    // Pools the source uses must load before its defines expand
+    IRLowering lowering(prog, ir, pools);
+    for (size_t i = 0; i < prog.size(); ++i) {
+        const Operation& op = prog.op(i);
+        if (op.kind == TokenKind::KW_USE) {
+            lowering.operation(op, kNoSymbol);
+        } else if (op.kind != TokenKind::KW_DEFINE) {
+            throw std::runtime_error("Pool sources hold only define and use statements" + where(op));
+        }
+    }
+
+    entries.clear();
+    for (std::string_view name : lowering.defineOrder()) {
+        PoolEntryRange range;
+        range.name = ir.symbols.intern(name);
+        range.first = static_cast<uint32_t>(ir.size());
+        lowering.entry(name, kNoSymbol, prog.op(0));
+        range.count = static_cast<uint32_t>(ir.size() - range.first);
+        entries.push_back(range);
+    }
+    return ir;
+}
+
+namespace {
+
+constexpr char kIRMagic[4] = {'E', 'S', 'I', 'R'};
+constexpr size_t kIRHeaderWords = 8;
+
+void putU32(std::string& out, uint32_t v) {
+    appendLE32(out, v);
+}
+
+template <typename T>
+void putColumn(std::string& out, const std::vector<T>& column) {
+    if (sizeof(T) == 1) {
+        out.append(reinterpret_cast<const char*>(column.data()), column.size());
+    } else {
+        appendLEWords(out, column.data(), column.size() * sizeof(T));
+    }
+}
+
+template <typename T>
+void copyColumn(std::vector<T>& out, const char* from, size_t n) {
+    out.resize(n);
+    if (sizeof(T) == 1) {
+        std::memcpy(out.data(), from, n);
+    } else {
+        copyLEWords(out.data(), from, n * sizeof(T));
+    }
+}
+
+// Columns of a validated image into ir; symbols are copied, or kept as
+// views into the image bytes when those outlive ir
+void loadImage(const IRImage& image, const char* base, IRProgram& ir, bool copySymbols) {
+    image.validate();
+    for (SymbolId id = 1; id < image.symbolCount(); ++id) {
+        std::string_view text = image.text(id);
+        SymbolId got = copySymbols ? ir.symbols.internCopy(std::string(text)) : ir.symbols.intern(text);
+        if (got != id) {
+            throw std::runtime_error("Corrupt IR symbol table");
+        }
+    }
+
+    const size_t n = image.size();
+    ir.pooledLiterals = image.pooledLiterals();
+    const char* columns = base + image.columnsOffset();
+    copyColumn(ir.arg1, columns, n);
+    copyColumn(ir.arg2, columns + n * 4, n);
+    copyColumn(ir.lane, columns + n * 8, n);
+    copyColumn(ir.loc, columns + n * 12, n);
+    copyColumn(ir.ops, columns + n * 20, n);
+}
+
+} // namespace
+
+static_assert(sizeof(SourceLoc) == 8 && sizeof(IROp) == 1, "IR image columns assume these sizes");
+
+void appendLEWords(std::string& out, const void* words, size_t bytes) {
+    const char* p = static_cast<const char*>(words);
+    if (kLittleEndianHost) {
+        out.append(p, bytes);
+        return;
+    }
+    for (size_t i = 0; i + 4 <= bytes; i += 4) {
+        uint32_t v;
+        std::memcpy(&v, p + i, 4);
+        appendLE32(out, v);
+    }
+}
+
+void copyLEWords(void* words, const char* image, size_t bytes) {
+    char* p = static_cast<char*>(words);
+    if (kLittleEndianHost) {
+        std::memcpy(p, image, bytes);
+        return;
+    }
+    for (size_t i = 0; i + 4 <= bytes; i += 4) {
+        const uint32_t v = loadLE32(image + i);
+        std::memcpy(p + i, &v, 4);
+    }
+}
+
+std::string serializeIR(const IRProgram& ir) {
+    size_t blobBytes = 0;
+    for (SymbolId id = 0; id < ir.symbols.size(); ++id) blobBytes += ir.text(id).size();
+
+    std::string out;
+    out.reserve(kIRHeaderWords * 4 + ir.symbols.size() * 4 + blobBytes + ir.size() * 21 + 8);
+    out.append(kIRMagic, sizeof(kIRMagic));
+    putU32(out, kIRVersion);
+    putU32(out, ir.pooledLiterals ? 1 : 0);
+    putU32(out, static_cast<uint32_t>(ir.symbols.size()));
+    putU32(out, static_cast<uint32_t>(ir.size()));
+    putU32(out, static_cast<uint32_t>(blobBytes));
+    putU32(out, 0);
+    putU32(out, 0);
+
+    uint32_t offset = 0;
+    for (SymbolId id = 0; id < ir.symbols.size(); ++id) {
+        putU32(out, offset);
+        offset += static_cast<uint32_t>(ir.text(id).size());
+    }
+    putU32(out, offset);
+    for (SymbolId id = 0; id < ir.symbols.size(); ++id) out += ir.text(id);
+    while (out.size() % 4 != 0) out.push_back('\0');
+
+    putColumn(out, ir.arg1);
+    putColumn(out, ir.arg2);
+    putColumn(out, ir.lane);
+    putColumn(out, ir.loc);
+    putColumn(out, ir.ops);
+    return out;
+}
+
+IRProgram deserializeIR(std::string_view bytes) {
+    IRImage image(bytes);
+    IRProgram ir;
+    loadImage(image, bytes.data(), ir, true);
+    return ir;
+}
+
+void writeIR(const IRProgram& ir, const std::string& path) {
+    ES_TIME_SCOPE("writeIR");
+    std::string image = serializeIR(ir);
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) {
+        throw std::runtime_error("Cannot open file for writing: " + path);
+    }
+    size_t written = std::fwrite(image.data(), 1, image.size(), out);
+    bool ok = std::fclose(out) == 0 && written == image.size();
+    if (!ok) {
+        throw std::runtime_error("Failed writing IR: " + path);
+    }
+}
+
+IRImage::IRImage(std::string_view bytes) : base(bytes.data()) {
+    if (bytes.size() < kIRHeaderWords * 4 || std::memcmp(base, kIRMagic, sizeof(kIRMagic)) != 0 ||
+        word(4) != kIRVersion) {
+        throw std::runtime_error("Not an E-Script IR image");
+    }
+    flags = word(8);
+    symbols = word(12);
+    instrs = word(16);
+    blobBytes = word(20);
+
+    // Section offsets follow from the counts; the sizes must add up
+    blobAt = kIRHeaderWords * 4 + (static_cast<size_t>(symbols) + 1) * 4;
+    arg1At = blobAt + (static_cast<size_t>(blobBytes) + 3) / 4 * 4;
+    arg2At = arg1At + static_cast<size_t>(instrs) * 4;
+    laneAt = arg2At + static_cast<size_t>(instrs) * 4;
+    locAt = laneAt + static_cast<size_t>(instrs) * 4;
+    opsAt = locAt + static_cast<size_t>(instrs) * 8;
+    if (symbols == 0 || opsAt + instrs != bytes.size()) {
+        throw std::runtime_error("Truncated IR image");
+    }
+}
+
+uint32_t IRImage::word(size_t offset) const {
+    return loadLE32(base + offset);
+}
+
+std::string_view IRImage::text(SymbolId id) const {
+    const size_t at = kIRHeaderWords * 4 + static_cast<size_t>(id) * 4;
+    uint32_t begin = word(at);
+    uint32_t end = word(at + 4);
+    return std::string_view(base + blobAt + begin, end - begin);
+}
+
+void IRImage::validate() const {
+    uint32_t prev = 0;
+    for (size_t id = 0; id <= symbols; ++id) {
+        uint32_t offset = word(kIRHeaderWords * 4 + id * 4);
+        if (offset < prev || offset > blobBytes || (id == 0 && offset != 0) || (id == 1 && offset != 0)) {
+            throw std::runtime_error("Corrupt IR symbol table");
+        }
+        prev = offset;
+    }
+    for (size_t i = 0; i < instrs; ++i) {
+        if (static_cast<size_t>(op(i)) > static_cast<size_t>(IROp::RECEIVE) ||
+            arg1(i) >= symbols || arg2(i) >= symbols || lane(i) >= symbols) {
+            throw std::runtime_error("Corrupt IR instruction stream");
+        }
+    }
+}
+
+MappedIR::MappedIR(const std::string& path) : file(path) {
+    ES_TIME_SCOPE("loadIR");
+    std::string_view bytes = file.text();
+    loadImage(IRImage(bytes), bytes.data(), ir, false);
+}
+
 } // namespace EScript
@@ -1,24 +1,217 @@
 #pragma once
+#include <cstdint>
+#include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "parser.hpp"
+#include "source.hpp"
+#include "symbols.hpp"
 
 namespace EScript {
 
+enum class IROp : uint8_t {
+    MODIFY,
+    ADJUST,
+    BYPASS,
+    DELETE,
+    PROCESS,
+    CREATE,
+    DEPLOY,
+    LANE_START,
+    LANE_END,
+    SYNC,
+    SYNC_ALL,
+    CHANNEL,    // arg1: channel, arg2: capacity (may be empty)
+    SEND,       // arg1: channel, arg2: literal or container
+    RECEIVE     // arg1: channel, arg2: container
+};
+
+// Printable name of an opcode, e.g. "LANE_START"
+const char* irOpName(IROp op);
+
+// Source position of the statement an instruction came from; 0:0 for
+// instructions the compiler made up
+struct SourceLoc {
+    uint32_t line = 0;
+    uint32_t column = 0;
+};
+
+// One instruction, gathered from the columns of an IRProgram
 struct IRInstr {
-  std::string op;      // operation type
- std::string arg1;// first argument
-    std::string arg2;    // second argument
-    std::string label;   // optional label for jumps/lanes
+    IROp op;
+    SymbolId arg1;    // first argument
+    SymbolId arg2;    // second argument
+    SymbolId lane;    // lane label, kNoSymbol outside lanes
+    SourceLoc loc;
+};
+
+// IR stored structure-of-arrays: each column is one contiguous vector,
+// and every operand is an id into the program's symbol table.
+struct IRProgram {
+    SymbolTable symbols;
+    std::vector<IROp> ops;
+    std::vector<SymbolId> arg1;
+    std::vector<SymbolId> arg2;
+    std::vector<SymbolId> lane;
+    std::vector<SourceLoc> loc;
+    bool pooledLiterals = false;   // one data entry per distinct string literal
 
-    IRInstr() = default;
-    IRInstr(const std::string& o, const std::string& a1, const std::string& a2, const std::string& lbl = "")
-    : op(o), arg1(a1), arg2(a2), label(lbl) {}
+    size_t size() const { return ops.size(); }
+    IRInstr at(size_t i) const { return IRInstr{ops[i], arg1[i], arg2[i], lane[i], loc[i]}; }
+    std::string_view text(SymbolId id) const { return symbols.text(id); }
+
+    void reserve(size_t n);
+    void push(IROp op, SymbolId a1, SymbolId a2, SymbolId laneId = kNoSymbol, SourceLoc where = {});
 };
 
-// Function declarations
-std::vector<IRInstr> generateIR(const Program& prog);
-void emitNASM(const std::vector<IRInstr>& ir, const std::string& file);
-int autoLink(const std::string& asmFile, const std::string& outFile);
+class PoolSet;
+
+// Lowers the AST. `call` expands the program's own `define`s first, then
+// entries of the pools named by `use pool`, mapped through pools
+// (nullptr: a PoolSet searching the current directory). Throws
+// std::runtime_error on unknown pools and entries.
+IRProgram generateIR(const Program& prog, PoolSet* pools = nullptr);
+
+// Flat byte image of an IRProgram, used by the build cache and
+// -emit-ir-bin (.esir files). Every field sits at an offset computed
+// from the header, so the image is read in place:
+//   header      magic "ESIR", version, flags (1: pooled literals),
+//               symbolCount, instrCount, blobBytes, 0, 0
+//   symbols     symbolCount + 1 u32 offsets into the blob; symbol 0 is
+//               the empty string
+//   blob        symbol text, padded to 4 bytes
+//   columns     arg1, arg2, lane as u32, loc as {line, column} u32
+//               pairs, then ops as u8
+// All integers are little-endian. deserializeIR copies the symbols, so
+// the result does not depend on the bytes; it throws std::runtime_error
+// on a truncated, foreign or corrupt image.
+constexpr uint32_t kIRVersion = 2;
+
+// Little-endian image words. On little-endian hosts the column helpers
+// are plain copies; elsewhere every 4-byte word is byte-swapped.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool kLittleEndianHost = false;
+#else
+constexpr bool kLittleEndianHost = true;
+#endif
+
+inline uint32_t loadLE32(const char* p) {
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+    return b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
+}
+
+inline void appendLE32(std::string& out, uint32_t v) {
+    const char b[4] = {static_cast<char>(v), static_cast<char>(v >> 8), static_cast<char>(v >> 16),
+                       static_cast<char>(v >> 24)};
+    out.append(b, 4);
+}
+
+// Appends / copies bytes made of 4-byte words (u32 and SourceLoc columns)
+void appendLEWords(std::string& out, const void* words, size_t bytes);
+void copyLEWords(void* words, const char* image, size_t bytes);
+
+std::string serializeIR(const IRProgram& ir);
+IRProgram deserializeIR(std::string_view bytes);
+void writeIR(const IRProgram& ir, const std::string& path);
+
+// Read-only view of an IR image; checks the header and section sizes
+// only, so operands must be range-checked by the reader (validate()
+// checks them all). The bytes must outlive the view.
+class IRImage {
+public:
+    explicit IRImage(std::string_view bytes);
+
+    size_t size() const { return instrs; }
+    size_t symbolCount() const { return symbols; }
+    bool pooledLiterals() const { return (flags & 1) != 0; }
+
+    IROp op(size_t i) const { return static_cast<IROp>(static_cast<uint8_t>(base[opsAt + i])); }
+    SymbolId arg1(size_t i) const { return word(arg1At + i * 4); }
+    SymbolId arg2(size_t i) const { return word(arg2At + i * 4); }
+    SymbolId lane(size_t i) const { return word(laneAt + i * 4); }
+    SourceLoc loc(size_t i) const { return SourceLoc{word(locAt + i * 8), word(locAt + i * 8 + 4)}; }
+    std::string_view text(SymbolId id) const;
+    size_t columnsOffset() const { return arg1At; }
+
+    // Throws std::runtime_error unless every opcode, operand and symbol
+    // offset is in range
+    void validate() const;
+
+private:
+    const char* base;
+    uint32_t flags = 0;
+    uint32_t symbols = 0;
+    uint32_t instrs = 0;
+    uint32_t blobBytes = 0;
+    size_t blobAt = 0;
+    size_t arg1At = 0;
+    size_t arg2At = 0;
+    size_t laneAt = 0;
+    size_t locAt = 0;
+    size_t opsAt = 0;
+
+    uint32_t word(size_t offset) const;
+};
+
+// An .esir file mapped for the life of the object. The program's symbols
+// are views into the mapping, so loading copies only the columns.
+class MappedIR {
+public:
+    // Throws std::runtime_error if path is not a valid IR image
+    explicit MappedIR(const std::string& path);
+
+    IRProgram& program() { return ir; }
+
+private:
+    SourceFile file;
+    IRProgram ir;
+};
+
+// Data-section string entries shared by the NASM and direct backends
+struct StringLayout {
+    std::vector<SymbolId> entries;   // literal of str_N, in emission order
+    std::vector<int> slot;           // per instruction: N of its arg2, or -1
+};
+
+StringLayout layoutStrings(const IRProgram& ir);
+
+// Settings shared by the NASM and direct backends
+struct CodegenOptions {
+    // Lane thread k is pinned to laneCores[k % size]; empty leaves
+    // placement to the kernel
+    std::vector<int> laneCores;
+};
+
+// Renders the NASM text; threads == 0 uses every core on large programs
+std::string renderNASM(const IRProgram& ir, const CodegenOptions& opts = {}, size_t threads = 0);
+void emitNASM(const IRProgram& ir, const std::string& file, const CodegenOptions& opts = {},
+              std::ostream& log = std::cout);
+
+// The same program as up to `units` sources that assemble separately
+// and link together: unit 0 holds the data, bss, _start and the start of
+// the main code, the others continue the main code and hold the lane
+// threads. Symbols used across units get global/extern lines. units <= 1
+// gives renderNASM's text.
+std::vector<std::string> renderNASMUnits(const IRProgram& ir, size_t units, const CodegenOptions& opts = {},
+                                         size_t threads = 0);
+// Writes unit 0 to file and unit u to <file stem>.<u>.asm; units == 0
+// makes one per core. Returns the files written, in unit order.
+std::vector<std::string> emitNASMUnits(const IRProgram& ir, const std::string& file, size_t units,
+                                       const CodegenOptions& opts = {}, std::ostream& log = std::cout);
+
+// Assembles every file (in parallel on POSIX) and links the objects into
+// outFile. Returns 0, or the exit code of the first failing tool (128 +
+// signal if it was killed, 127 if it could not be started).
+int autoLink(const std::vector<std::string>& asmFiles, const std::string& outFile,
+             std::ostream& log = std::cout);
+int autoLink(const std::string& asmFile, const std::string& outFile, std::ostream& log = std::cout);
+std::string replaceExtension(const std::string& path, const std::string& newExt);
+std::string executableName(const std::string& outFile);
+
+// Built-in backend: encodes the IR straight to an x86-64 ELF executable
+// at outFile, with no assembler or linker process
+int emitDirect(const IRProgram& ir, const std::string& outFile, const CodegenOptions& opts = {},
+               std::ostream& log = std::cout);
 
 } // namespace EScript
@@ -0,0 +1,101 @@
+#include "lanes.hpp"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace EScript {
+
+const LaneJoin* LanePlan::joinAt(size_t i) const {
+    auto it = std::lower_bound(joins.begin(), joins.end(), i,
+                               [](const LaneJoin& j, size_t at) { return j.at < at; });
+    return it == joins.end() ? nullptr : &*it;
+}
+
+const LaneJoin* LanePlan::exitJoin() const {
+    if (joins.empty() || joins.back().at != spawnAt.size()) return nullptr;
+    return &joins.back();
+}
+
+LanePlan planLanes(const IRProgram& ir) {
+    LanePlan plan;
+    plan.spawnAt.assign(ir.size(), 0);
+    plan.inLane.assign(ir.size(), 0);
+
+    std::unordered_set<SymbolId> laneNames;
+    std::unordered_map<SymbolId, uint32_t> open;    // lane name -> running instance
+    std::vector<uint32_t> openOrder;                // running instances, spawn order
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> freeSlots;
+
+    auto join = [&](uint32_t at, std::vector<uint32_t> instances) {
+        if (instances.empty()) return;
+        for (uint32_t k : instances) {
+            freeSlots.push(plan.instances[k].slot);
+            open.erase(plan.instances[k].lane);
+        }
+        plan.joins.push_back(LaneJoin{at, std::move(instances)});
+    };
+
+    size_t depth = 0;
+    uint32_t current = 0;
+    for (size_t i = 0; i < ir.size(); ++i) {
+        const IROp op = ir.ops[i];
+
+        if (depth > 0) {
+            // Inside a lane statement; nested lanes run inline on its thread
+            if (op == IROp::LANE_START) depth++;
+            else if (op == IROp::LANE_END) depth--;
+            plan.inLane[i] = 1;
+            plan.instances[current].body.push_back(static_cast<uint32_t>(i));
+            continue;
+        }
+
+        if (op == IROp::LANE_START) {
+            const SymbolId name = ir.arg1[i];
+            laneNames.insert(name);
+            auto it = open.find(name);
+            if (it != open.end()) {
+                current = it->second;
+            } else {
+                current = static_cast<uint32_t>(plan.instances.size());
+                LaneInstance lane;
+                lane.lane = name;
+                if (freeSlots.empty()) {
+                    lane.slot = plan.slotCount++;
+                } else {
+                    lane.slot = freeSlots.top();
+                    freeSlots.pop();
+                }
+                plan.instances.push_back(std::move(lane));
+
+                open[name] = current;
+                openOrder.push_back(current);
+                plan.spawnAt[i] = current + 1;
+            }
+            depth = 1;
+            plan.inLane[i] = 1;
+            plan.instances[current].body.push_back(static_cast<uint32_t>(i));
+            continue;
+        }
+
+        if (op == IROp::SYNC || op == IROp::SYNC_ALL) {
+            std::vector<uint32_t> targets;
+            if (op == IROp::SYNC && laneNames.count(ir.arg1[i])) {
+                auto it = open.find(ir.arg1[i]);
+                if (it != open.end()) {
+                    targets.push_back(it->second);
+                    openOrder.erase(std::find(openOrder.begin(), openOrder.end(), it->second));
+                }
+            } else {
+                targets.swap(openOrder);
+            }
+            join(static_cast<uint32_t>(i), std::move(targets));
+        }
+    }
+
+    join(static_cast<uint32_t>(ir.size()), std::move(openOrder));
+    return plan;
+}
+
+} // namespace EScript
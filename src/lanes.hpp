@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ir.hpp"
+
+namespace EScript {
+
+// Static schedule of lane threads, shared by codegen and the interpreter.
+//
+// Consecutive statements of one lane up to the sync that joins it form
+// one instance (one thread), so a lane stays sequential while different
+// lanes run concurrently. `sync <lane>` joins that lane; SYNC_ALL and any
+// other sync join every running lane; whatever is still running at the
+// end of the program is joined before exit. Nested lanes run inline on
+// the enclosing lane's thread.
+struct LaneInstance {
+    SymbolId lane;                  // lane name, e.g. y1
+    uint32_t slot;                  // reused once the instance is joined
+    std::vector<uint32_t> body;     // IR instructions run by the thread
+};
+
+struct LaneJoin {
+    uint32_t at;                    // IR index of the sync, or ir.size()
+    std::vector<uint32_t> instances;
+};
+
+struct LanePlan {
+    std::vector<LaneInstance> instances;
+    std::vector<uint32_t> spawnAt;  // per IR instruction: instance + 1, or 0
+    std::vector<uint8_t> inLane;    // per IR instruction: runs on a lane thread
+    std::vector<LaneJoin> joins;    // ordered by `at`
+    uint32_t slotCount = 0;         // most instances running at once
+
+    // First join at or after IR index i, or nullptr
+    const LaneJoin* joinAt(size_t i) const;
+    // Join placed after the last instruction, or nullptr
+    const LaneJoin* exitJoin() const;
+};
+
+LanePlan planLanes(const IRProgram& ir);
+
+} // namespace EScript
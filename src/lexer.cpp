@@ -1,106 +1,323 @@
 #include "tokens.hpp"
-#include <regex>
+#include "profile.hpp"
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <stdexcept>
 
 namespace EScript {
 
-std::vector<Token> tokenize(const std::string& src) {
-  // Define token patterns in order of priority
-    const std::vector<std::pair<std::string, std::string>> patterns = {
-        // Comments (must be before other patterns)
-{"COMMENT_MULTI", R"(\*\*[\s\S]*?\*\*)"},
-        {"COMMENT_SINGLE", R"(\*[^\n]*)"},
-    
-        // Keywords (operation verbs)
- {"KW_MODIFY", R"(\bmodify\b)"},
-     {"KW_ADJUST", R"(\badjust\b)"},
-        {"KW_BYPASS", R"(\bbypass\b)"},
-        {"KW_DELETE", R"(\bdelete\b)"},
-        {"KW_PROCESS", R"(\bprocess\b)"},
-    {"KW_CREATE", R"(\bcreate\b)"},
-   {"KW_DEPLOY", R"(\bdeploy\b)"},
-     {"KW_LANE", R"(\blane\b)"},
-     {"KW_SYNC", R"(\bsync\b)"},
-        {"KW_IF", R"(\bif\b)"},
-    {"KW_ELSE", R"(\belse\b)"},
-        {"KW_LOOP", R"(\bloop\b)"},
-        
-        // Actions (must come before identifiers)
-        {"ACTION_READ", R"(\bread\b)"},
-  {"ACTION_WRITE", R"(\bwrite\b)"},
-    {"ACTION_PING", R"(\bping\b)"},
-        {"ACTION_ANALYZE", R"(\banalyze\b)"},
-        
-        // Literals
-        {"STRING", R"("(?:[^"\\]|\\.)*")"},
-        {"NUMBER", R"(\d+\.?\d*)"},
-        
-        // Identifiers (after keywords)
-        {"IDENT", R"([A-Za-z_][A-Za-z0-9_\-]*)"},
-        
-   // Operators and punctuation
-        {"HASH", R"(#)"},
-        {"PLUS", R"(\+)"},
-        {"MINUS", R"(\-)"},
-        {"LPAREN", R"(\()"},
-        {"RPAREN", R"(\))"},
-        {"TO", R"(\bto\b)"},
-        
-        // Whitespace (will be filtered out)
-        {"WS", R"(\s+)"}
+namespace {
+
+// Character classes for the scanner table
+enum CharClass : uint8_t {
+    CC_NONE  = 0,
+    CC_SPACE = 1 << 0,  // \s
+    CC_DIGIT = 1 << 1,  // \d
+    CC_ALPHA = 1 << 2,  // [A-Za-z_] - identifier start
+    CC_WORD  = 1 << 3,  // [A-Za-z0-9_] - \b word characters
+    CC_IDENT = 1 << 4,  // [A-Za-z0-9_\-] - identifier continuation
+    CC_STOP  = 1 << 5   // '"' or '\\' - where a string ends or escapes
+};
+
+struct CharTable {
+    uint8_t cls[256];
+
+    CharTable() : cls() {
+        for (unsigned char c : std::string(" \t\n\v\f\r")) cls[c] |= CC_SPACE;
+        for (int c = '0'; c <= '9'; ++c) cls[c] |= CC_DIGIT | CC_WORD | CC_IDENT;
+        for (int c = 'a'; c <= 'z'; ++c) cls[c] |= CC_ALPHA | CC_WORD | CC_IDENT;
+        for (int c = 'A'; c <= 'Z'; ++c) cls[c] |= CC_ALPHA | CC_WORD | CC_IDENT;
+        cls['_'] |= CC_ALPHA | CC_WORD | CC_IDENT;
+        cls['-'] |= CC_IDENT;
+        cls['"'] |= CC_STOP;
+        cls['\\'] |= CC_STOP;
+    }
+
+    bool is(char c, uint8_t mask) const {
+        return (cls[static_cast<unsigned char>(c)] & mask) != 0;
+    }
+};
+
+const CharTable& charTable() {
+    static const CharTable table;
+    return table;
+}
+
+// Keywords and actions, matched as whole words (\bword\b)
+struct Keyword {
+    std::string_view text;
+    TokenKind kind;
+};
+
+constexpr Keyword kKeywords[] = {
+    {"modify", TokenKind::KW_MODIFY},
+    {"adjust", TokenKind::KW_ADJUST},
+    {"bypass", TokenKind::KW_BYPASS},
+    {"delete", TokenKind::KW_DELETE},
+    {"process", TokenKind::KW_PROCESS},
+    {"create", TokenKind::KW_CREATE},
+    {"deploy", TokenKind::KW_DEPLOY},
+    {"lane", TokenKind::KW_LANE},
+    {"sync", TokenKind::KW_SYNC},
+    {"if", TokenKind::KW_IF},
+    {"else", TokenKind::KW_ELSE},
+    {"loop", TokenKind::KW_LOOP},
+    {"channel", TokenKind::KW_CHANNEL},
+    {"send", TokenKind::KW_SEND},
+    {"receive", TokenKind::KW_RECEIVE},
+    {"use", TokenKind::KW_USE},
+    {"call", TokenKind::KW_CALL},
+    {"define", TokenKind::KW_DEFINE},
+    {"read", TokenKind::ACTION_READ},
+    {"write", TokenKind::ACTION_WRITE},
+    {"ping", TokenKind::ACTION_PING},
+    {"analyze", TokenKind::ACTION_ANALYZE},
+};
+
+constexpr size_t kKeywordCount = sizeof(kKeywords) / sizeof(kKeywords[0]);
+constexpr uint32_t kKeywordBits = 6;
+constexpr uint32_t kKeywordSlots = 1u << kKeywordBits;
+
+constexpr size_t maxKeywordLength() {
+    size_t len = 0;
+    for (const auto& kw : kKeywords) {
+        if (kw.text.size() > len) len = kw.text.size();
+    }
+    return len;
+}
+
+constexpr size_t kMaxKeywordLength = maxKeywordLength();
+
+// Seeded FNV-1a, reduced to the top kKeywordBits bits
+constexpr uint32_t keywordHash(const char* s, size_t len, uint32_t seed) {
+    uint32_t h = seed;
+    for (size_t i = 0; i < len; ++i) {
+        h = (h ^ static_cast<unsigned char>(s[i])) * 16777619u;
+    }
+    return h >> (32 - kKeywordBits);
+}
+
+// Search for a seed under which no two keywords share a slot
+constexpr uint32_t findKeywordSeed() {
+    for (uint32_t seed = 2166136261u;; ++seed) {
+        bool used[kKeywordSlots] = {};
+        bool perfect = true;
+        for (const auto& kw : kKeywords) {
+            uint32_t slot = keywordHash(kw.text.data(), kw.text.size(), seed);
+            if (used[slot]) {
+                perfect = false;
+                break;
+            }
+            used[slot] = true;
+        }
+        if (perfect) return seed;
+    }
+}
+
+constexpr uint32_t kKeywordSeed = findKeywordSeed();
+
+struct KeywordTable {
+    uint8_t slot[kKeywordSlots];  // keyword index + 1, 0 when empty
+};
+
+constexpr KeywordTable buildKeywordTable() {
+    KeywordTable table{};
+    for (size_t i = 0; i < kKeywordCount; ++i) {
+        const auto& kw = kKeywords[i];
+        table.slot[keywordHash(kw.text.data(), kw.text.size(), kKeywordSeed)] =
+            static_cast<uint8_t>(i + 1);
+    }
+    return table;
+}
+
+constexpr KeywordTable kKeywordTable = buildKeywordTable();
+
+bool lookupKeyword(const char* word, size_t len, TokenKind& kind) {
+    if (len > kMaxKeywordLength) return false;
+    uint8_t entry = kKeywordTable.slot[keywordHash(word, len, kKeywordSeed)];
+    if (entry == 0) return false;
+    const auto& kw = kKeywords[entry - 1];
+    if (kw.text != std::string_view(word, len)) return false;
+    kind = kw.kind;
+    return true;
+}
+
+} // namespace
+
+const char* tokenKindName(TokenKind kind) {
+    static const char* const names[] = {
+        "KW_MODIFY", "KW_ADJUST", "KW_BYPASS", "KW_DELETE", "KW_PROCESS",
+        "KW_CREATE", "KW_DEPLOY", "KW_LANE", "KW_SYNC", "KW_IF", "KW_ELSE",
+        "KW_LOOP", "KW_CHANNEL", "KW_SEND", "KW_RECEIVE", "KW_USE", "KW_CALL",
+        "KW_DEFINE", "ACTION_READ", "ACTION_WRITE", "ACTION_PING",
+        "ACTION_ANALYZE", "STRING", "NUMBER", "IDENT", "HASH", "PLUS",
+        "MINUS", "LPAREN", "RPAREN", "TO"
     };
-  
+    return names[static_cast<size_t>(kind)];
+}
+
+namespace {
+
+// Shared scanner: throws on the first error when status is null,
+// otherwise records every error in it and keeps going
+std::vector<Token> scan(std::string_view src, LexStatus* status) {
+    if (src.size() > UINT32_MAX) {
+        throw std::runtime_error("Lexer error: source exceeds 4 GiB");
+    }
+
+    const CharTable& ct = charTable();
+    const char* s = src.data();
+    const size_t n = src.size();
+
     std::vector<Token> out;
-    std::string rem = src;
-    int line = 1;
-    int column = 1;
-    
-    while (!rem.empty()) {
-        bool matched = false;
-  
-        // Replace the problematic for loop with correct structured binding syntax
-        for (const auto& pattern : patterns) {
-            const std::string& type = pattern.first;
-            const std::string& pat = pattern.second;
-            std::smatch m;
-            std::regex regex("^" + pat);
-
-            if (std::regex_search(rem, m, regex)) {
-                std::string match_str = m.str();
-
-                // Skip whitespace and comments, but track line numbers
-                if (type != "WS" && type != "COMMENT_SINGLE" && type != "COMMENT_MULTI") {
-                    out.push_back(Token(type, match_str, line, column));
-                }
+    out.reserve(n / 8 + 16);
+    size_t pos = 0;
+    uint32_t line = 1;
+    size_t lineStart = 0;   // offset of the current line's first byte
+
+    // Moves line tracking over [from, to), which may span lines
+    auto advance = [&](size_t from, size_t to) {
+        while (const void* nl = std::memchr(s + from, '\n', to - from)) {
+            from = static_cast<size_t>(static_cast<const char*>(nl) - s) + 1;
+            line++;
+            lineStart = from;
+        }
+    };
+
+    // First offset from `from` on whose class is outside mask
+    auto skip = [&](size_t from, uint8_t mask) {
+        while (from < n && ct.is(s[from], mask)) from++;
+        return from;
+    };
+
+    auto column = [&](size_t at) {
+        return static_cast<uint32_t>(at - lineStart + 1);
+    };
 
-                // Update position tracking
-                for (char c : match_str) {
-                    if (c == '\n') {
-                        line++;
-                        column = 1;
-                    } else {
-                        column++;
-                    }
+    auto push = [&](TokenKind kind, size_t start, size_t end) {
+        Token tok;
+        tok.offset = static_cast<uint32_t>(start);
+        tok.length = static_cast<uint32_t>(end - start);
+        tok.line = line;
+        const uint32_t col = column(start);
+        tok.column = static_cast<uint16_t>(col < UINT16_MAX ? col : UINT16_MAX);
+        tok.kind = kind;
+        out.push_back(tok);
+    };
+
+    auto fail = [&]() {
+        std::string reason = "Unknown token near '" + std::string(src.substr(pos, 10)) + "...'";
+        if (!status) {
+            throw std::runtime_error(
+                "Lexer error at line " + std::to_string(line) +
+                ", column " + std::to_string(column(pos)) + ": " + reason
+            );
+        }
+        status->errors.push_back({pos, std::move(reason)});
+    };
+    while (pos < n) {
+        const char c = s[pos];
+        size_t end = pos + 1;
+
+        if (ct.is(c, CC_SPACE)) {
+            // Whitespace (filtered out)
+            if (end < n && ct.is(s[end], CC_SPACE)) {
+                end = skip(end + 1, CC_SPACE);
+                advance(pos, end);
+            } else if (c == '\n') {
+                line++;
+                lineStart = end;
+            }
+        }
+        else if (c == '*') {
+            // Multi-line comment needs a closing "**", otherwise single-line
+            size_t close = std::string_view::npos;
+            if (end < n && s[end] == '*') {
+                close = src.find("**", pos + 2);
+            }
+            if (close != std::string_view::npos) {
+                end = close + 2;
+                advance(pos, end);
+            } else {
+                if (status && end < n && s[end] == '*' && status->openComment == SIZE_MAX) {
+                    status->openComment = pos;
                 }
+                const void* nl = std::memchr(s + end, '\n', n - end);
+                end = nl ? static_cast<const char*>(nl) - s : n;
+            }
+        }
+        else if (ct.is(c, CC_ALPHA)) {
+            // Keyword when the whole word matches, identifier otherwise
+            const size_t wordEnd = skip(end, CC_WORD);
 
-                rem = m.suffix().str();
-                matched = true;
+            TokenKind kind;
+            if (lookupKeyword(s + pos, wordEnd - pos, kind)) {
+                push(kind, pos, wordEnd);
+                end = wordEnd;
+            } else {
+                end = skip(wordEnd, CC_IDENT);
+                push(TokenKind::IDENT, pos, end);
+            }
+        }
+        else if (c == '"') {
+            // Jump between quotes and backslashes; escapes may not span a
+            // line break
+            bool closed = false;
+            for (;;) {
+                while (end < n && !ct.is(s[end], CC_STOP)) end++;
+                if (end >= n) break;
+                if (s[end] == '"') {
+                    closed = true;
+                    end++;
+                    break;
+                }
+                if (end + 1 >= n || s[end + 1] == '\n' || s[end + 1] == '\r') break;
+                end += 2;
+            }
+            if (!closed) {
+                // Tolerant scans give up on the rest of the source
+                fail();
+                status->openString = true;
+                advance(pos, n);
                 break;
             }
+
+            push(TokenKind::STRING, pos, end);
+            advance(pos, end);
         }
-        
-        if (!matched) {
-            throw std::runtime_error(
-    "Lexer error at line " + std::to_string(line) + 
- ", column " + std::to_string(column) +
-    ": Unknown token near '" + rem.substr(0, 10) + "...'"
-            );
+        else if (ct.is(c, CC_DIGIT)) {
+            while (end < n && ct.is(s[end], CC_DIGIT)) end++;
+            if (end < n && s[end] == '.') {
+                end++;
+                while (end < n && ct.is(s[end], CC_DIGIT)) end++;
+            }
+            push(TokenKind::NUMBER, pos, end);
         }
+        else if (c == '#') push(TokenKind::HASH, pos, end);
+        else if (c == '+') push(TokenKind::PLUS, pos, end);
+        else if (c == '-') push(TokenKind::MINUS, pos, end);
+        else if (c == '(') push(TokenKind::LPAREN, pos, end);
+        else if (c == ')') push(TokenKind::RPAREN, pos, end);
+        else fail();
+
+        pos = end;
     }
-    
+
     return out;
 }
 
+} // namespace
+
+std::vector<Token> tokenize(std::string_view src) {
+    ES_TIME_SCOPE("tokenize");
+    return scan(src, nullptr);
+}
+
+std::vector<Token> tokenize(std::string_view src, LexStatus& status) {
+    ES_TIME_SCOPE("tokenize");
+    return scan(src, &status);
+}
+
 } // namespace EScript
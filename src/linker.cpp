@@ -1,8 +1,20 @@
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "ir.hpp"
+#include "profile.hpp"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
+#endif
 
 namespace EScript {
 
@@ -21,42 +33,173 @@ std::string replaceExtension(const std::string& path, const std::string& newExt)
     return path + newExt;
 }
 
-int autoLink(const std::string& asmFile, const std::string& outFile) {
-  // For Windows: create .obj and .exe
-    std::string obj = replaceExtension(asmFile, ".obj");
-    std::string exe = outFile + ".exe";
-    
-    // NASM command for Windows 64-bit
-    std::string cmdAsm = "nasm -f win64 \"" + asmFile + "\" -o \"" + obj + "\"";
-    
- // LD command for Windows PE format
-    std::string cmdLink = "ld -m i386pep \"" + obj + "\" -o \"" + exe + "\"";
-  
-    std::cout << "[AutoLink] Assembling...\n";
-    std::cout << "  Command: " << cmdAsm << "\n";
-  
-    int asmResult = system(cmdAsm.c_str());
-    if (asmResult != 0) {
- std::cerr << "[AutoLink] ERROR: Assembly failed!\n";
-  std::cerr << "  Make sure NASM is installed and in your PATH\n";
-        return asmResult;
+std::string executableName(const std::string& outFile) {
+#ifdef _WIN32
+    return outFile + ".exe";
+#else
+    return outFile;
+#endif
+}
+
+namespace {
+
+#ifndef _WIN32
+// Exit code of a finished child as a shell reports it: its status, or
+// 128 + the signal that killed it
+int exitCode(int status) {
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return 1;
+}
+
+// One tool run started with posix_spawnp; waitpid on its own pid only,
+// so concurrent builds never reap each other's children
+struct ToolRun {
+    std::string command;
+    pid_t pid = -1;
+    int status = 127;          // 127: could not be started
+    double ms = 0.0;
+};
+
+void startTool(ToolRun& run, const std::vector<std::string>& args) {
+    std::vector<char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+        run.command += (run.command.empty() ? "" : " ") + arg;
+    }
+    argv.push_back(nullptr);
+    if (posix_spawnp(&run.pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0) {
+        run.pid = -1;
+    }
+}
+
+void finishTool(ToolRun& run, std::chrono::steady_clock::time_point start) {
+    if (run.pid < 0) return;
+    int status = 0;
+    while (waitpid(run.pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            run.status = 127;
+            return;
+        }
+    }
+    run.status = exitCode(status);
+    run.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+#endif
+
+} // namespace
+
+int autoLink(const std::vector<std::string>& asmFiles, const std::string& outFile, std::ostream& log) {
+    std::string exe = executableName(outFile);
+#ifdef _WIN32
+    // For Windows: create .obj files and a PE executable, one tool at a time
+    std::string cmdLink = "ld -m i386pep";
+    log << "[AutoLink] Assembling...\n";
+    for (const auto& asmFile : asmFiles) {
+        std::string obj = replaceExtension(asmFile, ".obj");
+        std::string cmdAsm = "nasm -f win64 \"" + asmFile + "\" -o \"" + obj + "\"";
+        cmdLink += " \"" + obj + "\"";
+        log << "  Command: " << cmdAsm << "\n";
+
+        int asmResult;
+        {
+            ES_TIME_SCOPE("assemble");
+            asmResult = system(cmdAsm.c_str());
+        }
+        if (asmResult != 0) {
+            log << "[AutoLink] ERROR: Assembly failed!\n";
+            log << "  Make sure NASM is installed and in your PATH\n";
+            return asmResult;
+        }
+    }
+    cmdLink += " -o \"" + exe + "\"";
+
+    log << "[AutoLink] Linking...\n";
+    log << "  Command: " << cmdLink << "\n";
+    int linkResult;
+    {
+        ES_TIME_SCOPE("link");
+        linkResult = system(cmdLink.c_str());
     }
-    
-    std::cout << "[AutoLink] Assembly successful: " << obj << "\n";
-    std::cout << "[AutoLink] Linking...\n";
-    std::cout << "  Command: " << cmdLink << "\n";
-    
-    int linkResult = system(cmdLink.c_str());
     if (linkResult != 0) {
-        std::cerr << "[AutoLink] ERROR: Linking failed!\n";
-        std::cerr << "  Make sure LD (from MinGW or LLVM) is installed and in your PATH\n";
+        log << "[AutoLink] ERROR: Linking failed!\n";
+        log << "  Make sure LD (from MinGW or LLVM) is installed and in your PATH\n";
         return linkResult;
     }
-    
-    std::cout << "[AutoLink] Build complete!\n";
-    std::cout << "  Executable: " << exe << "\n";
-    
+#else
+    // For Linux: one ELF64 object per unit, assembled concurrently, then
+    // a single static link
+    std::vector<std::string> objects;
+    std::vector<ToolRun> runs(asmFiles.size());
+    log << "[AutoLink] Assembling " << asmFiles.size() << (asmFiles.size() == 1 ? " unit" : " units")
+        << "...\n";
+    {
+        ES_TIME_SCOPE("assemble");
+        auto start = std::chrono::steady_clock::now();
+        for (size_t u = 0; u < asmFiles.size(); ++u) {
+            objects.push_back(replaceExtension(asmFiles[u], ".o"));
+            startTool(runs[u], {"nasm", "-f", "elf64", asmFiles[u], "-o", objects[u]});
+        }
+        // A waiter per child, so each unit's time ends when it exits
+        std::vector<std::thread> waiters;
+        for (size_t u = 1; u < runs.size(); ++u) {
+            waiters.emplace_back([&runs, u, start] { finishTool(runs[u], start); });
+        }
+        finishTool(runs[0], start);
+        for (auto& waiter : waiters) waiter.join();
+    }
+
+    int asmResult = 0;
+    for (const auto& run : runs) {
+        log << "  Command: " << run.command << "\n";
+        if (run.pid < 0) {
+            log << "[AutoLink] ERROR: Cannot start nasm\n";
+        } else {
+            log << "  Exit code " << run.status << " after " << run.ms << " ms\n";
+        }
+        if (run.status != 0 && asmResult == 0) asmResult = run.status;
+    }
+    if (asmResult != 0) {
+        log << "[AutoLink] ERROR: Assembly failed!\n";
+        log << "  Make sure NASM is installed and in your PATH\n";
+        return asmResult;
+    }
+
+    log << "[AutoLink] Assembly successful: " << objects[0]
+        << (objects.size() > 1 ? " (+" + std::to_string(objects.size() - 1) + " units)" : "") << "\n";
+    log << "[AutoLink] Linking...\n";
+
+    std::vector<std::string> args = {"ld"};
+    args.insert(args.end(), objects.begin(), objects.end());
+    args.push_back("-o");
+    args.push_back(exe);
+    ToolRun link;
+    {
+        ES_TIME_SCOPE("link");
+        auto start = std::chrono::steady_clock::now();
+        startTool(link, args);
+        finishTool(link, start);
+    }
+    log << "  Command: " << link.command << "\n";
+    if (link.pid < 0) {
+        log << "[AutoLink] ERROR: Cannot start ld\n";
+    }
+    if (link.status != 0) {
+        log << "[AutoLink] ERROR: Linking failed!\n";
+        log << "  Make sure ld (from binutils) is installed and in your PATH\n";
+        return link.status;
+    }
+    log << "  Linked in " << link.ms << " ms\n";
+#endif
+
+    log << "[AutoLink] Build complete!\n";
+    log << "  Executable: " << exe << "\n";
+
     return 0;
 }
 
+int autoLink(const std::string& asmFile, const std::string& outFile, std::ostream& log) {
+    return autoLink(std::vector<std::string>{asmFile}, outFile, log);
+}
+
 } // namespace EScript
@@ -0,0 +1,985 @@
+#include "lower.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace EScript {
+
+namespace {
+
+const char kBannerText[] = "E-Script executed successfully";
+
+// Lane runtime layout
+constexpr int32_t kLaneStackSize = 64 * 1024;
+constexpr int32_t kDoneStride = 64;         // one cache line per done flag
+constexpr int32_t kCpuMaskBytes = 128;      // cpu_set_t covering 1024 cores
+
+// Buffered I/O runtime layout: per thread a 64-byte header holding the
+// next free iovec, then kIoVecs iovecs, then one digit slot per iovec
+// for printed numbers, which must outlive the writev that sends them
+constexpr int32_t kIoVecs = 1024;           // IOV_MAX on Linux
+constexpr int32_t kIoHeader = 64;
+constexpr int32_t kIoDigits = kIoHeader + kIoVecs * 16;
+constexpr int32_t kIoDigitSlot = 32;        // sign, 19 digits and a newline
+constexpr int32_t kIoBlockSize = kIoDigits + kIoVecs * kIoDigitSlot;
+const char kReadErrorText[] = "Run error: process read failed\n";
+const char kWriteErrorText[] = "Run error: process write failed\n";
+const char kOverflowText[] = "Run error: int container overflowed\n";
+
+// Channel layout: send ticket, receive ticket and sleeper count on
+// their own cache lines, then the cells {turn, pad, ptr, len}
+constexpr int32_t kChanTail = 0;
+constexpr int32_t kChanHead = 64;
+constexpr int32_t kChanSleepers = 128;
+constexpr int32_t kChanCells = 192;
+constexpr int32_t kChanCellShift = 5;       // 32-byte cells
+
+// Linux x86-64 system calls used by the runtime
+constexpr int32_t kSysWrite = 1;
+constexpr int32_t kSysOpen = 2;
+constexpr int32_t kSysClose = 3;
+constexpr int32_t kSysLseek = 8;
+constexpr int32_t kSysMmap = 9;
+constexpr int32_t kSysWritev = 20;
+constexpr int32_t kSysClone = 56;
+constexpr int32_t kSysExit = 60;
+constexpr int32_t kSysFutex = 202;
+constexpr int32_t kSysSchedSetAffinity = 203;
+constexpr int32_t kSysExitGroup = 231;
+
+// CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD | CLONE_SYSVSEM
+constexpr int32_t kCloneThreadFlags = 0x100 | 0x200 | 0x400 | 0x800 | 0x10000 | 0x40000;
+constexpr int32_t kFutexWaitPrivate = 128;
+constexpr int32_t kFutexWakePrivate = 129;
+constexpr int32_t kSeekEnd = 2;
+constexpr int32_t kEintr = 4;
+constexpr int32_t kProtRead = 1;
+constexpr int32_t kMapPrivate = 2;
+
+MInstr instr(MOp op, MOperand dst = {}, MOperand src = {}, const char* note = nullptr) {
+    MInstr in;
+    in.op = op;
+    in.dst = dst;
+    in.src = src;
+    in.note = note;
+    return in;
+}
+
+// The same with 64-bit operands
+MInstr instr64(MOp op, MOperand dst, MOperand src = {}, const char* note = nullptr) {
+    MInstr in = instr(op, dst, src, note);
+    in.width = Width::W64;
+    return in;
+}
+
+// The same with byte operands
+MInstr instr8(MOp op, MOperand dst, MOperand src, const char* note = nullptr) {
+    MInstr in = instr(op, dst, src, note);
+    in.width = Width::W8;
+    return in;
+}
+
+// With a lock prefix, for read-modify-write shared between threads
+MInstr locked(MInstr in) {
+    in.lock = true;
+    return in;
+}
+
+MInstr jump(MOp op, MSym target) {
+    return instr(op, MOperand::addr(target));
+}
+
+MOperand reg(Reg r) { return MOperand::r(r); }
+MOperand imm(int32_t v) { return MOperand::imm(v); }
+
+// Lane names may contain '-', which NASM labels do not allow
+std::string labelSafe(std::string_view name) {
+    std::string out(name);
+    std::replace(out.begin(), out.end(), '-', '_');
+    return out;
+}
+
+// A sent number as the interpreter prints it: integers as is, anything
+// else through %.15g
+std::string numberText(std::string_view text) {
+    int64_t v = 0;
+    bool integer = !text.empty();
+    for (char c : text) {
+        if (c < '0' || c > '9' || v > (INT64_MAX - 9) / 10) {
+            integer = false;
+            break;
+        }
+        v = v * 10 + (c - '0');
+    }
+    if (integer || text.empty()) return std::to_string(v);
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.15g", std::strtod(std::string(text).c_str(), nullptr));
+    return buf;
+}
+
+// The 64-bit pattern of a numeric operand stored into a slot of type:
+// the integer itself, or the bits of the double
+int64_t slotBits(std::string_view text, SlotType type) {
+    int64_t v = 0;
+    const bool integer = text.empty() || integerLiteral(text, v);
+    if (type == SlotType::Int) return v;
+    double d = integer ? static_cast<double>(v) : std::strtod(std::string(text).c_str(), nullptr);
+    std::memcpy(&v, &d, sizeof(v));
+    return v;
+}
+
+// A statement the native backends cannot run as the interpreter would.
+// Rejected at compile time rather than emitted as a binary whose output
+// differs from -run.
+[[noreturn]] void notCompiled(const IRProgram& ir, size_t i, const char* why) {
+    std::string op = irOpName(ir.ops[i]);
+    std::transform(op.begin(), op.end(), op.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    std::string text = op + " " + std::string(ir.text(ir.arg1[i]));
+    if (!ir.text(ir.arg2[i]).empty()) text += " " + std::string(ir.text(ir.arg2[i]));
+    throw std::runtime_error(text + ": " + why + " in compiled programs");
+}
+
+bool fitsImm32(int64_t v) {
+    return v >= INT32_MIN && v <= INT32_MAX;
+}
+
+// rax = v, for values a sign-extended imm32 cannot hold
+void loadConstant(int64_t v, MachineStreamer& out) {
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(static_cast<int32_t>(static_cast<uint32_t>(v)))));
+    out.emit(instr(MOp::Mov, reg(Reg::RDX), imm(static_cast<int32_t>(static_cast<uint32_t>(static_cast<uint64_t>(v) >> 32)))));
+    out.emit(instr64(MOp::Shl, reg(Reg::RDX), imm(32)));
+    out.emit(instr64(MOp::Or, reg(Reg::RAX), reg(Reg::RDX)));
+}
+
+} // namespace
+
+MachineLowering::MachineLowering(const IRProgram& program, const CodegenOptions& opts)
+    : ir(program), strings(layoutStrings(program)) {
+    msgSym = syms.add("msg", MSection::Data);
+    msgLenSym = syms.add("msg_len", MSection::Const, sizeof(kBannerText) - 1 + 2);
+
+    // One data entry per str_N, with its length as an equ constant
+    strSym.reserve(strings.entries.size());
+    strLenSym.reserve(strings.entries.size());
+    for (size_t n = 0; n < strings.entries.size(); ++n) {
+        std::string name = "str_" + std::to_string(n);
+        // Quotes dropped, newline and NUL added: same size as the literal
+        int32_t len = static_cast<int32_t>(ir.text(strings.entries[n]).size());
+        strSym.push_back(syms.add(name, MSection::Data));
+        strLenSym.push_back(syms.add(name + "_len", MSection::Const, len));
+        strLen.push_back(len);
+    }
+
+    startSym = syms.add("_start", MSection::Text);
+    plan = planLanes(ir);
+    channels = planChannels(ir, plan);
+    storage = planStorage(ir, plan);
+    assignLaneCode(opts);
+    assignStorage();
+    assignIo();
+    assignChannels();
+}
+
+void MachineLowering::assignLaneCode(const CodegenOptions& opts) {
+    std::unordered_map<int, MSym> cpuMask;
+    laneCode.reserve(plan.instances.size());
+    for (size_t k = 0; k < plan.instances.size(); ++k) {
+        LaneCode code;
+        code.core = -1;
+        if (!opts.laneCores.empty()) {
+            code.core = opts.laneCores[k % opts.laneCores.size()];
+            if (code.core < 0 || code.core >= kCpuMaskBytes * 8) {
+                throw std::runtime_error("Lane core out of range: " + std::to_string(code.core));
+            }
+            if (cpuMask.find(code.core) == cpuMask.end()) {
+                cpuMask[code.core] = syms.add("lane_cpu_" + std::to_string(code.core), MSection::Data);
+                cpuCores.push_back(code.core);
+                cpuMaskSym.push_back(cpuMask[code.core]);
+            }
+        }
+
+        std::string base = "lane_" + labelSafe(ir.text(plan.instances[k].lane)) + "_" + std::to_string(k);
+        code.entry = syms.add(base, MSection::Text);
+        code.spawned = syms.add(base + "_started", MSection::Text);
+        code.joinWait = syms.add(base + "_join", MSection::Text);
+        code.joinDone = syms.add(base + "_joined", MSection::Text);
+        laneCode.push_back(code);
+    }
+
+    if (!plan.instances.empty()) {
+        doneSym = syms.add("lane_done", MSection::Bss);
+        stacksSym = syms.add("lane_stacks", MSection::Bss);
+        abortSym = syms.add("lane_spawn_failed", MSection::Text);
+    }
+}
+
+void MachineLowering::assignStorage() {
+    groupSym.reserve(storage.groups.size());
+    for (size_t g = 0; g < storage.groups.size(); ++g) {
+        const StorageGroup& group = storage.groups[g];
+        std::string name = "vars_main";
+        if (group.shared) name = "vars_shared";
+        else if (group.lane != kNoSymbol) name = "vars_" + labelSafe(ir.text(group.lane)) + "_" + std::to_string(g);
+        groupSym.push_back(syms.add(name, MSection::Bss));
+    }
+}
+
+MOperand MachineLowering::slotMem(const ContainerSlot& slot, int32_t disp) const {
+    return MOperand::mem(groupSym[slot.group], static_cast<int32_t>(slot.offset) + disp);
+}
+
+MOperand MachineLowering::slotAddr(const ContainerSlot& slot, int32_t disp) const {
+    return MOperand::addr(groupSym[slot.group], static_cast<int32_t>(slot.offset) + disp);
+}
+
+const ContainerSlot* MachineLowering::textContainer(std::string_view name) const {
+    const ContainerSlot* slot = storage.find(name);
+    if (slot && (slot->type == SlotType::Text || slot->type == SlotType::Mixed)) return slot;
+    return nullptr;
+}
+
+void MachineLowering::assignIo() {
+    bool usesIo = false;
+    bool printsInts = false;
+    bool adjustsInts = false;
+    for (size_t i = 0; i < ir.size(); ++i) {
+        const IRInstr in = ir.at(i);
+        if (in.op == IROp::ADJUST) {
+            const ContainerSlot* slot = storage.find(ir.text(in.arg1));
+            adjustsInts = adjustsInts || (slot && slot->type == SlotType::Int);
+        }
+        if (in.op != IROp::PROCESS) continue;
+        std::string_view action = ir.text(in.arg1);
+        if (action == "write") {
+            usesIo = true;
+            const ContainerSlot* slot = ir.symbols.isString(in.arg2) ? nullptr : storage.find(ir.text(in.arg2));
+            printsInts = printsInts || (slot && slot->type == SlotType::Int);
+        } else if (action == "read" && ir.symbols.isString(in.arg2)) {
+            usesIo = true;
+            if (pathOf.find(in.arg2) == pathOf.end()) {
+                pathOf.emplace(in.arg2, static_cast<uint32_t>(pathSym.size()));
+                readPaths.push_back(in.arg2);
+                pathSym.push_back(syms.add("io_path_" + std::to_string(pathSym.size()), MSection::Data));
+            }
+        }
+    }
+    if (!usesIo) return;
+
+    newlineSym = syms.add("io_newline", MSection::Data);
+    readErrorSym = syms.add("io_read_error", MSection::Data);
+    writeErrorSym = syms.add("io_write_error", MSection::Data);
+    ioStateSym = syms.add("io_state", MSection::Bss);
+    ioAppendSym = syms.add("io_append", MSection::Text);
+    ioFlushSym = syms.add("io_flush", MSection::Text);
+    ioFlushMoreSym = syms.add("io_flush_more", MSection::Text);
+    ioFlushSkipSym = syms.add("io_flush_skip", MSection::Text);
+    ioFlushPartSym = syms.add("io_flush_partial", MSection::Text);
+    ioFlushDoneSym = syms.add("io_flush_done", MSection::Text);
+    ioMapSym = syms.add("io_map_file", MSection::Text);
+    ioMapCloseSym = syms.add("io_map_close", MSection::Text);
+    ioFailedSym = syms.add("io_read_failed", MSection::Text);
+    ioWriteFailedSym = syms.add("io_write_failed", MSection::Text);
+    ioFailSym = syms.add("io_fail", MSection::Text);
+    if (printsInts) {
+        ioIntSym = syms.add("io_append_int", MSection::Text);
+        ioIntNegateSym = syms.add("io_int_negate", MSection::Text);
+        ioIntDigitsSym = syms.add("io_int_digits", MSection::Text);
+        ioIntNextSym = syms.add("io_int_next", MSection::Text);
+        ioIntSignSym = syms.add("io_int_sign", MSection::Text);
+        ioIntQueueSym = syms.add("io_int_queue", MSection::Text);
+    }
+    // Overflow is only observable through output
+    if (adjustsInts) {
+        overflowErrorSym = syms.add("io_overflow_error", MSection::Data);
+        ioOverflowSym = syms.add("io_overflow", MSection::Text);
+    }
+}
+
+void MachineLowering::assignChannels() {
+    if (channels.empty()) return;
+    for (const ChannelInfo& c : channels.channels) {
+        chanSym.push_back(syms.add("chan_" + labelSafe(ir.text(c.name)), MSection::Bss));
+    }
+
+    // Received values are text views, like mapped files; sent numbers
+    // get their printed form as data
+    for (size_t i = 0; i < ir.size(); ++i) {
+        const IRInstr in = ir.at(i);
+        if (in.op == IROp::SEND && !ir.symbols.isString(in.arg2) && !isContainerRef(ir.symbols, in.arg2)) {
+            if (numberOf.find(in.arg2) == numberOf.end()) {
+                numberOf.emplace(in.arg2, static_cast<uint32_t>(numberSym.size()));
+                numbers.push_back(numberText(ir.text(in.arg2)));
+                numberSym.push_back(syms.add("chan_text_" + std::to_string(numberSym.size()), MSection::Data));
+            }
+        }
+    }
+
+    chanSendSym = syms.add("chan_send", MSection::Text);
+    chanSendSpscSym = syms.add("chan_send_spsc", MSection::Text);
+    chanSendTicketSym = syms.add("chan_send_ticket", MSection::Text);
+    chanRecvSym = syms.add("chan_receive", MSection::Text);
+    chanRecvSpscSym = syms.add("chan_receive_spsc", MSection::Text);
+    chanRecvTicketSym = syms.add("chan_receive_ticket", MSection::Text);
+    chanCellSym = syms.add("chan_cell", MSection::Text);
+    chanWaitSym = syms.add("chan_wait", MSection::Text);
+    chanSpinSym = syms.add("chan_spin", MSection::Text);
+    chanSleptSym = syms.add("chan_slept", MSection::Text);
+    chanReadySym = syms.add("chan_ready", MSection::Text);
+    chanWakeSym = syms.add("chan_wake", MSection::Text);
+    chanWakeDoneSym = syms.add("chan_wake_done", MSection::Text);
+}
+
+void MachineLowering::lowerData(MachineStreamer& out) const {
+    out.section(MSection::Data);
+    out.dataLine(msgSym, msgLenSym, kBannerText);
+    for (size_t n = 0; n < strings.entries.size(); ++n) {
+        // String content without the quotes
+        std::string_view text = ir.text(strings.entries[n]);
+        out.dataLine(strSym[n], strLenSym[n], text.substr(1, text.length() - 2));
+    }
+    for (size_t c = 0; c < cpuCores.size(); ++c) {
+        std::vector<uint8_t> mask(kCpuMaskBytes, 0);
+        mask[cpuCores[c] / 8] = static_cast<uint8_t>(1u << (cpuCores[c] % 8));
+        out.dataBytes(cpuMaskSym[c], mask);
+    }
+    if (ioStateSym != kNoMSym) {
+        for (size_t p = 0; p < readPaths.size(); ++p) {
+            std::string_view text = unquote(ir.text(readPaths[p]));
+            std::vector<uint8_t> bytes(text.begin(), text.end());
+            bytes.push_back(0);
+            out.dataBytes(pathSym[p], bytes);
+        }
+        out.dataBytes(newlineSym, {10});
+        std::string_view error(kReadErrorText, sizeof(kReadErrorText) - 1);
+        out.dataBytes(readErrorSym, std::vector<uint8_t>(error.begin(), error.end()));
+        std::string_view writeError(kWriteErrorText, sizeof(kWriteErrorText) - 1);
+        out.dataBytes(writeErrorSym, std::vector<uint8_t>(writeError.begin(), writeError.end()));
+        if (overflowErrorSym != kNoMSym) {
+            std::string_view overflow(kOverflowText, sizeof(kOverflowText) - 1);
+            out.dataBytes(overflowErrorSym, std::vector<uint8_t>(overflow.begin(), overflow.end()));
+        }
+    }
+    for (size_t n = 0; n < numbers.size(); ++n) {
+        out.dataBytes(numberSym[n], std::vector<uint8_t>(numbers[n].begin(), numbers[n].end()));
+    }
+
+    out.section(MSection::Bss);
+    if (!plan.instances.empty()) {
+        out.reserve(doneSym, plan.slotCount * kDoneStride, 64);
+        out.reserve(stacksSym, plan.slotCount * kLaneStackSize, 64);
+    }
+    if (ioStateSym != kNoMSym) {
+        out.reserve(ioStateSym, (plan.slotCount + 1) * kIoBlockSize, 64);
+    }
+    for (size_t g = 0; g < storage.groups.size(); ++g) {
+        if (storage.groups[g].size == 0) continue;
+        out.reserve(groupSym[g], storage.groups[g].size, kCacheLine);
+        for (const ContainerSlot& slot : storage.slots) {
+            if (slot.group != g) continue;
+            const std::string at = "+" + std::to_string(slot.offset);
+            if (slot.shared) out.comment({at, slot.name, slotTypeName(slot.type), "atomic"});
+            else out.comment({at, slot.name, slotTypeName(slot.type)});
+        }
+    }
+    for (size_t c = 0; c < chanSym.size(); ++c) {
+        out.reserve(chanSym[c], kChanCells + (channels.channels[c].capacity << kChanCellShift), 64);
+    }
+}
+
+void MachineLowering::lowerPrologue(MachineStreamer& out) const {
+    out.section(MSection::Text);
+    out.label(startSym);
+    if (ioStateSym != kNoMSym) {
+        out.emit(instr64(MOp::Mov, MOperand::mem(ioStateSym), MOperand::addr(ioStateSym, kIoHeader),
+                         "empty output buffer"));
+        out.blank();
+    }
+}
+
+void MachineLowering::lowerInstruction(size_t i, uint32_t thread, MachineStreamer& out) const {
+    const IRInstr in = ir.at(i);
+    std::string_view arg1 = ir.text(in.arg1);
+    std::string_view arg2 = ir.text(in.arg2);
+    const int32_t io = static_cast<int32_t>(thread) * kIoBlockSize;
+    out.comment({irOpName(in.op), arg1, arg2});
+
+    switch (in.op) {
+    case IROp::PROCESS:
+        if (arg1 == "write" && ir.symbols.isString(in.arg2)) {
+            // Queue the literal; io_append flushes when the buffer fills
+            int slot = strings.slot[i];
+            out.emit(instr(MOp::Mov, reg(Reg::RDI), MOperand::addr(ioStateSym, io), "this thread's buffer"));
+            out.emit(instr(MOp::Mov, reg(Reg::RSI), MOperand::addr(strSym[slot])));
+            out.emit(instr(MOp::Mov, reg(Reg::RDX), MOperand::equ(strLenSym[slot], strLen[slot])));
+            out.emit(jump(MOp::Call, ioAppendSym));
+        } else if (const ContainerSlot* text = arg1 == "write" ? textContainer(arg2) : nullptr) {
+            // The viewed text itself, then a newline
+            out.emit(instr(MOp::Mov, reg(Reg::RDI), MOperand::addr(ioStateSym, io), "this thread's buffer"));
+            out.emit(instr64(MOp::Mov, reg(Reg::RSI), slotMem(*text), "text"));
+            out.emit(instr64(MOp::Mov, reg(Reg::RDX), slotMem(*text, 8), "length"));
+            out.emit(jump(MOp::Call, ioAppendSym));
+            out.emit(instr(MOp::Mov, reg(Reg::RDI), MOperand::addr(ioStateSym, io)));
+            out.emit(instr(MOp::Mov, reg(Reg::RSI), MOperand::addr(newlineSym)));
+            out.emit(instr(MOp::Mov, reg(Reg::RDX), imm(1)));
+            out.emit(jump(MOp::Call, ioAppendSym));
+        } else if (const ContainerSlot* number = arg1 == "write" ? storage.find(arg2) : nullptr) {
+            if (number->type != SlotType::Int) notCompiled(ir, i, "only int and text containers can be written");
+            // Printed with its newline into the queued iovec's digit slot
+            out.emit(instr(MOp::Mov, reg(Reg::RDI), MOperand::addr(ioStateSym, io), "this thread's buffer"));
+            out.emit(instr64(MOp::Mov, reg(Reg::RAX), slotMem(*number), "value"));
+            out.emit(jump(MOp::Call, ioIntSym));
+        } else if (arg1 == "read" && ir.symbols.isString(in.arg2)) {
+            const ContainerSlot* file = storage.find(fileStem(unquote(arg2)));
+            if (!file) {
+                throw std::runtime_error("process read " + std::string(arg2) + ": no container for the file");
+            }
+            out.emit(instr(MOp::Mov, reg(Reg::RDI), MOperand::addr(pathSym[pathOf.at(in.arg2)])));
+            out.emit(instr(MOp::Mov, reg(Reg::RBX), slotAddr(*file), "container"));
+            out.emit(jump(MOp::Call, ioMapSym));
+        } else if (arg1 == "read" && !arg2.empty()) {
+            notCompiled(ir, i, "standard input cannot be read");
+        }
+        break;
+    case IROp::SEND: {
+        const uint32_t c = channels.of(in.arg1);
+        out.emit(instr(MOp::Mov, reg(Reg::RBX), MOperand::addr(chanSym[c]), "channel"));
+        if (ir.symbols.isString(in.arg2)) {
+            // The literal without the newline and NUL of its data entry
+            int slot = strings.slot[i];
+            out.emit(instr(MOp::Mov, reg(Reg::R12), MOperand::addr(strSym[slot])));
+            out.emit(instr(MOp::Mov, reg(Reg::R13), imm(strLen[slot] - 2)));
+        } else if (numberOf.count(in.arg2)) {
+            const uint32_t n = numberOf.at(in.arg2);
+            out.emit(instr(MOp::Mov, reg(Reg::R12), MOperand::addr(numberSym[n])));
+            out.emit(instr(MOp::Mov, reg(Reg::R13), imm(static_cast<int32_t>(numbers[n].size()))));
+        } else if (const ContainerSlot* text = textContainer(arg2)) {
+            out.emit(instr64(MOp::Mov, reg(Reg::R12), slotMem(*text)));
+            out.emit(instr64(MOp::Mov, reg(Reg::R13), slotMem(*text, 8)));
+        } else {
+            throw std::runtime_error("send " + std::string(arg1) + " " + std::string(arg2) +
+                                     ": only literals and text containers can be sent in compiled programs");
+        }
+        out.emit(instr(MOp::Mov, reg(Reg::R14), imm(static_cast<int32_t>(channels.channels[c].capacity - 1)), "mask"));
+        out.emit(jump(MOp::Call, channels.channels[c].singleProducer ? chanSendSpscSym : chanSendSym));
+        break;
+    }
+    case IROp::RECEIVE: {
+        const uint32_t c = channels.of(in.arg1);
+        const ContainerSlot& text = *storage.find(arg2);
+        out.emit(instr(MOp::Mov, reg(Reg::RBX), MOperand::addr(chanSym[c]), "channel"));
+        out.emit(instr(MOp::Mov, reg(Reg::R14), imm(static_cast<int32_t>(channels.channels[c].capacity - 1)), "mask"));
+        out.emit(jump(MOp::Call, channels.channels[c].singleConsumer ? chanRecvSpscSym : chanRecvSym));
+        out.emit(instr64(MOp::Mov, slotMem(text), reg(Reg::R12)));
+        out.emit(instr64(MOp::Mov, slotMem(text, 8), reg(Reg::R13)));
+        break;
+    }
+    case IROp::CREATE:
+    case IROp::MODIFY:
+    case IROp::ADJUST:
+    case IROp::DELETE:
+        if (const ContainerSlot* slot = storage.find(arg1)) lowerStore(i, thread, *slot, out);
+        break;
+    case IROp::LANE_START:
+        out.comment({"Lane", arg1, "begins"});
+        break;
+    case IROp::LANE_END:
+        out.comment({"Lane", arg1, "ends"});
+        break;
+    case IROp::SYNC:
+    case IROp::SYNC_ALL:
+        if (thread != 0) out.comment({"Sync inside a lane does not wait"});
+        break;
+    default:
+        break;
+    }
+}
+
+void MachineLowering::lowerStore(size_t i, uint32_t thread, const ContainerSlot& slot, MachineStreamer& out) const {
+    const IRInstr in = ir.at(i);
+    std::string_view arg2 = ir.text(in.arg2);
+    const bool text = slot.type == SlotType::Text || slot.type == SlotType::Mixed;
+    const ContainerSlot* from = nullptr;
+    if (isContainerRef(ir.symbols, in.arg2)) {
+        from = storage.find(arg2);
+    }
+
+    if (in.op == IROp::DELETE) {
+        // Emptied containers read as 0 or as empty text
+        out.emit(instr64(MOp::Mov, slotMem(slot), imm(0)));
+        if (text) out.emit(instr64(MOp::Mov, slotMem(slot, 8), imm(0)));
+        return;
+    }
+
+    if (in.op == IROp::ADJUST) {
+        if (arg2.empty()) return;
+        if (slot.type != SlotType::Int || (from && from->type != SlotType::Int)) {
+            notCompiled(ir, i, "only int containers can be adjusted");
+        }
+        // One read-modify-write on the slot; locked when lanes share it
+        MInstr add;
+        if (from) {
+            out.emit(instr64(MOp::Mov, reg(Reg::RAX), slotMem(*from)));
+            add = instr64(MOp::Add, slotMem(slot), reg(Reg::RAX));
+        } else if (fitsImm32(slotBits(arg2, SlotType::Int))) {
+            add = instr64(MOp::Add, slotMem(slot), imm(static_cast<int32_t>(slotBits(arg2, SlotType::Int))));
+        } else {
+            loadConstant(slotBits(arg2, SlotType::Int), out);
+            add = instr64(MOp::Add, slotMem(slot), reg(Reg::RAX));
+        }
+        if (slot.shared) {
+            add.note = "shared: atomic";
+            add = locked(add);
+        }
+        out.emit(add);
+        // The interpreter turns the container real instead of wrapping;
+        // stop with this thread's output so far
+        if (ioOverflowSym != kNoMSym) {
+            const int32_t io = static_cast<int32_t>(thread) * kIoBlockSize;
+            out.emit(instr(MOp::Mov, reg(Reg::RDI), MOperand::addr(ioStateSym, io), "this thread's buffer"));
+            out.emit(jump(MOp::Jo, ioOverflowSym));
+        }
+        return;
+    }
+
+    // create/modify: copy a container, or store a literal
+    if (from) {
+        if (from == &slot) return;
+        if (text != (from->type == SlotType::Text || from->type == SlotType::Mixed) ||
+            (slot.type == SlotType::Real && from->type == SlotType::Int)) {
+            notCompiled(ir, i, "containers of different types cannot be copied");
+        }
+        out.emit(instr64(MOp::Mov, reg(Reg::RAX), slotMem(*from)));
+        out.emit(instr64(MOp::Mov, slotMem(slot), reg(Reg::RAX)));
+        if (text) {
+            out.emit(instr64(MOp::Mov, reg(Reg::RAX), slotMem(*from, 8)));
+            out.emit(instr64(MOp::Mov, slotMem(slot, 8), reg(Reg::RAX)));
+        }
+    } else if (ir.symbols.isString(in.arg2)) {
+        // A view of the literal's data entry, without its newline and NUL
+        const int n = strings.slot[i];
+        out.emit(instr64(MOp::Mov, slotMem(slot), MOperand::addr(strSym[n])));
+        out.emit(instr64(MOp::Mov, slotMem(slot, 8), imm(strLen[n] - 2)));
+    } else if (slot.type == SlotType::Mixed) {
+        notCompiled(ir, i, "a container cannot hold both numbers and text");
+    } else {
+        const int64_t bits = slotBits(arg2, slot.type);
+        if (fitsImm32(bits)) {
+            out.emit(instr64(MOp::Mov, slotMem(slot), imm(static_cast<int32_t>(bits))));
+        } else {
+            loadConstant(bits, out);
+            out.emit(instr64(MOp::Mov, slotMem(slot), reg(Reg::RAX)));
+        }
+    }
+}
+
+void MachineLowering::lowerFlush(uint32_t thread, MachineStreamer& out) const {
+    if (ioStateSym == kNoMSym) return;
+    const int32_t io = static_cast<int32_t>(thread) * kIoBlockSize;
+    out.emit(instr(MOp::Mov, reg(Reg::RDI), MOperand::addr(ioStateSym, io), "flush buffered output"));
+    out.emit(jump(MOp::Call, ioFlushSym));
+}
+
+void MachineLowering::lowerSpawn(uint32_t instance, MachineStreamer& out) const {
+    const LaneInstance& lane = plan.instances[instance];
+    const LaneCode& code = laneCode[instance];
+    const int32_t done = static_cast<int32_t>(lane.slot) * kDoneStride;
+    const int32_t top = static_cast<int32_t>(lane.slot + 1) * kLaneStackSize - 8;
+    out.comment({"Start lane", ir.text(lane.lane), "on its own thread"});
+
+    // Output written before the spawn stays ahead of the lane's
+    lowerFlush(0, out);
+
+    // The child starts on its own stack and returns into the lane entry
+    out.emit(instr(MOp::Mov, MOperand::mem(doneSym, done), imm(0)));
+    out.emit(instr(MOp::Mov, MOperand::mem(stacksSym, top), MOperand::addr(code.entry), "entry on child stack"));
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(kSysClone), "sys_clone"));
+    out.emit(instr(MOp::Mov, reg(Reg::RDI), imm(kCloneThreadFlags), "thread sharing VM, files, signals"));
+    out.emit(instr(MOp::Mov, reg(Reg::RSI), MOperand::addr(stacksSym, top), "child stack"));
+    out.emit(instr(MOp::Syscall));
+    out.emit(instr(MOp::Test, reg(Reg::RAX), reg(Reg::RAX)));
+    out.emit(jump(MOp::Js, abortSym));
+    out.emit(jump(MOp::Jnz, code.spawned));
+    out.emit(instr(MOp::Ret, {}, {}, "child: pop the entry point"));
+    out.label(code.spawned);
+}
+
+void MachineLowering::lowerJoin(const LaneJoin& site, MachineStreamer& out) const {
+    lowerFlush(0, out);
+    for (uint32_t k : site.instances) {
+        const LaneInstance& lane = plan.instances[k];
+        const LaneCode& code = laneCode[k];
+        const int32_t done = static_cast<int32_t>(lane.slot) * kDoneStride;
+        out.comment({"Wait for lane", ir.text(lane.lane)});
+
+        // Sleep on the done flag until the lane thread sets it
+        out.label(code.joinWait);
+        out.emit(instr(MOp::Mov, reg(Reg::RAX), MOperand::mem(doneSym, done)));
+        out.emit(instr(MOp::Test, reg(Reg::RAX), reg(Reg::RAX)));
+        out.emit(jump(MOp::Jnz, code.joinDone));
+        out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(kSysFutex), "sys_futex"));
+        out.emit(instr(MOp::Mov, reg(Reg::RDI), MOperand::addr(doneSym, done)));
+        out.emit(instr(MOp::Mov, reg(Reg::RSI), imm(kFutexWaitPrivate), "FUTEX_WAIT_PRIVATE"));
+        out.emit(instr(MOp::Xor, reg(Reg::RDX), reg(Reg::RDX), "while the flag is 0"));
+        out.emit(instr(MOp::Xor, reg(Reg::R10), reg(Reg::R10), "no timeout"));
+        out.emit(instr(MOp::Syscall));
+        out.emit(jump(MOp::Jmp, code.joinWait));
+        out.label(code.joinDone);
+    }
+}
+
+void MachineLowering::lowerMain(size_t begin, size_t end, MachineStreamer& out) const {
+    const LaneJoin* site = plan.joinAt(begin);
+    const LaneJoin* last = plan.joins.data() + plan.joins.size();
+
+    for (size_t i = begin; i < end; ++i) {
+        if (plan.inLane[i]) {
+            if (plan.spawnAt[i]) {
+                lowerSpawn(plan.spawnAt[i] - 1, out);
+                out.blank();
+            }
+            continue;
+        }
+        lowerInstruction(i, 0, out);
+        if (site && site != last && site->at == i) {
+            lowerJoin(*site, out);
+            ++site;
+        }
+        out.blank();
+    }
+}
+
+void MachineLowering::lowerExit(MachineStreamer& out) const {
+    out.comment({"Exit program"});
+    if (const LaneJoin* site = plan.exitJoin()) {
+        lowerJoin(*site, out);
+    } else {
+        lowerFlush(0, out);
+    }
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(1), "sys_exit"));
+    out.emit(instr(MOp::Xor, reg(Reg::RBX), reg(Reg::RBX), "exit code 0"));
+    out.emit(instr(MOp::Int80));
+
+    if (!plan.instances.empty()) {
+        out.blank();
+        out.label(abortSym);
+        out.comment({"clone failed: stop every thread"});
+        out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(kSysExitGroup), "sys_exit_group"));
+        out.emit(instr(MOp::Mov, reg(Reg::RDI), imm(1), "exit code 1"));
+        out.emit(instr(MOp::Syscall));
+    }
+    if (ioStateSym != kNoMSym) {
+        lowerIoRuntime(out);
+    }
+    if (!channels.empty()) {
+        lowerChannelRuntime(out);
+    }
+}
+
+void MachineLowering::lowerIoRuntime(MachineStreamer& out) const {
+    // io_append: queue iovec {rsi, rdx} in the buffer at rdi
+    out.blank();
+    out.label(ioAppendSym);
+    out.emit(instr64(MOp::Mov, reg(Reg::RCX), MOperand::at(Reg::RDI), "next free iovec"));
+    out.emit(instr64(MOp::Mov, MOperand::at(Reg::RCX), reg(Reg::RSI)));
+    out.emit(instr64(MOp::Mov, MOperand::at(Reg::RCX, 8), reg(Reg::RDX)));
+    out.emit(instr64(MOp::Add, reg(Reg::RCX), imm(16)));
+    out.emit(instr64(MOp::Mov, MOperand::at(Reg::RDI), reg(Reg::RCX)));
+    out.emit(instr64(MOp::Lea, reg(Reg::RAX), MOperand::at(Reg::RDI, kIoDigits), "past the last iovec"));
+    out.emit(instr64(MOp::Cmp, reg(Reg::RCX), reg(Reg::RAX)));
+    out.emit(jump(MOp::Jz, ioFlushSym));
+    out.emit(instr(MOp::Ret));
+
+    // io_flush: writev everything queued in the buffer at rdi. A short
+    // write (a file over the kernel's per-call limit, a signal, a full
+    // pipe) resumes from the first byte not written.
+    out.blank();
+    out.label(ioFlushSym);
+    out.emit(instr64(MOp::Lea, reg(Reg::RSI), MOperand::at(Reg::RDI, kIoHeader), "first iovec"));
+    out.emit(instr64(MOp::Mov, reg(Reg::RDX), MOperand::at(Reg::RDI)));
+    out.emit(instr64(MOp::Sub, reg(Reg::RDX), reg(Reg::RSI)));
+    out.emit(instr64(MOp::Shr, reg(Reg::RDX), imm(4), "iovec count"));
+    out.emit(jump(MOp::Jz, ioFlushDoneSym));
+    out.emit(instr64(MOp::Mov, MOperand::at(Reg::RDI), reg(Reg::RSI), "empty the buffer"));
+    out.label(ioFlushMoreSym);
+    out.emit(instr64(MOp::Mov, reg(Reg::R8), reg(Reg::RSI), "iovecs left"));
+    out.emit(instr64(MOp::Mov, reg(Reg::R9), reg(Reg::RDX)));
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(kSysWritev), "sys_writev"));
+    out.emit(instr(MOp::Mov, reg(Reg::RDI), imm(1), "stdout"));
+    out.emit(instr(MOp::Syscall));
+    out.emit(instr64(MOp::Cmp, reg(Reg::RAX), imm(-kEintr), "interrupted: retry"));
+    out.emit(jump(MOp::Jz, ioFlushMoreSym));
+    out.emit(instr64(MOp::Test, reg(Reg::RAX), reg(Reg::RAX)));
+    out.emit(jump(MOp::Js, ioWriteFailedSym));
+    out.label(ioFlushSkipSym);
+    out.emit(instr64(MOp::Sub, reg(Reg::RAX), MOperand::at(Reg::R8, 8), "past this iovec?"));
+    out.emit(jump(MOp::Js, ioFlushPartSym));
+    out.emit(instr64(MOp::Add, reg(Reg::R8), imm(16)));
+    out.emit(instr64(MOp::Sub, reg(Reg::R9), imm(1)));
+    out.emit(jump(MOp::Jnz, ioFlushSkipSym));
+    out.label(ioFlushDoneSym);
+    out.emit(instr(MOp::Ret));
+    out.label(ioFlushPartSym);
+    out.emit(instr64(MOp::Add, reg(Reg::RAX), MOperand::at(Reg::R8, 8), "bytes of it written"));
+    out.emit(instr64(MOp::Add, MOperand::at(Reg::R8), reg(Reg::RAX)));
+    out.emit(instr64(MOp::Sub, MOperand::at(Reg::R8, 8), reg(Reg::RAX)));
+    out.emit(instr64(MOp::Mov, reg(Reg::RSI), reg(Reg::R8)));
+    out.emit(instr64(MOp::Mov, reg(Reg::RDX), reg(Reg::R9)));
+    out.emit(jump(MOp::Jmp, ioFlushMoreSym));
+
+    if (ioIntSym != kNoMSym) {
+        // io_append_int: queue the decimal text of rax and a newline,
+        // written backwards into the digit slot of the next free iovec
+        out.blank();
+        out.label(ioIntSym);
+        out.emit(instr64(MOp::Mov, reg(Reg::RSI), MOperand::at(Reg::RDI), "next free iovec"));
+        out.emit(instr64(MOp::Sub, reg(Reg::RSI), reg(Reg::RDI)));
+        out.emit(instr64(MOp::Shl, reg(Reg::RSI), imm(1)));
+        out.emit(instr64(MOp::Add, reg(Reg::RSI), reg(Reg::RDI)));
+        out.emit(instr64(MOp::Lea, reg(Reg::R9), MOperand::at(Reg::RSI, kIoDigits - 2 * kIoHeader + kIoDigitSlot),
+                         "end of its digit slot"));
+        out.emit(instr64(MOp::Lea, reg(Reg::RSI), MOperand::at(Reg::R9, -1)));
+        out.emit(instr8(MOp::Mov, MOperand::at(Reg::RSI), imm('\n'), "newline"));
+        out.emit(instr64(MOp::Mov, reg(Reg::R8), reg(Reg::RAX), "keep the sign"));
+        out.emit(instr64(MOp::Test, reg(Reg::RAX), reg(Reg::RAX)));
+        out.emit(jump(MOp::Js, ioIntNegateSym));
+        out.label(ioIntDigitsSym);
+        out.emit(instr(MOp::Mov, reg(Reg::RCX), imm(10)));
+        out.label(ioIntNextSym);
+        out.emit(instr(MOp::Xor, reg(Reg::RDX), reg(Reg::RDX)));
+        out.emit(instr64(MOp::Div, reg(Reg::RCX), {}, "unsigned: INT64_MIN negates to itself"));
+        out.emit(instr(MOp::Add, reg(Reg::RDX), imm('0')));
+        out.emit(instr64(MOp::Sub, reg(Reg::RSI), imm(1)));
+        out.emit(instr8(MOp::Mov, MOperand::at(Reg::RSI), reg(Reg::RDX)));
+        out.emit(instr64(MOp::Test, reg(Reg::RAX), reg(Reg::RAX)));
+        out.emit(jump(MOp::Jnz, ioIntNextSym));
+        out.emit(instr64(MOp::Test, reg(Reg::R8), reg(Reg::R8)));
+        out.emit(jump(MOp::Js, ioIntSignSym));
+        out.label(ioIntQueueSym);
+        out.emit(instr64(MOp::Mov, reg(Reg::RDX), reg(Reg::R9)));
+        out.emit(instr64(MOp::Sub, reg(Reg::RDX), reg(Reg::RSI), "length"));
+        out.emit(jump(MOp::Jmp, ioAppendSym));
+        out.label(ioIntNegateSym);
+        out.emit(instr64(MOp::Neg, reg(Reg::RAX)));
+        out.emit(jump(MOp::Jmp, ioIntDigitsSym));
+        out.label(ioIntSignSym);
+        out.emit(instr64(MOp::Sub, reg(Reg::RSI), imm(1)));
+        out.emit(instr8(MOp::Mov, MOperand::at(Reg::RSI), imm('-')));
+        out.emit(jump(MOp::Jmp, ioIntQueueSym));
+    }
+
+    // io_map_file: map the file named at rdi into the {ptr, len} at rbx
+    out.blank();
+    out.label(ioMapSym);
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(kSysOpen), "sys_open"));
+    out.emit(instr(MOp::Xor, reg(Reg::RSI), reg(Reg::RSI), "O_RDONLY"));
+    out.emit(instr(MOp::Syscall));
+    out.emit(instr64(MOp::Test, reg(Reg::RAX), reg(Reg::RAX)));
+    out.emit(jump(MOp::Js, ioFailedSym));
+    out.emit(instr64(MOp::Mov, reg(Reg::R8), reg(Reg::RAX), "fd"));
+    out.emit(instr64(MOp::Mov, reg(Reg::RDI), reg(Reg::RAX)));
+    out.emit(instr(MOp::Xor, reg(Reg::RSI), reg(Reg::RSI)));
+    out.emit(instr(MOp::Mov, reg(Reg::RDX), imm(kSeekEnd), "SEEK_END: file size"));
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(kSysLseek), "sys_lseek"));
+    out.emit(instr(MOp::Syscall));
+    out.emit(instr64(MOp::Test, reg(Reg::RAX), reg(Reg::RAX)));
+    out.emit(jump(MOp::Js, ioFailedSym));
+    out.emit(instr64(MOp::Mov, MOperand::at(Reg::RBX, 8), reg(Reg::RAX)));
+    out.emit(instr64(MOp::Mov, MOperand::at(Reg::RBX), imm(0)));
+    out.emit(jump(MOp::Jz, ioMapCloseSym));
+    out.emit(instr64(MOp::Mov, reg(Reg::RSI), reg(Reg::RAX), "length"));
+    out.emit(instr(MOp::Xor, reg(Reg::RDI), reg(Reg::RDI), "kernel picks the address"));
+    out.emit(instr(MOp::Mov, reg(Reg::RDX), imm(kProtRead), "PROT_READ"));
+    out.emit(instr(MOp::Mov, reg(Reg::R10), imm(kMapPrivate), "MAP_PRIVATE"));
+    out.emit(instr(MOp::Xor, reg(Reg::R9), reg(Reg::R9), "offset 0"));
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(kSysMmap), "sys_mmap"));
+    out.emit(instr(MOp::Syscall));
+    out.emit(instr64(MOp::Test, reg(Reg::RAX), reg(Reg::RAX)));
+    out.emit(jump(MOp::Js, ioFailedSym));
+    out.emit(instr64(MOp::Mov, MOperand::at(Reg::RBX), reg(Reg::RAX)));
+    out.label(ioMapCloseSym);
+    out.emit(instr64(MOp::Mov, reg(Reg::RDI), reg(Reg::R8)));
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(kSysClose), "sys_close"));
+    out.emit(instr(MOp::Syscall));
+    out.emit(instr(MOp::Ret));
+
+    out.blank();
+    out.label(ioFailedSym);
+    out.comment({"open, lseek or mmap failed"});
+    out.emit(instr(MOp::Mov, reg(Reg::RSI), MOperand::addr(readErrorSym)));
+    out.emit(instr(MOp::Mov, reg(Reg::RDX), imm(static_cast<int32_t>(sizeof(kReadErrorText) - 1))));
+    out.emit(jump(MOp::Jmp, ioFailSym));
+    out.label(ioWriteFailedSym);
+    out.comment({"writev failed"});
+    out.emit(instr(MOp::Mov, reg(Reg::RSI), MOperand::addr(writeErrorSym)));
+    out.emit(instr(MOp::Mov, reg(Reg::RDX), imm(static_cast<int32_t>(sizeof(kWriteErrorText) - 1))));
+    out.emit(jump(MOp::Jmp, ioFailSym));
+    if (ioOverflowSym != kNoMSym) {
+        out.label(ioOverflowSym);
+        out.comment({"an int adjust overflowed: flush rdi's output first"});
+        out.emit(jump(MOp::Call, ioFlushSym));
+        out.emit(instr(MOp::Mov, reg(Reg::RSI), MOperand::addr(overflowErrorSym)));
+        out.emit(instr(MOp::Mov, reg(Reg::RDX), imm(static_cast<int32_t>(sizeof(kOverflowText) - 1))));
+    }
+    out.label(ioFailSym);
+    out.comment({"print the message at rsi, stop every thread"});
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(kSysWrite), "sys_write"));
+    out.emit(instr(MOp::Mov, reg(Reg::RDI), imm(2), "stderr"));
+    out.emit(instr(MOp::Syscall));
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(kSysExitGroup), "sys_exit_group"));
+    out.emit(instr(MOp::Mov, reg(Reg::RDI), imm(1), "exit code 1"));
+    out.emit(instr(MOp::Syscall));
+}
+
+void MachineLowering::lowerChannelRuntime(MachineStreamer& out) const {
+    // Arguments: rbx = channel, r14 = capacity - 1, r12/r13 = {ptr, len}
+    // sent or received. Clobbers rax-rdx, rsi, rdi, r8-r11 and r15.
+    const MOperand sleepers = MOperand::at(Reg::RBX, kChanSleepers);
+
+    // chan_send: take a ticket, wait for the cell's sender turn, store
+    out.blank();
+    out.label(chanSendSym);
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(1)));
+    out.emit(locked(instr64(MOp::Xadd, MOperand::at(Reg::RBX, kChanTail), reg(Reg::RAX), "send ticket")));
+    out.emit(jump(MOp::Jmp, chanSendTicketSym));
+    out.label(chanSendSpscSym);
+    out.emit(instr64(MOp::Mov, reg(Reg::RAX), MOperand::at(Reg::RBX, kChanTail), "only sender: no lock"));
+    out.emit(instr64(MOp::Lea, reg(Reg::RCX), MOperand::at(Reg::RAX, 1)));
+    out.emit(instr64(MOp::Mov, MOperand::at(Reg::RBX, kChanTail), reg(Reg::RCX)));
+    out.label(chanSendTicketSym);
+    out.emit(jump(MOp::Call, chanCellSym));
+    out.emit(jump(MOp::Call, chanWaitSym));
+    out.emit(instr64(MOp::Mov, MOperand::at(Reg::R15, 8), reg(Reg::R12)));
+    out.emit(instr64(MOp::Mov, MOperand::at(Reg::R15, 16), reg(Reg::R13)));
+    out.emit(locked(instr(MOp::Add, MOperand::at(Reg::R15), imm(1))));
+    out.emit(jump(MOp::Jmp, chanWakeSym));
+
+    // chan_receive: the same on the head ticket, one turn later
+    out.blank();
+    out.label(chanRecvSym);
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(1)));
+    out.emit(locked(instr64(MOp::Xadd, MOperand::at(Reg::RBX, kChanHead), reg(Reg::RAX), "receive ticket")));
+    out.emit(jump(MOp::Jmp, chanRecvTicketSym));
+    out.label(chanRecvSpscSym);
+    out.emit(instr64(MOp::Mov, reg(Reg::RAX), MOperand::at(Reg::RBX, kChanHead), "only receiver: no lock"));
+    out.emit(instr64(MOp::Lea, reg(Reg::RCX), MOperand::at(Reg::RAX, 1)));
+    out.emit(instr64(MOp::Mov, MOperand::at(Reg::RBX, kChanHead), reg(Reg::RCX)));
+    out.label(chanRecvTicketSym);
+    out.emit(jump(MOp::Call, chanCellSym));
+    out.emit(instr(MOp::Add, reg(Reg::R8), imm(1), "receiver turn"));
+    out.emit(jump(MOp::Call, chanWaitSym));
+    out.emit(instr64(MOp::Mov, reg(Reg::R12), MOperand::at(Reg::R15, 8)));
+    out.emit(instr64(MOp::Mov, reg(Reg::R13), MOperand::at(Reg::R15, 16)));
+    out.emit(locked(instr(MOp::Add, MOperand::at(Reg::R15), reg(Reg::R14))));
+    out.emit(jump(MOp::Jmp, chanWakeSym));
+
+    // chan_cell: ticket rax -> cell r15, round start turn r8d
+    out.blank();
+    out.label(chanCellSym);
+    out.emit(instr64(MOp::Mov, reg(Reg::R15), reg(Reg::RAX)));
+    out.emit(instr64(MOp::And, reg(Reg::R15), reg(Reg::R14), "cell index"));
+    out.emit(instr64(MOp::Mov, reg(Reg::R8), reg(Reg::RAX)));
+    out.emit(instr64(MOp::Sub, reg(Reg::R8), reg(Reg::R15)));
+    out.emit(instr64(MOp::Shl, reg(Reg::R15), imm(kChanCellShift)));
+    out.emit(instr64(MOp::Add, reg(Reg::R15), reg(Reg::RBX)));
+    out.emit(instr64(MOp::Add, reg(Reg::R15), imm(kChanCells)));
+    out.emit(instr(MOp::Ret));
+
+    // chan_wait: spin, then sleep on the turn word until it equals r8d
+    out.blank();
+    out.label(chanWaitSym);
+    out.emit(instr(MOp::Mov, reg(Reg::R9), imm(static_cast<int32_t>(kChannelSpins))));
+    out.label(chanSpinSym);
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), MOperand::at(Reg::R15), "turn"));
+    out.emit(instr(MOp::Cmp, reg(Reg::RAX), reg(Reg::R8)));
+    out.emit(jump(MOp::Jz, chanReadySym));
+    out.emit(instr(MOp::Pause));
+    out.emit(instr(MOp::Sub, reg(Reg::R9), imm(1)));
+    out.emit(jump(MOp::Jnz, chanSpinSym));
+    out.emit(locked(instr(MOp::Add, sleepers, imm(1))));
+    out.emit(instr(MOp::Mov, reg(Reg::RDX), MOperand::at(Reg::R15), "recheck once announced"));
+    out.emit(instr(MOp::Cmp, reg(Reg::RDX), reg(Reg::R8)));
+    out.emit(jump(MOp::Jz, chanSleptSym));
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(kSysFutex), "sys_futex"));
+    out.emit(instr64(MOp::Mov, reg(Reg::RDI), reg(Reg::R15)));
+    out.emit(instr(MOp::Mov, reg(Reg::RSI), imm(kFutexWaitPrivate), "FUTEX_WAIT_PRIVATE"));
+    out.emit(instr(MOp::Xor, reg(Reg::R10), reg(Reg::R10), "no timeout"));
+    out.emit(instr(MOp::Syscall));
+    out.label(chanSleptSym);
+    out.emit(locked(instr(MOp::Sub, sleepers, imm(1))));
+    out.emit(jump(MOp::Jmp, chanWaitSym));
+    out.label(chanReadySym);
+    out.emit(instr(MOp::Ret));
+
+    // chan_wake: wake sleepers on the cell just handed over, if any
+    out.blank();
+    out.label(chanWakeSym);
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), sleepers));
+    out.emit(instr(MOp::Test, reg(Reg::RAX), reg(Reg::RAX)));
+    out.emit(jump(MOp::Jz, chanWakeDoneSym));
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(kSysFutex), "sys_futex"));
+    out.emit(instr64(MOp::Mov, reg(Reg::RDI), reg(Reg::R15)));
+    out.emit(instr(MOp::Mov, reg(Reg::RSI), imm(kFutexWakePrivate), "FUTEX_WAKE_PRIVATE"));
+    out.emit(instr(MOp::Mov, reg(Reg::RDX), imm(INT32_MAX), "every sleeper"));
+    out.emit(instr(MOp::Syscall));
+    out.label(chanWakeDoneSym);
+    out.emit(instr(MOp::Ret));
+}
+
+void MachineLowering::lowerLane(size_t index, MachineStreamer& out) const {
+    const LaneInstance& lane = plan.instances[index];
+    const LaneCode& code = laneCode[index];
+    const int32_t done = static_cast<int32_t>(lane.slot) * kDoneStride;
+
+    out.blank();
+    out.label(code.entry);
+    if (code.core >= 0) {
+        size_t c = std::find(cpuCores.begin(), cpuCores.end(), code.core) - cpuCores.begin();
+        out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(kSysSchedSetAffinity), "sys_sched_setaffinity"));
+        out.emit(instr(MOp::Xor, reg(Reg::RDI), reg(Reg::RDI), "this thread"));
+        out.emit(instr(MOp::Mov, reg(Reg::RSI), imm(kCpuMaskBytes)));
+        out.emit(instr(MOp::Mov, reg(Reg::RDX), MOperand::addr(cpuMaskSym[c])));
+        out.emit(instr(MOp::Syscall));
+        out.blank();
+    }
+
+    if (ioStateSym != kNoMSym) {
+        const int32_t io = static_cast<int32_t>(lane.slot + 1) * kIoBlockSize;
+        out.emit(instr64(MOp::Mov, MOperand::mem(ioStateSym, io), MOperand::addr(ioStateSym, io + kIoHeader),
+                         "empty output buffer"));
+        out.blank();
+    }
+
+    for (uint32_t i : lane.body) {
+        lowerInstruction(i, lane.slot + 1, out);
+        out.blank();
+    }
+    lowerFlush(lane.slot + 1, out);
+
+    // Publish completion, wake the joiner, and end this thread only
+    out.emit(instr(MOp::Mov, MOperand::mem(doneSym, done), imm(1), "lane finished"));
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(kSysFutex), "sys_futex"));
+    out.emit(instr(MOp::Mov, reg(Reg::RDI), MOperand::addr(doneSym, done)));
+    out.emit(instr(MOp::Mov, reg(Reg::RSI), imm(kFutexWakePrivate), "FUTEX_WAKE_PRIVATE"));
+    out.emit(instr(MOp::Mov, reg(Reg::RDX), imm(1)));
+    out.emit(instr(MOp::Syscall));
+    out.emit(instr(MOp::Mov, reg(Reg::RAX), imm(kSysExit), "sys_exit"));
+    out.emit(instr(MOp::Xor, reg(Reg::RDI), reg(Reg::RDI)));
+    out.emit(instr(MOp::Syscall));
+}
+
+void MachineLowering::lowerAll(MachineStreamer& out) const {
+    lowerData(out);
+    lowerPrologue(out);
+    lowerMain(0, ir.size(), out);
+    lowerExit(out);
+    for (size_t k = 0; k < plan.instances.size(); ++k) {
+        lowerLane(k, out);
+    }
+}
+
+} // namespace EScript
@@ -0,0 +1,154 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "channels.hpp"
+#include "ir.hpp"
+#include "lanes.hpp"
+#include "mc.hpp"
+#include "storage.hpp"
+
+namespace EScript {
+
+// Lowers an IRProgram to machine code for either backend, including the
+// lane runtime: every lane instance of the LanePlan runs on its own
+// clone()d thread with a bss stack per slot, and SYNC/SYNC_ALL join the
+// lanes they cover through futex waits.
+//
+// Containers live in the groups of the StoragePlan, one bss block each.
+// Numeric create/modify/adjust/delete are plain loads and stores on
+// their slots, locked when the container is shared between lanes. Int
+// adjusts that overflow stop the program, since the interpreter would
+// turn the container real. Statements the backends cannot run as the
+// interpreter does (real or mixed output, real adjusts, copies between
+// container types, line reads) are compile errors.
+//
+// Output goes through a buffered runtime: each thread appends iovecs
+// to its own block in io_state and hands them to writev when the block
+// fills, before it spawns or joins lanes, and when it ends. Written int
+// containers are printed into a digit slot beside their iovec. `process
+// read "file"` mmaps the file into the container named by its stem, so
+// writing that container queues the mapping itself. Channels are the
+// turn-counted rings described in channels.hpp, carrying {ptr, len}
+// text views; `receive` stores the view in the target's text slot.
+class MachineLowering {
+public:
+    MachineLowering(const IRProgram& ir, const CodegenOptions& opts);
+
+    const MachineSymbols& symbols() const { return syms; }
+    MSym entry() const { return startSym; }
+    size_t laneCount() const { return plan.instances.size(); }
+
+    // Program pieces in output order: data and bss, the text prologue,
+    // main code for IR ranges, the exit sequence, then each lane's thread
+    void lowerData(MachineStreamer& out) const;
+    void lowerPrologue(MachineStreamer& out) const;
+    void lowerMain(size_t begin, size_t end, MachineStreamer& out) const;
+    void lowerExit(MachineStreamer& out) const;
+    void lowerLane(size_t index, MachineStreamer& out) const;
+
+    // Everything above, in order
+    void lowerAll(MachineStreamer& out) const;
+
+private:
+    // Machine-level details of one LaneInstance
+    struct LaneCode {
+        int core;                   // pinned core, -1 when unpinned
+        MSym entry;                 // thread entry label
+        MSym spawned;               // resume point of the spawning thread
+        MSym joinWait;
+        MSym joinDone;
+    };
+
+    const IRProgram& ir;
+    MachineSymbols syms;
+    StringLayout strings;
+    std::vector<MSym> strSym;
+    std::vector<MSym> strLenSym;
+    std::vector<int32_t> strLen;
+    MSym msgSym = kNoMSym;
+    MSym msgLenSym = kNoMSym;
+    MSym startSym = kNoMSym;
+
+    LanePlan plan;
+    std::vector<LaneCode> laneCode;
+    std::vector<int> cpuCores;      // distinct pinned cores
+    std::vector<MSym> cpuMaskSym;
+    MSym doneSym = kNoMSym;
+    MSym stacksSym = kNoMSym;
+    MSym abortSym = kNoMSym;
+
+    // Container storage, one bss block per group
+    StoragePlan storage;
+    std::vector<MSym> groupSym;
+
+    // Buffered I/O runtime, only emitted when the program does I/O
+    std::vector<SymbolId> readPaths;            // literals of io_path_N
+    std::vector<MSym> pathSym;                  // NUL-terminated copies
+    std::unordered_map<SymbolId, uint32_t> pathOf;
+    MSym ioStateSym = kNoMSym;
+    MSym newlineSym = kNoMSym;
+    MSym readErrorSym = kNoMSym;
+    MSym writeErrorSym = kNoMSym;
+    MSym ioAppendSym = kNoMSym;
+    MSym ioFlushSym = kNoMSym;
+    MSym ioFlushMoreSym = kNoMSym;
+    MSym ioFlushSkipSym = kNoMSym;
+    MSym ioFlushPartSym = kNoMSym;
+    MSym ioFlushDoneSym = kNoMSym;
+    MSym ioMapSym = kNoMSym;
+    MSym ioMapCloseSym = kNoMSym;
+    MSym ioFailedSym = kNoMSym;
+    MSym ioWriteFailedSym = kNoMSym;
+    MSym ioFailSym = kNoMSym;                   // message at rsi, exit code 1
+    MSym ioIntSym = kNoMSym;                    // only when an int container is written
+    MSym ioIntNegateSym = kNoMSym;
+    MSym ioIntDigitsSym = kNoMSym;
+    MSym ioIntNextSym = kNoMSym;
+    MSym ioIntSignSym = kNoMSym;
+    MSym ioIntQueueSym = kNoMSym;
+    MSym overflowErrorSym = kNoMSym;            // only when an int container is adjusted
+    MSym ioOverflowSym = kNoMSym;
+
+    // Channel runtime
+    ChannelPlan channels;
+    std::vector<MSym> chanSym;
+    std::vector<std::string> numbers;           // printed form of sent numbers
+    std::vector<MSym> numberSym;
+    std::unordered_map<SymbolId, uint32_t> numberOf;
+    MSym chanSendSym = kNoMSym;
+    MSym chanSendSpscSym = kNoMSym;
+    MSym chanSendTicketSym = kNoMSym;
+    MSym chanRecvSym = kNoMSym;
+    MSym chanRecvSpscSym = kNoMSym;
+    MSym chanRecvTicketSym = kNoMSym;
+    MSym chanCellSym = kNoMSym;
+    MSym chanWaitSym = kNoMSym;
+    MSym chanSpinSym = kNoMSym;
+    MSym chanSleptSym = kNoMSym;
+    MSym chanReadySym = kNoMSym;
+    MSym chanWakeSym = kNoMSym;
+    MSym chanWakeDoneSym = kNoMSym;
+
+    void assignLaneCode(const CodegenOptions& opts);
+    void assignStorage();
+    void assignIo();
+    void assignChannels();
+    // thread is 0 for the main thread and slot + 1 for lane threads
+    void lowerInstruction(size_t i, uint32_t thread, MachineStreamer& out) const;
+    void lowerStore(size_t i, uint32_t thread, const ContainerSlot& slot, MachineStreamer& out) const;
+    // [slot + disp] and its address
+    MOperand slotMem(const ContainerSlot& slot, int32_t disp = 0) const;
+    MOperand slotAddr(const ContainerSlot& slot, int32_t disp = 0) const;
+    // Containers that hold a {ptr, len} view
+    const ContainerSlot* textContainer(std::string_view name) const;
+    void lowerFlush(uint32_t thread, MachineStreamer& out) const;
+    void lowerIoRuntime(MachineStreamer& out) const;
+    void lowerChannelRuntime(MachineStreamer& out) const;
+    void lowerSpawn(uint32_t instance, MachineStreamer& out) const;
+    void lowerJoin(const LaneJoin& site, MachineStreamer& out) const;
+};
+
+} // namespace EScript
@@ -1,17 +1,74 @@
 ﻿#include "all.hpp"
+#include "driver.hpp"
+#include "cache.hpp"
+#include "daemon.hpp"
+#include "profile.hpp"
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <memory>
+#include <new>
+#include <set>
+#include <stdexcept>
 #include "main.h"
 
 using namespace EScript;
 
+#ifndef ES_NO_PROFILE
+// Allocation counters for -time-report and -trace; one relaxed load
+// per allocation while the profiler is off. GCC flags free() on memory
+// from operator new once these inline into library code.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(size_t size) {
+    Profiler::noteAlloc(size);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
 void printUsage() {
-    std::cout << "E-Script Compiler v1.0.0\n";
-    std::cout << "Usage: e-script <input.es> [options]\n\n";
+    std::cout << "E-Script Compiler v" << kCompilerVersion << "\n";
+    std::cout << "Usage: e-script <input.es> [options]\n";
+    std::cout << "       e-script <a.es> <b.es> ... [options]\n";
+    std::cout << "       e-script -manifest <list.txt> [options]\n\n";
     std::cout << "Options:\n";
     std::cout << "  -o <output>    Specify output filename (default: a.out)\n";
     std::cout << "  -asm           Keep assembly file\n";
+    std::cout << "  -O0, -O1, -O2  Optimization level (default: -O0)\n";
+    std::cout << "  -run           Interpret the program in-process instead of building it\n";
+    std::cout << "  -check         Stop after IR generation; report front-end errors only\n";
+    std::cout << "  -emit-pool     Compile define statements into <output>.pool for `use pool`\n";
+    std::cout << "  -emit-ir-bin   Write the IR with source locations to <output>.esir; .esir inputs\n";
+    std::cout << "                 skip the front end\n";
+    std::cout << "  -pool-path <dir>  Also search <dir> for pools (after the input's directory)\n";
+    std::cout << "  -backend=<b>   nasm (assemble and link, default) or direct (built-in ELF writer)\n";
+    std::cout << "  -asm-units=<n> Split NASM output into <n> units assembled in parallel (0 = one per core)\n";
+    std::cout << "  -lane-cores=<list>  Pin lane threads round-robin to cores, e.g. 0,2,4\n";
+    std::cout << "  -auto-lanes[=<n>]  Run independent statements of a serial program on up to <n>\n";
+    std::cout << "                 lanes, synced only where a dependency needs it (default: all cores)\n";
+    std::cout << "  -manifest <f>  Read input files from <f>, one per line\n";
+    std::cout << "  -outdir <dir>  Write batch outputs to <dir>\n";
+    std::cout << "  -j <n>         Worker threads for batch mode or -run lanes (default: all cores); with\n";
+    std::cout << "                 one input, also lexes and parses large sources in parallel\n";
+    std::cout << "  -cache <dir>   Reuse IR, assembly and executables of unchanged inputs\n";
+    std::cout << "                 (default: $ESCRIPT_CACHE if set)\n";
+    std::cout << "  -cache-size <MB>  Evict least recently used entries above this size (default: 512)\n";
+    std::cout << "  -cache-stats   Print cache hit/miss statistics\n";
+    std::cout << "  -no-cache      Ignore $ESCRIPT_CACHE\n";
+    std::cout << "  --daemon <sock>  Serve compile/run/check requests on a Unix socket\n";
+    std::cout << "  --client <sock>  Send this invocation to a daemon instead of compiling\n";
+    std::cout << "  -shutdown      With --client: stop the daemon\n";
+    std::cout << "  -time-report   Print wall/CPU time, allocations and peak RSS per phase\n";
+    std::cout << "  -trace=<file>  Write a Chrome trace (chrome://tracing, Perfetto) of phases and lanes\n";
     std::cout << "  -tokens        Print tokens (debug)\n";
     std::cout << "  -ast       Print AST (debug)\n";
     std::cout << "  -ir    Print IR (debug)\n";
@@ -19,166 +76,348 @@ void printUsage() {
     std::cout << "\nE-Script: Every Line Operates.\n";
 }
 
-void printTokens(const std::vector<Token>& tokens) {
-    std::cout << "\n=== TOKENS ===\n";
-    for (const auto& tok : tokens) {
-      std::cout << "[" << tok.line << ":" << tok.column << "] " 
-        << tok.type << " : '" << tok.value << "'\n";
-    }
-    std::cout << "=============\n\n";
+void printCacheStats(BuildCache& cache) {
+    CacheStats stats = cache.stats();
+    uint64_t lookups = stats.hits + stats.misses;
+    std::cout << "[Cache] " << cache.directory() << ": " << stats.entries << " entries, "
+              << (stats.bytes + 1023) / 1024 << " KB\n";
+    std::cout << "[Cache] " << stats.hits << " hits, " << stats.misses << " misses ("
+              << (lookups ? stats.hits * 100 / lookups : 0) << "% hit rate), "
+              << stats.stores << " stores, " << stats.evictions << " evictions\n";
 }
 
-void printAST(const Program& prog) {
-    std::cout << "\n=== AST ===\n";
-    std::cout << "Program {\n";
-    for (const auto& op : prog.ops) {
-    std::cout << "  Operation {\n";
-        std::cout << "    op: " << op->op << "\n";
-  std::cout << "    ident: " << op->ident << "\n";
-        std::cout << "    value: " << op->value << "\n";
- if (op->nested) {
-          std::cout << "    nested: { op: " << op->nested->op 
-       << ", ident: " << op->nested->ident 
-             << ", value: " << op->nested->value << " }\n";
-        }
-        std::cout << "  }\n";
+// --client: one request per input over a single connection, carrying
+// the compile options. Paths are made absolute and the working directory
+// is sent because the daemon has its own.
+int runClient(const std::string& socketPath, const std::vector<std::string>& inputs,
+              const std::string& outputFile, const std::string& outputDir,
+              const CompileOptions& opts, bool stats, bool shutdown) {
+    namespace fs = std::filesystem;
+    DaemonClient client(socketPath);
+    int status = 0;
+
+    DaemonRequest req;
+    req.kind = opts.run ? RequestKind::Run : opts.check ? RequestKind::Check : RequestKind::Compile;
+    req.optLevel = static_cast<uint8_t>(opts.optLevel);
+    req.backend = opts.backend;
+    req.showTokens = opts.showTokens;
+    req.showAST = opts.showAST;
+    req.showIR = opts.showIR;
+    req.keepAsm = opts.keepAsm;
+    req.autoLanes = opts.autoLanes;
+    req.emitPool = opts.emitPool;
+    req.emitIR = opts.emitIR;
+    req.autoLaneCount = static_cast<uint32_t>(opts.autoLaneCount);
+    req.asmUnits = static_cast<uint32_t>(opts.asmUnits);
+    req.laneCores = opts.codegen.laneCores;
+    for (const auto& dir : opts.poolPaths) req.poolPaths.push_back(fs::absolute(dir).string());
+    req.workDir = fs::current_path().string();
+    const bool sideOutput = opts.emitPool || opts.emitIR;
+    for (const auto& input : inputs) {
+        std::string output;
+        if (!outputFile.empty()) {
+            output = outputFile;
+        }
+        else if (!outputDir.empty()) {
+            output = (fs::path(outputDir) / fs::path(replaceExtension(input, "")).filename()).string();
+        }
+        else {
+            output = inputs.size() == 1 && !sideOutput ? "a.out" : replaceExtension(input, "");
+        }
+        req.input = fs::absolute(input).string();
+        req.output = fs::absolute(output).string();
+
+        DaemonResponse resp = client.request(req);
+        std::cout << resp.log;
+        std::cout.write(resp.output.data(), static_cast<std::streamsize>(resp.output.size()));
+        if (resp.status != 0) {
+            std::cerr << "  ✗ " << input << "\n";
+            status = 1;
+        }
+    }
+
+    if (stats || shutdown) {
+        req = DaemonRequest();
+        req.kind = shutdown ? RequestKind::Shutdown : RequestKind::Stats;
+        std::cout << client.request(req).log;
     }
-    std::cout << "}\n";
-    std::cout << "===========\n\n";
+    return status;
 }
 
-void printIR(const std::vector<IRInstr>& ir) {
-    std::cout << "\n=== IR ===\n";
-    for (const auto& instr : ir) {
-        std::cout << instr.op << " " << instr.arg1 << " " << instr.arg2;
-        if (!instr.label.empty()) {
-     std::cout << " [" << instr.label << "]";
-      }
-    std::cout << "\n";
+// "0,2,4" -> {0, 2, 4}
+std::vector<int> parseCoreList(const std::string& list) {
+    std::vector<int> cores;
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos) comma = list.size();
+        std::string item = list.substr(pos, comma - pos);
+        if (item.empty() || item.find_first_not_of("0123456789") != std::string::npos) {
+            throw std::runtime_error("Invalid core list: " + list);
+        }
+        cores.push_back(std::stoi(item));
+        pos = comma + 1;
     }
-    std::cout << "==========\n\n";
+    return cores;
 }
 
 int main(int argc, char** argv) {
     try {
-      if (argc < 2) {
+        if (argc < 2) {
             printUsage();
-   return 1;
+            return 1;
         }
  
-        std::string inputFile;
-      std::string outputFile = "a.out";
-        bool keepAsm = false;
-        bool showTokens = false;
-        bool showAST = false;
-        bool showIR = false;
+        std::vector<std::string> inputFiles;
+        std::string outputFile;
+        std::string outputDir;
+        size_t threads = 0;
+        bool threadsGiven = false;
+        CompileOptions opts;
+        std::string cacheDir;
+        uint64_t cacheMB = 512;
+        bool noCache = false;
+        bool showCacheStats = false;
+        std::string daemonSocket;
+        std::string clientSocket;
+        bool shutdown = false;
+        bool timeReport = false;
+        std::string traceFile;
+        if (const char* env = std::getenv("ESCRIPT_CACHE")) {
+            cacheDir = env;
+        }
    
         // Parse command line arguments
         for (int i = 1; i < argc; ++i) {
-       std::string arg = argv[i];
+            std::string arg = argv[i];
           
-     if (arg == "-h" || arg == "--help") {
+            if (arg == "-h" || arg == "--help") {
                 printUsage();
-        return 0;
-    }
+                return 0;
+            }
             else if (arg == "-o" && i + 1 < argc) {
-     outputFile = argv[++i];
-  }
-         else if (arg == "-asm") {
-       keepAsm = true;
-       }
- else if (arg == "-tokens") {
-         showTokens = true;
+                outputFile = argv[++i];
+            }
+            else if (arg == "-outdir" && i + 1 < argc) {
+                outputDir = argv[++i];
+            }
+            else if (arg == "-manifest" && i + 1 < argc) {
+                for (auto& path : readManifest(argv[++i])) {
+                    inputFiles.push_back(path);
+                }
+            }
+            else if (arg == "-j" && i + 1 < argc) {
+                threads = static_cast<size_t>(std::stoul(argv[++i]));
+                threadsGiven = true;
+            }
+            else if (arg == "-cache" && i + 1 < argc) {
+                cacheDir = argv[++i];
+            }
+            else if (arg == "-cache-size" && i + 1 < argc) {
+                cacheMB = std::stoull(argv[++i]);
+            }
+            else if (arg == "-cache-stats") {
+                showCacheStats = true;
+            }
+            else if (arg == "-no-cache") {
+                noCache = true;
+            }
+            else if (arg == "-O0" || arg == "-O1" || arg == "-O2") {
+                opts.optLevel = arg[2] - '0';
+            }
+            else if (arg == "-backend=nasm") {
+                opts.backend = Backend::Nasm;
+            }
+            else if (arg == "-backend=direct") {
+                opts.backend = Backend::Direct;
+            }
+            else if (arg.rfind("-asm-units=", 0) == 0) {
+                opts.asmUnits = static_cast<size_t>(std::stoul(arg.substr(11)));
+            }
+            else if (arg == "-auto-lanes") {
+                opts.autoLanes = true;
+            }
+            else if (arg.rfind("-auto-lanes=", 0) == 0) {
+                opts.autoLanes = true;
+                opts.autoLaneCount = static_cast<size_t>(std::stoul(arg.substr(12)));
+            }
+            else if (arg.rfind("-lane-cores=", 0) == 0) {
+                opts.codegen.laneCores = parseCoreList(arg.substr(12));
+            }
+            else if (arg == "-run") {
+                opts.run = true;
+            }
+            else if (arg == "-check") {
+                opts.check = true;
+            }
+            else if (arg == "-emit-pool") {
+                opts.emitPool = true;
+            }
+            else if (arg == "-emit-ir-bin") {
+                opts.emitIR = true;
+            }
+            else if (arg == "-pool-path" && i + 1 < argc) {
+                opts.poolPaths.push_back(argv[++i]);
+            }
+            else if (arg == "--daemon" && i + 1 < argc) {
+                daemonSocket = argv[++i];
+            }
+            else if (arg == "--client" && i + 1 < argc) {
+                clientSocket = argv[++i];
+            }
+            else if (arg == "-shutdown") {
+                shutdown = true;
+            }
+            else if (arg == "-time-report") {
+                timeReport = true;
+            }
+            else if (arg.rfind("-trace=", 0) == 0) {
+                traceFile = arg.substr(7);
+            }
+            else if (arg == "-asm") {
+                opts.keepAsm = true;
+            }
+            else if (arg == "-tokens") {
+                opts.showTokens = true;
             }
-    else if (arg == "-ast") {
-     showAST = true;
+            else if (arg == "-ast") {
+                opts.showAST = true;
             }
             else if (arg == "-ir") {
-        showIR = true;
-          }
-        else if (arg[0] != '-') {
-   inputFile = arg;
-       }
+                opts.showIR = true;
+            }
+            else if (arg[0] != '-') {
+                inputFiles.push_back(arg);
+            }
             else {
-        std::cerr << "Unknown option: " << arg << "\n";
-          return 1;
- }
+                std::cerr << "Unknown option: " << arg << "\n";
+                return 1;
+            }
         }
         
-        if (inputFile.empty()) {
-  std::cerr << "Error: No input file specified\n";
-         printUsage();
+        Profiler::start(timeReport, traceFile);
+
+        std::unique_ptr<BuildCache> cache;
+        if (!cacheDir.empty() && !noCache) {
+            cache = std::make_unique<BuildCache>(cacheDir, cacheMB << 20);
+            opts.cache = cache.get();
+        }
+        if (!clientSocket.empty()) {
+            if (inputFiles.empty() && !showCacheStats && !shutdown) {
+                std::cerr << "Error: No input file specified\n";
+                return 1;
+            }
+            return runClient(clientSocket, inputFiles, outputFile, outputDir, opts,
+                             showCacheStats, shutdown);
+        }
+        if (!daemonSocket.empty()) {
+            opts.runThreads = threads;
+            return runDaemon(daemonSocket, opts, threads, std::cout);
+        }
+
+        if (showCacheStats && inputFiles.empty()) {
+            if (!cache) {
+                std::cerr << "Error: -cache-stats needs -cache <dir> or $ESCRIPT_CACHE\n";
+                return 1;
+            }
+            printCacheStats(*cache);
+            return 0;
+        }
+
+        if (inputFiles.empty()) {
+            std::cerr << "Error: No input file specified\n";
+            printUsage();
             return 1;
         }
+
+        // Single file: compile in-process and stream progress directly
+        if (inputFiles.size() == 1 && outputDir.empty()) {
+            CompileJob job;
+            job.input = inputFiles[0];
+            bool sideOutput = opts.emitPool || opts.emitIR;
+            job.output = outputFile.empty() ? (sideOutput ? replaceExtension(job.input, "") : "a.out")
+                                            : outputFile;
+            job.asmFile = replaceExtension(job.output, ".asm");
+            opts.runThreads = threads;
+            if (threadsGiven) opts.frontendThreads = threads;
+
+            int linkResult = compileFile(job, opts, std::cout);
+            Profiler::finish(std::cout);
+            if (showCacheStats && cache) {
+                printCacheStats(*cache);
+            }
         
-        // Read source file
-        std::cout << "[E-Script] Compiling: " << inputFile << "\n";
-   std::ifstream in(inputFile);
-  if (!in) {
-            std::cerr << "Error: Cannot open file: " << inputFile << "\n";
-          return 1;
+            if (opts.run || opts.check) {
+                return linkResult;
+            }
+            if (linkResult == 0) {
+                std::cout << "\n✓ Compilation successful!\n";
+                std::cout << "  Output: " << artifactPath(job, opts) << "\n";
+            }
+            else {
+                std::cerr << "\n✗ Compilation failed!\n";
+                return 1;
+            }
+            return 0;
         }
-        
-        std::stringstream buffer;
-        buffer << in.rdbuf();
-  std::string source = buffer.str();
-        in.close();
-        
-  // Lexical analysis
-        std::cout << "[Lexer] Tokenizing...\n";
-     auto tokens = tokenize(source);
-     std::cout << "[Lexer] Generated " << tokens.size() << " tokens\n";
-        
-        if (showTokens) {
-          printTokens(tokens);
-        }
-     
-     // Parsing
-        std::cout << "[Parser] Building AST...\n";
- Parser parser(tokens);
-        auto ast = parser.parse();
-        std::cout << "[Parser] Parsed " << ast->ops.size() << " operations\n";
-  
- if (showAST) {
-            printAST(*ast);
+
+        // Batch: one job per input, each with its own artifact paths
+        if (opts.run) {
+            std::cerr << "Error: -run takes a single input file\n";
+            return 1;
         }
-        
-        // IR Generation
-  std::cout << "[IR] Generating intermediate representation...\n";
-      auto ir = generateIR(*ast);
-        std::cout << "[IR] Generated " << ir.size() << " instructions\n";
-        
-        if (showIR) {
-        printIR(ir);
+        if (!outputFile.empty()) {
+            std::cerr << "Error: -o cannot be used with multiple inputs; use -outdir\n";
+            return 1;
         }
-        
-        // Code Generation
-        std::string asmFile = "output.asm";
-      std::cout << "[CodeGen] Generating assembly...\n";
-        emitNASM(ir, asmFile);
-     
-        // Linking
-        std::cout << "[Linker] Building executable...\n";
-        int linkResult = autoLink(asmFile, outputFile);
-        
-        if (linkResult == 0) {
-        std::cout << "\n✓ Compilation successful!\n";
-     std::cout << "  Output: " << outputFile << ".exe\n";
-          
-    // Clean up assembly file unless -asm flag is set
-     if (!keepAsm) {
 
+        std::vector<CompileJob> jobs;
+        std::set<std::string> seenOutputs;
+        for (const auto& input : inputFiles) {
+            CompileJob job;
+            job.input = input;
+            job.output = replaceExtension(input, "");
+            if (!outputDir.empty()) {
+                size_t slash = job.output.find_last_of("/\\");
+                std::string base = slash == std::string::npos ? job.output : job.output.substr(slash + 1);
+                job.output = outputDir + "/" + base;
             }
- }
-  else {
-      std::cerr << "\n✗ Compilation failed!\n";
-            return 1;
+            job.asmFile = job.output + ".asm";
+            if (!seenOutputs.insert(job.output).second) {
+                std::cerr << "Error: Two inputs would both write " << job.output << "\n";
+                return 1;
+            }
+            jobs.push_back(job);
         }
-        
-        return 0;
+
+        std::cout << "[E-Script] Batch compiling " << jobs.size() << " files\n";
+        auto results = compileBatch(jobs, opts, threads);
+
+        // Aggregate diagnostics in input order
+        size_t failed = 0;
+        for (const auto& result : results) {
+            std::cout << result.log;
+            if (result.status != 0) {
+                failed++;
+            }
+        }
+
+        std::cout << "\n[E-Script] Batch complete: " << (results.size() - failed)
+                  << " succeeded, " << failed << " failed\n";
+        if (showCacheStats && cache) {
+            printCacheStats(*cache);
+        }
+        Profiler::finish(std::cout);
+        for (const auto& result : results) {
+            if (result.status != 0) {
+                std::cerr << "  ✗ " << result.input << "\n";
+            }
+        }
+        return failed == 0 ? 0 : 1;
     }
     catch (const std::exception& e) {
-     std::cerr << "\n✗ Error: " << e.what() << "\n";
+        std::cerr << "\n✗ Error: " << e.what() << "\n";
+        Profiler::finish(std::cout);
         return 1;
     }
 }
@@ -0,0 +1,132 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace EScript {
+
+// Machine-level representation shared by both backends. Lowering (see
+// lower.cpp) streams instructions into a MachineStreamer; the NASM
+// streamer prints them, the direct streamer encodes them.
+
+enum class Reg : uint8_t {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+enum class Width : uint8_t { W8 = 1, W32 = 4, W64 = 8 };
+
+using MSym = uint32_t;
+constexpr MSym kNoMSym = UINT32_MAX;
+
+enum class MSection : uint8_t { Text, Data, Bss, Const };
+
+struct MSymbolInfo {
+    std::string name;
+    MSection section;
+    int64_t value;      // Const symbols only (NASM equ)
+};
+
+class MachineSymbols {
+    std::vector<MSymbolInfo> syms;
+
+public:
+    MSym add(std::string name, MSection section, int64_t value = 0) {
+        syms.push_back(MSymbolInfo{std::move(name), section, value});
+        return static_cast<MSym>(syms.size() - 1);
+    }
+    const MSymbolInfo& operator[](MSym s) const { return syms[s]; }
+    size_t size() const { return syms.size(); }
+};
+
+struct MOperand {
+    enum class Kind : uint8_t { None, Reg, Imm, Addr, Mem };
+
+    Kind kind = Kind::None;
+    Reg reg = Reg::RAX;     // Reg: the register; Mem: base register when hasBase
+    bool hasBase = false;
+    MSym sym = kNoMSym;     // Addr/Mem: symbol (kNoMSym for none); Imm: equ symbol
+    int32_t value = 0;      // Imm: immediate; Addr/Mem: displacement
+
+    static MOperand r(Reg reg) {
+        MOperand o;
+        o.kind = Kind::Reg;
+        o.reg = reg;
+        return o;
+    }
+    static MOperand imm(int32_t v) {
+        MOperand o;
+        o.kind = Kind::Imm;
+        o.value = v;
+        return o;
+    }
+    // Immediate named by a Const symbol (printed by name, encoded by value)
+    static MOperand equ(MSym s, int32_t v) {
+        MOperand o = imm(v);
+        o.sym = s;
+        return o;
+    }
+    // Absolute address of sym + disp as an immediate
+    static MOperand addr(MSym s, int32_t disp = 0) {
+        MOperand o;
+        o.kind = Kind::Addr;
+        o.sym = s;
+        o.value = disp;
+        return o;
+    }
+    // Memory at [sym + disp]
+    static MOperand mem(MSym s, int32_t disp = 0) {
+        MOperand o;
+        o.kind = Kind::Mem;
+        o.sym = s;
+        o.value = disp;
+        return o;
+    }
+    // Memory at [base + disp]
+    static MOperand at(Reg base, int32_t disp = 0) {
+        MOperand o;
+        o.kind = Kind::Mem;
+        o.reg = base;
+        o.hasBase = true;
+        o.value = disp;
+        return o;
+    }
+};
+
+enum class MOp : uint8_t {
+    Mov, Add, Sub, Cmp, And, Or, Xor, Test, Lea, Shl, Shr, Xadd,
+    Neg, Div,                   // one operand; div is unsigned rdx:rax / dst
+    Jmp, Jz, Jnz, Js, Jo, Call,
+    Ret, Syscall, Int80, Pause
+};
+
+struct MInstr {
+    MOp op;
+    Width width = Width::W32;
+    bool lock = false;          // lock prefix for read-modify-write on memory
+    MOperand dst;
+    MOperand src;               // jumps/calls: target is dst.sym
+    const char* note = nullptr; // trailing comment in the NASM text
+};
+
+// Sink for lowered code and data. Sections arrive in order: data, bss, text.
+class MachineStreamer {
+public:
+    virtual ~MachineStreamer() = default;
+
+    virtual void section(MSection s) = 0;
+
+    // `sym db '<text>', 0Ah, 0` followed by `lenSym equ $ - sym`
+    virtual void dataLine(MSym sym, MSym lenSym, std::string_view text) = 0;
+    virtual void dataBytes(MSym sym, const std::vector<uint8_t>& bytes) = 0;
+    virtual void reserve(MSym sym, uint32_t bytes, uint32_t align) = 0;
+
+    virtual void label(MSym sym) = 0;
+    virtual void comment(std::initializer_list<std::string_view> parts) = 0;
+    virtual void blank() = 0;
+    virtual void emit(const MInstr& in) = 0;
+};
+
+} // namespace EScript
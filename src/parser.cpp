@@ -1,22 +1,24 @@
 #include "parser.hpp"
+#include "profile.hpp"
 #include <stdexcept>
 
 namespace EScript {
 
-Parser::Parser(std::vector<Token> t) : tokens(std::move(t)), pos(0) {}
+Parser::Parser(std::string_view source, std::vector<Token> t)
+    : src(source), tokens(std::move(t)), pos(0), prog(nullptr) {}
 
 bool Parser::eof() const {
     return pos >= tokens.size();
 }
 
-bool Parser::match(const std::string& t) const {
-    return !eof() && tokens[pos].type == t;
+bool Parser::match(TokenKind k) const {
+    return !eof() && tokens[pos].kind == k;
 }
 
 Token Parser::consume() {
     if (eof()) {
         throw std::runtime_error("Unexpected end of input");
-}
+    }
     return tokens[pos++];
 }
 
@@ -27,111 +29,159 @@ Token Parser::current() const {
     return tokens[pos];
 }
 
+std::string_view Parser::text(const Token& tok) const {
+    return tok.text(src);
+}
+
+uint32_t Parser::newNode() {
+    return prog->nodeCount++;
+}
+
 std::unique_ptr<Program> Parser::parse() {
-    auto prog = std::make_unique<Program>();
-  
+    ES_TIME_SCOPE("parse");
+    // Every statement ends in '#' and each lane or define adds one nested node,
+    // which bounds the node count before a single node is built. The
+    // extra node covers a final statement that fails to terminate.
+    size_t statements = 0;
+    size_t nested = 0;
+    for (const Token& tok : tokens) {
+        if (tok.kind == TokenKind::HASH) statements++;
+        else if (tok.kind == TokenKind::KW_LANE || tok.kind == TokenKind::KW_DEFINE) nested++;
+    }
+    // One chunk holds both arrays, so a one-statement parse stays small
+    const size_t bytes = sizeof(Operation) * (statements + nested + 1) + sizeof(uint32_t) * statements +
+                         alignof(Operation) + alignof(uint32_t);
+    auto result = std::make_unique<Program>(bytes);
+    prog = result.get();
+    prog->nodes = prog->arena.allocateArray<Operation>(statements + nested + 1);
+    prog->ops = prog->arena.allocateArray<uint32_t>(statements);
+
     while (!eof()) {
-        auto op = parseOperation();
-        if (op) {
-     prog->ops.push_back(std::move(op));
-        }
-  }
-    
-    return prog;
+        prog->ops[prog->opCount++] = parseOperation();
+    }
+
+    prog = nullptr;
+    return result;
 }
 
-std::unique_ptr<Operation> Parser::parseOperation() {
-    auto op = std::make_unique<Operation>();
-    
-  if (eof()) {
-    return nullptr;
-    }
-    
+uint32_t Parser::parseOperation() {
     Token tok = current();
+    uint32_t index = newNode();
+    Operation* op = &prog->nodes[index];
     op->line = tok.line;
     op->column = tok.column;
+    bool terminated = false;
   
     // Parse operation keywords
-    if (peek("KW_MODIFY", "KW_ADJUST", "KW_BYPASS", "KW_DELETE", 
-            "KW_PROCESS", "KW_CREATE", "KW_DEPLOY", "KW_LANE", "KW_SYNC")) {
+    if (peek(TokenKind::KW_MODIFY, TokenKind::KW_ADJUST, TokenKind::KW_BYPASS,
+             TokenKind::KW_DELETE, TokenKind::KW_PROCESS, TokenKind::KW_CREATE,
+             TokenKind::KW_DEPLOY, TokenKind::KW_LANE, TokenKind::KW_SYNC,
+             TokenKind::KW_CHANNEL, TokenKind::KW_SEND, TokenKind::KW_RECEIVE,
+             TokenKind::KW_USE, TokenKind::KW_CALL, TokenKind::KW_DEFINE)) {
         
-        op->op = consume().value;
+        Token kw = consume();
+        op->op = text(kw);
+        op->kind = kw.kind;
       
         // BYPASS and SYNC might have optional identifiers
-    if (op->op == "bypass" || op->op == "sync") {
-      if (match("IDENT")) {
-            op->ident = consume().value;
-     }
+        if (kw.kind == TokenKind::KW_BYPASS || kw.kind == TokenKind::KW_SYNC) {
+            if (match(TokenKind::IDENT)) {
+                op->ident = text(consume());
+            }
         }
-        // LANE requires identifier and nested operation
-        else if (op->op == "lane") {
-            if (match("IDENT")) {
-        op->ident = consume().value;
-     }
+        // LANE and DEFINE take an identifier and a nested operation
+        else if (kw.kind == TokenKind::KW_LANE || kw.kind == TokenKind::KW_DEFINE) {
+            if (match(TokenKind::IDENT)) {
+                op->ident = text(consume());
+            }
             
-         // Parse nested operation for lane
-    if (!match("HASH")) {
-   op->nested = parseOperation();
-          }
+            // The nested operation consumes the statement terminator
+            if (!match(TokenKind::HASH)) {
+                uint32_t nested = parseOperation();
+                op = &prog->nodes[index];
+                op->nested = nested;
+                terminated = true;
+            }
+        }
+        // CALL names an entry, optionally "from pool" or from "<pool>"
+        else if (kw.kind == TokenKind::KW_CALL) {
+            if (match(TokenKind::IDENT)) {
+                op->ident = text(consume());
+            }
+            if (match(TokenKind::IDENT) && text(current()) == "from") {
+                consume();
+                if (match(TokenKind::STRING) || (match(TokenKind::IDENT) && text(current()) == "pool")) {
+                    op->value = text(consume());
+                } else {
+                    throw std::runtime_error(
+                        "Expected 'pool' or a pool name after 'from' at line " +
+                        std::to_string(tok.line) + ", column " + std::to_string(tok.column)
+                    );
+                }
+            }
         }
         // Most operations need an identifier
         else {
-      if (match("IDENT")) {
-  op->ident = consume().value;
-       }
+            if (match(TokenKind::IDENT)) {
+                op->ident = text(consume());
+            }
  
-         // Parse value/expression
-       if (match("NUMBER") || match("STRING")) {
-             op->value = consume().value;
+            // Parse value/expression
+            if (match(TokenKind::NUMBER) || match(TokenKind::STRING)) {
+                op->value = text(consume());
             }
-else if (match("IDENT")) {
-   op->value = consume().value;
+            else if (match(TokenKind::IDENT)) {
+                op->value = text(consume());
+            }
+            // Handle "to" keyword for expressions like "process write to"
+            else if (match(TokenKind::TO)) {
+                consume(); // consume "to"
+                if (match(TokenKind::STRING) || match(TokenKind::IDENT)) {
+                    op->value = text(consume());
+                }
             }
- // Handle "to" keyword for expressions like "process write to"
-            else if (match("TO")) {
-     consume(); // consume "to"
-       if (match("STRING") || match("IDENT")) {
-              op->value = consume().value;
-    }
-      }
         }
   
         // Handle action keywords for process operations
-        if (op->op == "process") {
-      if (peek("ACTION_READ", "ACTION_WRITE", "ACTION_PING", "ACTION_ANALYZE")) {
-          op->ident = consume().value;
+        if (kw.kind == TokenKind::KW_PROCESS) {
+            if (peek(TokenKind::ACTION_READ, TokenKind::ACTION_WRITE,
+                     TokenKind::ACTION_PING, TokenKind::ACTION_ANALYZE)) {
+                op->ident = text(consume());
          
-    // Actions can have arguments
-           if (match("STRING") || match("IDENT")) {
-     op->value = consume().value;
-            }
-      else if (match("TO")) {
-      consume(); // consume "to"
-   if (match("STRING") || match("IDENT")) {
-      op->value = consume().value;
-      }
-   }
+                // Actions can have arguments
+                if (match(TokenKind::STRING) || match(TokenKind::IDENT)) {
+                    op->value = text(consume());
+                }
+                else if (match(TokenKind::TO)) {
+                    consume(); // consume "to"
+                    if (match(TokenKind::STRING) || match(TokenKind::IDENT)) {
+                        op->value = text(consume());
+                    }
+                }
             }
- }
+        }
         
         // Consume statement terminator
-        if (match("HASH")) {
-          consume();
-      } else {
-     throw std::runtime_error(
-       "Expected '#' at end of statement at line " + 
-      std::to_string(tok.line) + ", column " + std::to_string(tok.column)
+        if (terminated) {
+            // already consumed by the nested operation
+        }
+        else if (match(TokenKind::HASH)) {
+            consume();
+        } else {
+            throw std::runtime_error(
+                "Expected '#' at end of statement at line " + 
+                std::to_string(tok.line) + ", column " + std::to_string(tok.column)
             );
         }
     }
-  else {
+    else {
         throw std::runtime_error(
-            "Unexpected token '" + tok.value + "' at line " + 
-       std::to_string(tok.line) + ", column " + std::to_string(tok.column)
+            "Unexpected token '" + std::string(text(tok)) + "' at line " + 
+            std::to_string(tok.line) + ", column " + std::to_string(tok.column)
         );
-  }
+    }
     
-    return op;
+    return index;
 }
 
 } // namespace EScript
@@ -1,66 +1,72 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <string>
+#include <string_view>
+#include "arena.hpp"
 #include "tokens.hpp"
 
 namespace EScript {
 
-// Forward declarations
-struct ASTNode {
-    virtual ~ASTNode() = default;
-    std::string type;
-    int line;
-    int column;
-};
+constexpr uint32_t kNoNode = UINT32_MAX;
 
-struct Operation : ASTNode {
-    std::string op;        // modify, adjust, bypass, delete, process, etc.
-    std::string ident;     // identifier or target
-    std::string value;   // expression or value
-    std::unique_ptr<Operation> nested;  // for nested operations (e.g., lane operations)
-    
-    Operation() {
-    type = "Operation";
-        line = 0;
-        column = 0;
-    }
+// Fixed-size, non-virtual AST node. Children are indices into Program::nodes.
+struct Operation {
+    std::string_view op;      // modify, adjust, bypass, delete, process, etc.
+    std::string_view ident;   // identifier or target
+    std::string_view value;   // expression or value
+    uint32_t nested = kNoNode;  // nested operation (e.g., lane operations)
+    uint32_t line = 0;
+    uint32_t column = 0;
+    TokenKind kind = TokenKind::KW_MODIFY;  // keyword that introduced the operation
 };
 
-struct Program : ASTNode {
-    std::vector<std::unique_ptr<Operation>> ops;
-    
-  Program() {
-    type = "Program";
-        line = 0;
-     column = 0;
+// Flat AST. All nodes live in one arena block sized before parsing,
+// so the whole tree is allocated and freed in O(1) chunks.
+struct Program {
+    explicit Program(size_t arenaBytes = 64 * 1024) : arena(arenaBytes) {}
+
+    Arena arena;
+    Operation* nodes = nullptr;   // every operation, nested ones included
+    uint32_t nodeCount = 0;
+    uint32_t* ops = nullptr;      // top-level operations in source order
+    uint32_t opCount = 0;
+
+    size_t size() const { return opCount; }
+    const Operation& op(size_t i) const { return nodes[ops[i]]; }
+    const Operation& node(uint32_t index) const { return nodes[index]; }
+    const Operation* nestedOf(const Operation& o) const {
+        return o.nested == kNoNode ? nullptr : &nodes[o.nested];
     }
 };
 
 class Parser {
+    std::string_view src;
     std::vector<Token> tokens;
     size_t pos;
+    Program* prog;
     
     bool eof() const;
-    bool match(const std::string& t) const;
+    bool match(TokenKind k) const;
     
-    template<typename... T>
-    bool peek(T... names) const {
-    std::string arr[] = {names...};
-  for (const auto& n : arr) {
-  if (match(n)) return true;
-    }
-    return false;
+    template<typename... K>
+    bool peek(K... kinds) const {
+        if (eof()) return false;
+        TokenKind k = tokens[pos].kind;
+        return ((k == kinds) || ...);
     }
     
     Token consume();
-Token current() const;
+    Token current() const;
+    std::string_view text(const Token& tok) const;
+    uint32_t newNode();
     
 public:
-    explicit Parser(std::vector<Token> t);
+    Parser(std::string_view source, std::vector<Token> t);
   
     std::unique_ptr<Program> parse();
-    std::unique_ptr<Operation> parseOperation();
+    uint32_t parseOperation();
 };
 
 } // namespace EScript
@@ -0,0 +1,210 @@
+#include "passes.hpp"
+#include "profile.hpp"
+#include "storage.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace EScript {
+
+void PassManager::add(std::string name, std::function<size_t(IRProgram&)> run) {
+    passes.push_back(IRPass{std::move(name), std::move(run)});
+}
+
+size_t PassManager::run(IRProgram& ir, std::ostream& log) const {
+    ES_TIME_SCOPE("optimize");
+    size_t total = 0;
+    for (const auto& pass : passes) {
+        ES_TIME_SCOPE_CAT(pass.name, "pass");
+        size_t changed = pass.run(ir);
+        if (changed > 0) {
+            log << "[Opt] " << pass.name << ": " << changed << " changed\n";
+        }
+        total += changed;
+    }
+    return total;
+}
+
+PassManager PassManager::forLevel(int level) {
+    PassManager pm;
+    if (level >= 2) {
+        pm.add("constant-fold", foldConstants);
+    }
+    if (level >= 1) {
+        pm.add("dead-store-elim", eliminateDeadStores);
+        pm.add("empty-lane-elim", removeEmptyLanes);
+        pm.add("literal-dedup", dedupLiterals);
+    }
+    return pm;
+}
+
+namespace {
+
+// Lanes, syncs and channel transfers order work across threads; no
+// pass moves or merges stores across them.
+bool isBarrier(IROp op) {
+    return op == IROp::LANE_START || op == IROp::LANE_END ||
+           op == IROp::SYNC || op == IROp::SYNC_ALL ||
+           op == IROp::SEND || op == IROp::RECEIVE;
+}
+
+// A pure store writes arg1 without looking at its old value
+bool isPureStore(const IRInstr& in) {
+    return (in.op == IROp::MODIFY || in.op == IROp::CREATE) &&
+           in.arg1 != kNoSymbol && in.arg2 != in.arg1;
+}
+
+bool parseInteger(std::string_view text, int64_t& value) {
+    if (text.empty() || text.size() > 18) return false;
+    int64_t v = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') return false;
+        v = v * 10 + (c - '0');
+    }
+    value = v;
+    return true;
+}
+
+// Drops instructions flagged in dead, keeping the columns aligned
+size_t compact(IRProgram& ir, const std::vector<bool>& dead) {
+    size_t out = 0;
+    for (size_t i = 0; i < ir.size(); ++i) {
+        if (dead[i]) continue;
+        ir.ops[out] = ir.ops[i];
+        ir.arg1[out] = ir.arg1[i];
+        ir.arg2[out] = ir.arg2[i];
+        ir.lane[out] = ir.lane[i];
+        ir.loc[out] = ir.loc[i];
+        out++;
+    }
+    size_t removed = ir.size() - out;
+    ir.ops.resize(out);
+    ir.arg1.resize(out);
+    ir.arg2.resize(out);
+    ir.lane.resize(out);
+    ir.loc.resize(out);
+    return removed;
+}
+
+} // namespace
+
+size_t foldConstants(IRProgram& ir) {
+    // Known integer value of each container since the last barrier
+    std::unordered_map<SymbolId, int64_t> known;
+    size_t changed = 0;
+
+    for (size_t i = 0; i < ir.size(); ++i) {
+        const IRInstr in = ir.at(i);
+        if (isBarrier(in.op)) {
+            known.clear();
+            continue;
+        }
+
+        int64_t value = 0;
+        bool numeric = parseInteger(ir.text(in.arg2), value);
+
+        if (in.op == IROp::CREATE || in.op == IROp::MODIFY) {
+            if (numeric) known[in.arg1] = value;
+            else known.erase(in.arg1);
+        }
+        else if (in.op == IROp::ADJUST) {
+            auto it = known.find(in.arg1);
+            if (it != known.end() && numeric && it->second <= INT64_MAX - value) {
+                // adjust c n  ==>  modify c (known + n)
+                it->second += value;
+                ir.ops[i] = IROp::MODIFY;
+                ir.arg2[i] = ir.symbols.internCopy(std::to_string(it->second));
+                changed++;
+            } else {
+                known.erase(in.arg1);
+            }
+        }
+        else {
+            // DELETE, process read, receive replace the contents
+            const ContainerAccess access = containerAccess(ir, i);
+            if (access.writes) known.erase(ir.symbols.find(access.written));
+        }
+    }
+    return changed;
+}
+
+size_t eliminateDeadStores(IRProgram& ir) {
+    // Last store to each container that nothing has read yet
+    std::unordered_map<SymbolId, size_t> pending;
+    std::vector<bool> dead(ir.size(), false);
+
+    for (size_t i = 0; i < ir.size(); ++i) {
+        const IRInstr in = ir.at(i);
+        if (isBarrier(in.op)) {
+            pending.clear();
+            continue;
+        }
+
+        if (isPureStore(in)) {
+            // Any use of the value operand is a read
+            pending.erase(in.arg2);
+
+            auto it = pending.find(in.arg1);
+            if (it != pending.end()) {
+                size_t prev = it->second;
+                if (ir.ops[prev] == IROp::CREATE) {
+                    // Keep the declaration, take the newer initial value;
+                    // a container operand must still be read here
+                    if (in.op == IROp::MODIFY && !isContainerRef(ir.symbols, in.arg2)) {
+                        ir.arg2[prev] = in.arg2;
+                        dead[i] = true;
+                        continue;
+                    }
+                } else {
+                    dead[prev] = true;
+                }
+            }
+            pending[in.arg1] = i;
+        }
+        else if (in.op == IROp::DELETE) {
+            auto it = pending.find(in.arg1);
+            if (it != pending.end() && ir.ops[it->second] == IROp::MODIFY) {
+                dead[it->second] = true;
+            }
+            pending.erase(in.arg1);
+        }
+        else {
+            // Reading a container keeps its store; a process read or
+            // receive into it is not a pure store, so keep that too
+            const ContainerAccess access = containerAccess(ir, i);
+            for (uint8_t r = 0; r < access.readCount; ++r) pending.erase(ir.symbols.find(access.reads[r]));
+            if (access.writes) pending.erase(ir.symbols.find(access.written));
+        }
+    }
+    return compact(ir, dead);
+}
+
+size_t removeEmptyLanes(IRProgram& ir) {
+    std::vector<bool> dead(ir.size(), false);
+    for (size_t i = 0; i + 1 < ir.size(); ++i) {
+        if (ir.ops[i] == IROp::LANE_START && ir.ops[i + 1] == IROp::LANE_END &&
+            ir.lane[i] == ir.lane[i + 1]) {
+            dead[i] = dead[i + 1] = true;
+            i++;
+        }
+    }
+    return compact(ir, dead);
+}
+
+size_t dedupLiterals(IRProgram& ir) {
+    // Interning already gives equal literals one id; count the copies the
+    // data section no longer needs
+    if (ir.pooledLiterals) return 0;
+    ir.pooledLiterals = true;
+
+    std::vector<bool> seen(ir.symbols.size(), false);
+    size_t duplicates = 0;
+    for (SymbolId id : ir.arg2) {
+        if (!ir.symbols.isString(id)) continue;
+        if (seen[id]) duplicates++;
+        seen[id] = true;
+    }
+    return duplicates;
+}
+
+} // namespace EScript
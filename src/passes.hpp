@@ -0,0 +1,35 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include "ir.hpp"
+
+namespace EScript {
+
+// An IR-to-IR transformation. Returns the number of instructions it
+// removed or rewrote so the pipeline can report what it did.
+struct IRPass {
+    std::string name;
+    std::function<size_t(IRProgram&)> run;
+};
+
+class PassManager {
+    std::vector<IRPass> passes;
+
+public:
+    void add(std::string name, std::function<size_t(IRProgram&)> run);
+
+    // Runs every pass in order; logs one line per pass that changed the IR
+    size_t run(IRProgram& ir, std::ostream& log) const;
+
+    // Standard pipeline for -O0 / -O1 / -O2
+    static PassManager forLevel(int level);
+};
+
+// Individual passes
+size_t foldConstants(IRProgram& ir);          // -O2: numeric modify/adjust chains
+size_t eliminateDeadStores(IRProgram& ir);    // -O1: overwritten containers
+size_t removeEmptyLanes(IRProgram& ir);       // -O1: LANE_START directly followed by LANE_END
+size_t dedupLiterals(IRProgram& ir);          // -O1: one data entry per distinct string
+
+} // namespace EScript
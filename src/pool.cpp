@@ -0,0 +1,218 @@
+#include "pool.hpp"
+#include "profile.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace EScript {
+
+namespace {
+
+constexpr char kPoolMagic[4] = {'E', 'S', 'P', 'L'};
+constexpr size_t kHeaderWords = 8;
+
+uint32_t poolHash(std::string_view text) {
+    uint32_t h = 2166136261u;
+    for (char c : text) {
+        h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return h;
+}
+
+void putU32(std::string& out, uint32_t v) {
+    appendLE32(out, v);
+}
+
+void pad4(std::string& out) {
+    while (out.size() % 4 != 0) out.push_back('\0');
+}
+
+template <typename T>
+void putColumn(std::string& out, const std::vector<T>& column, size_t first, size_t count) {
+    if (sizeof(T) == 1) {
+        out.append(reinterpret_cast<const char*>(column.data() + first), count);
+    } else {
+        appendLEWords(out, column.data() + first, count * sizeof(T));
+    }
+}
+
+} // namespace
+
+std::string serializePool(const IRProgram& ir, const std::vector<PoolEntryRange>& entries) {
+    uint32_t buckets = 1;
+    while (buckets < entries.size() * 2) buckets <<= 1;
+
+    std::string blob;
+    std::string out;
+    out.append(kPoolMagic, sizeof(kPoolMagic));
+    putU32(out, kPoolVersion);
+    putU32(out, static_cast<uint32_t>(entries.size()));
+    putU32(out, buckets);
+    putU32(out, static_cast<uint32_t>(ir.symbols.size()));
+    putU32(out, static_cast<uint32_t>(ir.size()));
+    size_t blobSize = 0;
+    for (SymbolId id = 0; id < ir.symbols.size(); ++id) blobSize += ir.text(id).size();
+    putU32(out, static_cast<uint32_t>(blobSize));
+    putU32(out, 0);
+
+    // The IR's own symbol table is the string table
+    blob.reserve(blobSize);
+    for (SymbolId id = 0; id < ir.symbols.size(); ++id) {
+        putU32(out, static_cast<uint32_t>(blob.size()));
+        blob += ir.text(id);
+    }
+    putU32(out, static_cast<uint32_t>(blob.size()));
+    out += blob;
+    pad4(out);
+
+    std::vector<uint32_t> table(buckets, 0);
+    for (size_t e = 0; e < entries.size(); ++e) {
+        const PoolEntryRange& entry = entries[e];
+        uint32_t hash = poolHash(ir.text(entry.name));
+        putU32(out, entry.name);
+        putU32(out, hash);
+        putU32(out, entry.first);
+        putU32(out, entry.count);
+
+        uint32_t b = hash & (buckets - 1);
+        while (table[b] != 0) b = (b + 1) & (buckets - 1);
+        table[b] = static_cast<uint32_t>(e + 1);
+    }
+    putColumn(out, table, 0, table.size());
+
+    putColumn(out, ir.arg1, 0, ir.size());
+    putColumn(out, ir.arg2, 0, ir.size());
+    putColumn(out, ir.lane, 0, ir.size());
+    putColumn(out, ir.ops, 0, ir.size());
+    return out;
+}
+
+void writePool(const IRProgram& ir, const std::vector<PoolEntryRange>& entries, const std::string& path) {
+    ES_TIME_SCOPE("writePool");
+    std::string image = serializePool(ir, entries);
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) {
+        throw std::runtime_error("Cannot open file for writing: " + path);
+    }
+    size_t written = std::fwrite(image.data(), 1, image.size(), out);
+    bool ok = std::fclose(out) == 0 && written == image.size();
+    if (!ok) {
+        throw std::runtime_error("Failed writing pool: " + path);
+    }
+}
+
+PoolModule::PoolModule(std::string name, const std::string& path)
+    : poolName(std::move(name)), file(path), base(file.text().data()) {
+    const size_t size = file.text().size();
+    if (size < kHeaderWords * 4 || std::memcmp(base, kPoolMagic, sizeof(kPoolMagic)) != 0 ||
+        word(4) != kPoolVersion) {
+        throw std::runtime_error("Not an E-Script pool: " + path);
+    }
+    entries = word(8);
+    buckets = word(12);
+    strings = word(16);
+    instrs = word(20);
+    blobBytes = word(24);
+
+    // Section offsets follow from the counts; the sizes must add up
+    stringsAt = kHeaderWords * 4;
+    blobAt = stringsAt + (static_cast<size_t>(strings) + 1) * 4;
+    entriesAt = blobAt + (static_cast<size_t>(blobBytes) + 3) / 4 * 4;
+    bucketsAt = entriesAt + static_cast<size_t>(entries) * 16;
+    columnsAt = bucketsAt + static_cast<size_t>(buckets) * 4;
+    const size_t end = columnsAt + static_cast<size_t>(instrs) * 13;
+    if (strings == 0 || buckets == 0 || (buckets & (buckets - 1)) != 0 || buckets < entries ||
+        end != size) {
+        throw std::runtime_error("Corrupt pool: " + path);
+    }
+}
+
+uint32_t PoolModule::word(size_t offset) const {
+    return loadLE32(base + offset);
+}
+
+std::string_view PoolModule::string(uint32_t id) const {
+    if (id >= strings) {
+        throw std::runtime_error("Corrupt pool: " + path());
+    }
+    uint32_t begin = word(stringsAt + static_cast<size_t>(id) * 4);
+    uint32_t end = word(stringsAt + static_cast<size_t>(id) * 4 + 4);
+    if (begin > end || end > blobBytes) {
+        throw std::runtime_error("Corrupt pool: " + path());
+    }
+    return std::string_view(base + blobAt + begin, end - begin);
+}
+
+int64_t PoolModule::find(std::string_view entry) const {
+    const uint32_t hash = poolHash(entry);
+    for (uint32_t b = hash & (buckets - 1), probes = 0; probes < buckets; b = (b + 1) & (buckets - 1), ++probes) {
+        uint32_t slot = word(bucketsAt + static_cast<size_t>(b) * 4);
+        if (slot == 0 || slot > entries) return -1;
+        size_t at = entriesAt + static_cast<size_t>(slot - 1) * 16;
+        if (word(at + 4) == hash && string(word(at)) == entry) return slot - 1;
+    }
+    return -1;
+}
+
+void PoolModule::append(uint32_t index, IRProgram& ir, SymbolId laneId, SourceLoc site) const {
+    if (index >= entries) {
+        throw std::runtime_error("Corrupt pool: " + path());
+    }
+    const size_t at = entriesAt + static_cast<size_t>(index) * 16;
+    const uint32_t first = word(at + 8);
+    const uint32_t count = word(at + 12);
+    if (first > instrs || count > instrs - first) {
+        throw std::runtime_error("Corrupt pool: " + path());
+    }
+
+    // Operands are copied, so the IR does not keep the mapping alive
+    auto intern = [&](uint32_t id) {
+        std::string_view text = string(id);
+        SymbolId sym = ir.symbols.find(text);
+        if (sym == kNoSymbol && !text.empty()) sym = ir.symbols.internCopy(std::string(text));
+        return sym;
+    };
+
+    const size_t arg1At = columnsAt;
+    const size_t arg2At = arg1At + static_cast<size_t>(instrs) * 4;
+    const size_t laneAt = arg2At + static_cast<size_t>(instrs) * 4;
+    const size_t opsAt = laneAt + static_cast<size_t>(instrs) * 4;
+    for (uint32_t i = first; i < first + count; ++i) {
+        uint8_t op = static_cast<uint8_t>(base[opsAt + i]);
+        if (op > static_cast<uint8_t>(IROp::RECEIVE)) {
+            throw std::runtime_error("Corrupt pool: " + path());
+        }
+        SymbolId lane = intern(word(laneAt + static_cast<size_t>(i) * 4));
+        ir.push(static_cast<IROp>(op), intern(word(arg1At + static_cast<size_t>(i) * 4)),
+                intern(word(arg2At + static_cast<size_t>(i) * 4)), lane == kNoSymbol ? laneId : lane, site);
+    }
+}
+
+PoolSet::PoolSet(std::vector<std::string> searchPaths) : paths(std::move(searchPaths)) {}
+
+const PoolModule* PoolSet::used(std::string_view name) const {
+    for (const auto& pool : pools) {
+        if (pool->name() == name) return pool.get();
+    }
+    return nullptr;
+}
+
+const PoolModule& PoolSet::use(std::string_view name) {
+    if (const PoolModule* pool = used(name)) return *pool;
+
+    ES_TIME_SCOPE("pool");
+    std::string searched;
+    for (const auto& dir : paths) {
+        std::filesystem::path candidate = std::filesystem::path(dir) / (std::string(name) + ".pool");
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(candidate, ec)) {
+            pools.push_back(std::make_unique<PoolModule>(std::string(name), candidate.string()));
+            return *pools.back();
+        }
+        searched += (searched.empty() ? "" : ", ") + dir;
+    }
+    throw std::runtime_error("Pool '" + std::string(name) + "' not found (searched: " + searched + ")");
+}
+
+} // namespace EScript
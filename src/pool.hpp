@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ir.hpp"
+#include "source.hpp"
+
+namespace EScript {
+
+// Data pools are precompiled modules of named entries. A pool source
+// holds `define <entry> <operation> #` statements (repeating a name
+// appends to that entry) and may `use` other pools; `-emit-pool` lowers
+// it to a .pool image. A program imports one with `use pool "<name>" #`,
+// which maps <name>.pool from the search path, and `call <entry> [from
+// pool | from "<name>"] #` inlines the entry's IR at the call site.
+//
+// Image layout, little-endian u32 words unless noted:
+//   header      magic "ESPL", version, entryCount, bucketCount,
+//               stringCount, instrCount, blobBytes, 0
+//   strings     stringCount + 1 offsets into the blob; string 0 is empty
+//   blob        string bytes, padded to 4
+//   entries     {name, hash, first, count} per entry
+//   buckets     entry index + 1 (0 = empty), linear probing on FNV-1a
+//   columns     arg1, arg2, lane, then ops (u8), as in IRProgram
+// Opening checks only the header and section sizes; strings and
+// instructions are validated as entries are materialized.
+constexpr uint32_t kPoolVersion = 1;
+
+// One entry of a pool being built: instructions [first, first + count)
+struct PoolEntryRange {
+    SymbolId name;
+    uint32_t first;
+    uint32_t count;
+};
+
+class PoolModule {
+public:
+    // Maps path; throws std::runtime_error if it is not a pool image
+    PoolModule(std::string poolName, const std::string& path);
+
+    const std::string& name() const { return poolName; }
+    const std::string& path() const { return file.name(); }
+    uint32_t entryCount() const { return entries; }
+
+    // Index of the entry called entry, or -1
+    int64_t find(std::string_view entry) const;
+    // Appends entry index's instructions to ir, outside lanes tagged with
+    // laneId and located at the call site, interning their operands
+    void append(uint32_t index, IRProgram& ir, SymbolId laneId, SourceLoc site) const;
+
+private:
+    std::string poolName;
+    SourceFile file;
+    const char* base;
+    uint32_t entries = 0;
+    uint32_t buckets = 0;
+    uint32_t strings = 0;
+    uint32_t instrs = 0;
+    uint32_t blobBytes = 0;
+    size_t stringsAt = 0;
+    size_t blobAt = 0;
+    size_t entriesAt = 0;
+    size_t bucketsAt = 0;
+    size_t columnsAt = 0;
+
+    uint32_t word(size_t offset) const;
+    std::string_view string(uint32_t id) const;
+};
+
+// The pools one compile uses, mapped once each
+class PoolSet {
+public:
+    // Directories searched in order for <name>.pool
+    explicit PoolSet(std::vector<std::string> searchPaths);
+
+    // Maps <name>.pool from the first directory that has it; throws
+    // std::runtime_error when none does
+    const PoolModule& use(std::string_view name);
+
+    // Pool `name` if used, otherwise nullptr
+    const PoolModule* used(std::string_view name) const;
+    // Every pool used so far, in `use` order
+    const std::vector<std::unique_ptr<PoolModule>>& modules() const { return pools; }
+
+    // Entries materialized so far, for the compile log
+    size_t materialized() const { return calls; }
+    void countCall() { ++calls; }
+
+private:
+    std::vector<std::string> paths;
+    std::vector<std::unique_ptr<PoolModule>> pools;
+    size_t calls = 0;
+};
+
+// Lowers every `define` of a pool source into one IRProgram, each
+// entry's instructions contiguous, in order of first definition. Throws
+// std::runtime_error on statements other than define and use.
+IRProgram generatePoolIR(const Program& prog, std::vector<PoolEntryRange>& entries,
+                         PoolSet* pools = nullptr);
+
+std::string serializePool(const IRProgram& ir, const std::vector<PoolEntryRange>& entries);
+void writePool(const IRProgram& ir, const std::vector<PoolEntryRange>& entries, const std::string& path);
+
+} // namespace EScript
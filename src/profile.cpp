@@ -0,0 +1,232 @@
+#include "profile.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace EScript {
+
+std::atomic<bool> Profiler::active{false};
+std::atomic<uint64_t> Profiler::allocCount{0};
+std::atomic<uint64_t> Profiler::allocBytes{0};
+
+namespace {
+
+struct Span {
+    std::string name;
+    const char* category;
+    double startUs;
+    double wallUs;
+    double cpuUs;
+    uint64_t allocs;
+    uint64_t bytes;
+    uint64_t peakRssKB;
+    uint32_t thread;
+};
+
+struct ProfileState {
+    std::mutex m;
+    std::vector<Span> spans;
+    bool timeReport = false;
+    std::string traceFile;
+    std::chrono::steady_clock::time_point origin;
+};
+
+ProfileState& state() {
+    static ProfileState s;
+    return s;
+}
+
+// Process CPU time, all threads
+double cpuSeconds() {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+    auto ticks = [](const FILETIME& t) {
+        return (static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime;
+    };
+    return (ticks(kernel) + ticks(user)) * 1e-7;
+#else
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+uint64_t peakRssKB() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+}
+
+uint32_t threadIndex() {
+    static std::atomic<uint32_t> next{0};
+    thread_local uint32_t index = next++;
+    return index;
+}
+
+void writeJsonString(std::ostream& out, std::string_view s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out << buf;
+        }
+        else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+void printReport(const std::vector<Span>& spans, std::ostream& out) {
+    // Aggregate by category and name, in order of first appearance
+    struct Row {
+        std::string label;
+        size_t calls = 0;
+        double wallUs = 0, cpuUs = 0;
+        uint64_t allocs = 0, bytes = 0, peakRssKB = 0;
+    };
+    std::vector<Row> rows;
+    for (const Span& s : spans) {
+        std::string label = std::string(s.category) == "phase"
+                                ? s.name
+                                : "  " + std::string(s.category) + " " + s.name;
+        Row* row = nullptr;
+        for (auto& r : rows) {
+            if (r.label == label) row = &r;
+        }
+        if (!row) {
+            rows.push_back(Row{label});
+            row = &rows.back();
+        }
+        row->calls++;
+        row->wallUs += s.wallUs;
+        row->cpuUs += s.cpuUs;
+        row->allocs += s.allocs;
+        row->bytes += s.bytes;
+        row->peakRssKB = std::max(row->peakRssKB, s.peakRssKB);
+    }
+
+    std::ios flags(nullptr);
+    flags.copyfmt(out);
+    out << "\n=== TIME REPORT ===\n";
+    out << std::left << std::setw(28) << "phase" << std::right
+        << std::setw(7) << "calls" << std::setw(12) << "wall ms" << std::setw(12) << "cpu ms"
+        << std::setw(12) << "allocs" << std::setw(12) << "alloc KB" << std::setw(14) << "peak RSS KB"
+        << "\n";
+    out << std::fixed << std::setprecision(3);
+    for (const auto& r : rows) {
+        out << std::left << std::setw(28) << r.label << std::right
+            << std::setw(7) << r.calls << std::setw(12) << r.wallUs / 1000.0
+            << std::setw(12) << r.cpuUs / 1000.0 << std::setw(12) << r.allocs
+            << std::setw(12) << (r.bytes + 1023) / 1024 << std::setw(14) << r.peakRssKB << "\n";
+    }
+    out << "===================\n";
+    out.copyfmt(flags);
+}
+
+bool writeTrace(const std::vector<Span>& spans, const std::string& file) {
+    std::ofstream out(file, std::ios::binary);
+    if (!out) return false;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < spans.size(); ++i) {
+        const Span& s = spans[i];
+        out << "{\"name\":";
+        writeJsonString(out, s.name);
+        out << ",\"cat\":\"" << s.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << s.thread
+            << ",\"ts\":" << s.startUs << ",\"dur\":" << s.wallUs
+            << ",\"args\":{\"cpu_us\":" << s.cpuUs << ",\"allocs\":" << s.allocs
+            << ",\"alloc_bytes\":" << s.bytes << ",\"peak_rss_kb\":" << s.peakRssKB << "}}"
+            << (i + 1 < spans.size() ? ",\n" : "\n");
+    }
+    out << "]}\n";
+    return static_cast<bool>(out);
+}
+
+} // namespace
+
+void Profiler::start(bool timeReport, const std::string& traceFile) {
+    ProfileState& s = state();
+    s.timeReport = timeReport;
+    s.traceFile = traceFile;
+    s.origin = std::chrono::steady_clock::now();
+    active = timeReport || !traceFile.empty();
+}
+
+void Profiler::finish(std::ostream& out) {
+    if (!enabled()) return;
+    active = false;
+
+    ProfileState& s = state();
+    std::vector<Span> spans;
+    {
+        std::lock_guard<std::mutex> lock(s.m);
+        spans.swap(s.spans);
+    }
+    // Spans are recorded as they close; report and trace in start order
+    std::stable_sort(spans.begin(), spans.end(),
+                     [](const Span& a, const Span& b) { return a.startUs < b.startUs; });
+    if (s.timeReport) {
+        printReport(spans, out);
+    }
+    if (!s.traceFile.empty()) {
+        if (writeTrace(spans, s.traceFile)) {
+            out << "[Trace] " << spans.size() << " spans written to " << s.traceFile << "\n";
+        }
+        else {
+            out << "[Trace] Cannot write trace file: " << s.traceFile << "\n";
+        }
+    }
+}
+
+void ScopedTimer::begin(std::string_view spanName, const char* spanCategory) {
+    name.assign(spanName.data(), spanName.size());
+    category = spanCategory;
+    cpuStart = cpuSeconds();
+    allocsStart = Profiler::allocCount.load(std::memory_order_relaxed);
+    bytesStart = Profiler::allocBytes.load(std::memory_order_relaxed);
+    wallStart = std::chrono::steady_clock::now();
+}
+
+void ScopedTimer::end() {
+    auto wallEnd = std::chrono::steady_clock::now();
+    Span span;
+    span.category = category;
+    span.cpuUs = (cpuSeconds() - cpuStart) * 1e6;
+    span.allocs = Profiler::allocCount.load(std::memory_order_relaxed) - allocsStart;
+    span.bytes = Profiler::allocBytes.load(std::memory_order_relaxed) - bytesStart;
+    span.peakRssKB = peakRssKB();
+    span.thread = threadIndex();
+
+    ProfileState& s = state();
+    span.startUs = std::chrono::duration<double, std::micro>(wallStart - s.origin).count();
+    span.wallUs = std::chrono::duration<double, std::micro>(wallEnd - wallStart).count();
+    span.name = std::move(name);
+
+    std::lock_guard<std::mutex> lock(s.m);
+    s.spans.push_back(std::move(span));
+}
+
+} // namespace EScript
@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace EScript {
+
+// Phase instrumentation for -time-report and -trace=<file>.
+//
+// Modules mark work with ES_TIME_SCOPE("name") (or ES_TIME_SCOPE_CAT for
+// a non-phase category such as "pass" or "lane"). While the profiler is
+// off a scope costs one predictable branch; building with ES_NO_PROFILE
+// removes the scopes altogether. Allocation counts are process-wide and
+// come from the operator new hook in main.cpp, so a phase that overlaps
+// other threads' work (batch mode, lanes) includes their allocations.
+class Profiler {
+public:
+    // Turns collection on; traceFile may be empty
+    static void start(bool timeReport, const std::string& traceFile);
+    // Prints the -time-report table to out and writes the trace file;
+    // reports a trace that cannot be written on out rather than throwing
+    static void finish(std::ostream& out);
+
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+
+    static void noteAlloc(size_t bytes) {
+        if (enabled()) {
+            allocCount.fetch_add(1, std::memory_order_relaxed);
+            allocBytes.fetch_add(bytes, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    friend class ScopedTimer;
+
+    static std::atomic<bool> active;
+    static std::atomic<uint64_t> allocCount;
+    static std::atomic<uint64_t> allocBytes;
+};
+
+// Records one span from construction to destruction
+class ScopedTimer {
+    std::string name;
+    const char* category = nullptr;   // null: profiler was off at entry
+    std::chrono::steady_clock::time_point wallStart;
+    double cpuStart = 0.0;
+    uint64_t allocsStart = 0;
+    uint64_t bytesStart = 0;
+
+public:
+    explicit ScopedTimer(std::string_view spanName, const char* spanCategory = "phase") {
+        if (Profiler::enabled()) begin(spanName, spanCategory);
+    }
+    ~ScopedTimer() {
+        if (category) end();
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    void begin(std::string_view spanName, const char* spanCategory);
+    void end();
+};
+
+} // namespace EScript
+
+#define ES_PROFILE_CONCAT2(a, b) a##b
+#define ES_PROFILE_CONCAT(a, b) ES_PROFILE_CONCAT2(a, b)
+
+#ifdef ES_NO_PROFILE
+#define ES_TIME_SCOPE(name) ((void)0)
+#define ES_TIME_SCOPE_CAT(name, category) ((void)0)
+#else
+#define ES_TIME_SCOPE(name) \
+    ::EScript::ScopedTimer ES_PROFILE_CONCAT(esTimer_, __LINE__)(name)
+#define ES_TIME_SCOPE_CAT(name, category) \
+    ::EScript::ScopedTimer ES_PROFILE_CONCAT(esTimer_, __LINE__)(name, category)
+#endif
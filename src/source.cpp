@@ -0,0 +1,130 @@
+#include "source.hpp"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace EScript {
+
+namespace {
+
+// Read through iostreams for inputs that cannot be mapped (pipes, devices)
+std::string readWhole(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    return buffer.str();
+}
+
+} // namespace
+
+#ifdef _WIN32
+
+SourceFile::SourceFile(std::string p)
+    : path(std::move(p)), data(""), size(0), mapped(false),
+      fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+    fileHandle = file;
+
+    LARGE_INTEGER fileSize;
+    if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &fileSize)) {
+        fallback = readWhole(path);
+        data = fallback.data();
+        size = fallback.size();
+        return;
+    }
+    if (fileSize.QuadPart == 0) {
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        fallback = readWhole(path);
+        data = fallback.data();
+        size = fallback.size();
+        return;
+    }
+    mappingHandle = mapping;
+    mapped = true;
+    data = static_cast<const char*>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+}
+
+SourceFile::~SourceFile() {
+    if (mapped) {
+        UnmapViewOfFile(data);
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(fileHandle);
+    }
+}
+
+#else
+
+SourceFile::SourceFile(std::string p)
+    : path(std::move(p)), data(""), size(0), mapped(false) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        fallback = readWhole(path);
+        data = fallback.data();
+        size = fallback.size();
+        return;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        fallback = readWhole(path);
+        data = fallback.data();
+        size = fallback.size();
+        return;
+    }
+    madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    mapped = true;
+    data = static_cast<const char*>(view);
+    size = static_cast<size_t>(st.st_size);
+}
+
+SourceFile::~SourceFile() {
+    if (mapped) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
+
+#endif
+
+const SourceFile& SourceManager::load(const std::string& path) {
+    files.push_back(std::make_unique<SourceFile>(path));
+    return *files.back();
+}
+
+} // namespace EScript
@@ -0,0 +1,43 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace EScript {
+
+// A read-only source file mapped into memory for the whole compile.
+// Tokens, AST fields and IR operands are string_views into text().
+class SourceFile {
+    std::string path;
+    const char* data;
+    size_t size;
+    bool mapped;
+    std::string fallback;   // owned copy when the input cannot be mapped
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+
+public:
+    // Maps the file; throws std::runtime_error if it cannot be opened
+    explicit SourceFile(std::string p);
+    ~SourceFile();
+
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    const std::string& name() const { return path; }
+    std::string_view text() const { return std::string_view(data, size); }
+};
+
+// Owns every mapped input; must outlive all views handed out from it
+class SourceManager {
+    std::vector<std::unique_ptr<SourceFile>> files;
+
+public:
+    const SourceFile& load(const std::string& path);
+    const std::vector<std::unique_ptr<SourceFile>>& all() const { return files; }
+};
+
+} // namespace EScript
@@ -0,0 +1,256 @@
+#include "storage.hpp"
+#include <algorithm>
+
+namespace EScript {
+
+namespace {
+
+constexpr uint32_t kNoOwner = UINT32_MAX;
+constexpr uint32_t kSharedOwner = UINT32_MAX - 1;
+
+uint32_t slotSize(SlotType type) {
+    return type == SlotType::Text || type == SlotType::Mixed ? 16 : 8;
+}
+
+uint32_t roundUp(uint32_t v, uint32_t a) {
+    return (v + a - 1) / a * a;
+}
+
+// Type of a slot holding values of both a and b
+SlotType join(SlotType a, SlotType b) {
+    if (a == b) return a;
+    if ((a == SlotType::Int && b == SlotType::Real) || (a == SlotType::Real && b == SlotType::Int)) {
+        return SlotType::Real;
+    }
+    return SlotType::Mixed;
+}
+
+} // namespace
+
+const char* slotTypeName(SlotType type) {
+    switch (type) {
+    case SlotType::Int:  return "int";
+    case SlotType::Real: return "real";
+    case SlotType::Text: return "text";
+    default:             return "mixed";
+    }
+}
+
+bool isNumberText(std::string_view text) {
+    return !text.empty() && text[0] >= '0' && text[0] <= '9';
+}
+
+bool isContainerRef(const SymbolTable& symbols, SymbolId sym) {
+    std::string_view text = symbols.text(sym);
+    return !text.empty() && !symbols.isString(sym) && !isNumberText(text);
+}
+
+std::string_view unquote(std::string_view literal) {
+    return literal.substr(1, literal.size() - 2);
+}
+
+bool integerLiteral(std::string_view text, int64_t& value) {
+    if (text.empty()) return false;
+    int64_t v = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9' || v > (INT64_MAX - 9) / 10) return false;
+        v = v * 10 + (c - '0');
+    }
+    value = v;
+    return true;
+}
+
+std::string_view fileStem(std::string_view path) {
+    size_t slash = path.find_last_of("/\\");
+    if (slash != std::string_view::npos) path.remove_prefix(slash + 1);
+    return path.substr(0, path.find('.'));
+}
+
+ContainerAccess containerAccess(const IRProgram& ir, size_t i) {
+    const IRInstr in = ir.at(i);
+    std::string_view arg1 = ir.text(in.arg1);
+    std::string_view arg2 = ir.text(in.arg2);
+    ContainerAccess access;
+    auto write = [&](std::string_view name) {
+        access.writes = true;
+        access.written = name;
+    };
+    auto read = [&](std::string_view name) { access.reads[access.readCount++] = name; };
+
+    switch (in.op) {
+    case IROp::CREATE:
+    case IROp::MODIFY:
+        write(arg1);
+        if (isContainerRef(ir.symbols, in.arg2)) read(arg2);
+        break;
+    case IROp::ADJUST:
+        write(arg1);
+        read(arg1);
+        if (isContainerRef(ir.symbols, in.arg2)) read(arg2);
+        break;
+    case IROp::DELETE:
+        write(arg1);
+        break;
+    case IROp::PROCESS:
+        if (ir.symbols.isString(in.arg2)) {
+            if (arg1 == "read") write(fileStem(unquote(arg2)));
+        } else if (!arg2.empty()) {
+            if (arg1 == "read") write(arg2);
+            else if (arg1 == "write") read(arg2);
+        }
+        break;
+    case IROp::SEND:
+        if (isContainerRef(ir.symbols, in.arg2)) read(arg2);
+        break;
+    case IROp::RECEIVE:
+        write(arg2);
+        break;
+    default:
+        break;
+    }
+    return access;
+}
+
+StoragePlan planStorage(const IRProgram& ir, const LanePlan& lanes) {
+    StoragePlan plan;
+
+    // Owner of each instruction: the lane whose thread runs it, or
+    // kNoSymbol for the main thread
+    std::vector<SymbolId> owner(ir.size(), kNoSymbol);
+    for (const LaneInstance& lane : lanes.instances) {
+        for (uint32_t i : lane.body) owner[i] = lane.lane;
+    }
+
+    std::vector<bool> typed;            // a store has fixed the type
+    std::vector<uint32_t> ownedBy;      // lane index + 1, 0 for main, or kSharedOwner
+    std::vector<SymbolId> laneOrder;    // owning lanes, first use first
+    std::unordered_map<SymbolId, uint32_t> laneIndex;
+
+    // An empty name is only a container when a file read fills it: the
+    // interpreter reads ".env" into "", so the native code maps it too
+    auto touch = [&](std::string_view name, size_t i, bool fileRead = false) {
+        if (name.empty() && !fileRead) return kNoOwner;
+        auto it = plan.index.find(name);
+        uint32_t s;
+        if (it == plan.index.end()) {
+            s = static_cast<uint32_t>(plan.slots.size());
+            ContainerSlot slot;
+            slot.name = name;
+            plan.slots.push_back(slot);
+            plan.index.emplace(name, s);
+            typed.push_back(false);
+            ownedBy.push_back(kNoOwner);
+        } else {
+            s = it->second;
+        }
+
+        uint32_t by = 0;
+        if (owner[i] != kNoSymbol) {
+            auto lane = laneIndex.find(owner[i]);
+            if (lane == laneIndex.end()) {
+                lane = laneIndex.emplace(owner[i], static_cast<uint32_t>(laneOrder.size())).first;
+                laneOrder.push_back(owner[i]);
+            }
+            by = lane->second + 1;
+        }
+        if (ownedBy[s] == kNoOwner) ownedBy[s] = by;
+        else if (ownedBy[s] != by) ownedBy[s] = kSharedOwner;
+        return s;
+    };
+
+    auto store = [&](uint32_t s, SlotType type) {
+        if (s == kNoOwner) return;
+        ContainerSlot& slot = plan.slots[s];
+        slot.type = typed[s] ? join(slot.type, type) : type;
+        typed[s] = true;
+    };
+
+    // Copies between containers, resolved once every literal store is known
+    std::vector<std::pair<uint32_t, uint32_t>> copies;
+
+    for (size_t i = 0; i < ir.size(); ++i) {
+        const IRInstr in = ir.at(i);
+        std::string_view arg1 = ir.text(in.arg1);
+        std::string_view arg2 = ir.text(in.arg2);
+
+        switch (in.op) {
+        case IROp::CREATE:
+        case IROp::MODIFY:
+        case IROp::ADJUST: {
+            const uint32_t s = touch(arg1, i);
+            if (s == kNoOwner) break;
+            int64_t value;
+            if (isContainerRef(ir.symbols, in.arg2)) {
+                copies.emplace_back(s, touch(arg2, i));
+            } else if (ir.symbols.isString(in.arg2)) {
+                store(s, SlotType::Text);
+            } else if (arg2.empty() || integerLiteral(arg2, value)) {
+                store(s, SlotType::Int);
+            } else {
+                store(s, SlotType::Real);
+            }
+            break;
+        }
+        case IROp::DELETE:
+        case IROp::BYPASS:
+        case IROp::DEPLOY:
+            touch(arg1, i);
+            break;
+        case IROp::PROCESS:
+            if (arg1 == "read" && ir.symbols.isString(in.arg2)) {
+                store(touch(fileStem(unquote(arg2)), i, true), SlotType::Text);
+            } else if (arg1 == "read" && isContainerRef(ir.symbols, in.arg2)) {
+                store(touch(arg2, i), SlotType::Text);
+            } else if (arg1 == "write" && isContainerRef(ir.symbols, in.arg2)) {
+                touch(arg2, i);
+            }
+            break;
+        case IROp::SEND:
+            if (isContainerRef(ir.symbols, in.arg2)) touch(arg2, i);
+            break;
+        case IROp::RECEIVE:
+            if (isContainerRef(ir.symbols, in.arg2)) store(touch(arg2, i), SlotType::Text);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // A copy gives the target the source's type; repeat until chains settle
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const auto& copy : copies) {
+            if (!typed[copy.second]) continue;
+            const SlotType before = plan.slots[copy.first].type;
+            const bool wasTyped = typed[copy.first];
+            store(copy.first, plan.slots[copy.second].type);
+            changed |= !wasTyped || plan.slots[copy.first].type != before;
+        }
+    }
+
+    // Main group, one group per owning lane, then the shared group
+    plan.groups.resize(laneOrder.size() + 2);
+    for (size_t l = 0; l < laneOrder.size(); ++l) plan.groups[l + 1].lane = laneOrder[l];
+    const uint32_t sharedGroup = static_cast<uint32_t>(plan.groups.size() - 1);
+    plan.groups[sharedGroup].shared = true;
+
+    for (size_t s = 0; s < plan.slots.size(); ++s) {
+        ContainerSlot& slot = plan.slots[s];
+        StorageGroup* group;
+        if (ownedBy[s] == kSharedOwner) {
+            slot.group = sharedGroup;
+            slot.shared = true;
+            group = &plan.groups[sharedGroup];
+            group->size = roundUp(group->size, kCacheLine);
+        } else {
+            slot.group = ownedBy[s];
+            group = &plan.groups[slot.group];
+        }
+        slot.offset = group->size;
+        group->size += slotSize(slot.type);
+    }
+    for (StorageGroup& group : plan.groups) group.size = roundUp(group.size, kCacheLine);
+    return plan;
+}
+
+} // namespace EScript
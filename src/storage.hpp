@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ir.hpp"
+#include "lanes.hpp"
+
+namespace EScript {
+
+// Static storage of the containers a compiled program names. Every
+// container gets one typed slot, sized by what is stored into it:
+//   Int    int64 value
+//   Real   IEEE double bits
+//   Text   {ptr, len} view of a literal, a mapped file or a received value
+//   Mixed  numbers and text both; kept as a text-sized slot
+// Containers touched by one lane only (the main thread counts as one)
+// are packed into that lane's group, padded to a cache line so no other
+// thread's data shares a line with it. Containers touched by more than
+// one are shared: each gets a cache line of its own, and numeric updates
+// to them are atomic (locked read-modify-write, aligned 8-byte stores).
+// A text view's two words are stored separately, so only its pointer or
+// its length is atomic, not the pair.
+constexpr uint32_t kCacheLine = 64;
+
+enum class SlotType : uint8_t { Int, Real, Text, Mixed };
+
+const char* slotTypeName(SlotType type);
+
+struct ContainerSlot {
+    std::string_view name;
+    SlotType type = SlotType::Int;
+    uint32_t group = 0;             // StoragePlan::groups entry
+    uint32_t offset = 0;            // bytes from the group's start
+    bool shared = false;            // atomic access required
+};
+
+struct StorageGroup {
+    SymbolId lane = kNoSymbol;      // owning lane; kNoSymbol for main and shared
+    bool shared = false;
+    uint32_t size = 0;              // multiple of kCacheLine
+};
+
+struct StoragePlan {
+    std::vector<ContainerSlot> slots;           // in order of first use
+    std::vector<StorageGroup> groups;           // main, then lanes, then shared
+    std::unordered_map<std::string_view, uint32_t> index;   // name -> slots entry
+
+    const ContainerSlot* find(std::string_view name) const {
+        auto it = index.find(name);
+        return it == index.end() ? nullptr : &slots[it->second];
+    }
+};
+
+// Operand conventions shared by the interpreter and the native backends.
+// A number starts with a digit; a string literal keeps its quotes.
+bool isNumberText(std::string_view text);
+// Identifier operands name containers; everything else is a literal
+bool isContainerRef(const SymbolTable& symbols, SymbolId sym);
+// String literal without its quotes
+std::string_view unquote(std::string_view literal);
+
+// Integer operand as the interpreter reads it: digits that fit an int64
+bool integerLiteral(std::string_view text, int64_t& value);
+
+// Container a `process read "path"` fills: "logs/data.txt" -> "data"
+std::string_view fileStem(std::string_view path);
+
+// Containers one instruction uses, as the interpreter runs it:
+//   create/modify  write arg1, read arg2 if it names a container
+//   adjust         write and read arg1, read arg2 if it names a container
+//   delete         write arg1
+//   process read   write the file's stem container, or the named container
+//   process write  read the named container
+//   send/receive   read / write the container operand
+// bypass, deploy, ping and analyze touch no container.
+struct ContainerAccess {
+    bool writes = false;
+    std::string_view written;       // may be "" (a file read into ".env")
+    std::string_view reads[2];
+    uint8_t readCount = 0;
+};
+
+ContainerAccess containerAccess(const IRProgram& ir, size_t i);
+
+StoragePlan planStorage(const IRProgram& ir, const LanePlan& lanes);
+
+} // namespace EScript
@@ -0,0 +1,35 @@
+#include "symbols.hpp"
+
+namespace EScript {
+
+SymbolTable::SymbolTable() {
+    strings.push_back(std::string_view());
+    index.emplace(std::string_view(), kNoSymbol);
+}
+
+SymbolId SymbolTable::intern(std::string_view text) {
+    auto it = index.find(text);
+    if (it != index.end()) {
+        return it->second;
+    }
+    SymbolId id = static_cast<SymbolId>(strings.size());
+    strings.push_back(text);
+    index.emplace(text, id);
+    return id;
+}
+
+SymbolId SymbolTable::internCopy(std::string text) {
+    auto it = index.find(text);
+    if (it != index.end()) {
+        return it->second;
+    }
+    owned.push_back(std::move(text));
+    return intern(owned.back());
+}
+
+SymbolId SymbolTable::find(std::string_view text) const {
+    auto it = index.find(text);
+    return it == index.end() ? kNoSymbol : it->second;
+}
+
+} // namespace EScript
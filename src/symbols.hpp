@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace EScript {
+
+using SymbolId = uint32_t;
+constexpr SymbolId kNoSymbol = 0;   // always the empty string
+
+// Interns identifiers and literals to dense 32-bit ids. Interned views
+// must outlive the table (they normally point into the mapped source);
+// internCopy() is for text synthesized by the compiler.
+class SymbolTable {
+    std::vector<std::string_view> strings;
+    std::unordered_map<std::string_view, SymbolId> index;
+    std::deque<std::string> owned;
+
+public:
+    SymbolTable();
+
+    SymbolId intern(std::string_view text);
+    SymbolId internCopy(std::string text);
+
+    // Id of text if already interned, kNoSymbol otherwise
+    SymbolId find(std::string_view text) const;
+
+    std::string_view text(SymbolId id) const { return strings[id]; }
+    bool isString(SymbolId id) const {
+        return !strings[id].empty() && strings[id][0] == '"';
+    }
+    size_t size() const { return strings.size(); }
+};
+
+} // namespace EScript
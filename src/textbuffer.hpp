@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace EScript {
+
+// Append-only text buffer for the emitters: one contiguous allocation,
+// no stream state, and integer formatting without locale lookups.
+class TextBuffer {
+    std::string buf;
+
+public:
+    void reserve(size_t bytes) { buf.reserve(bytes); }
+    size_t size() const { return buf.size(); }
+    const std::string& str() const { return buf; }
+    std::string take() { return std::move(buf); }
+
+    TextBuffer& operator<<(std::string_view s) {
+        buf.append(s.data(), s.size());
+        return *this;
+    }
+    TextBuffer& operator<<(const char* s) { return *this << std::string_view(s); }
+    TextBuffer& operator<<(char c) {
+        buf.push_back(c);
+        return *this;
+    }
+    TextBuffer& operator<<(uint64_t v) {
+        char digits[20];
+        size_t n = 0;
+        do {
+            digits[n++] = static_cast<char>('0' + v % 10);
+            v /= 10;
+        } while (v != 0);
+        while (n > 0) buf.push_back(digits[--n]);
+        return *this;
+    }
+    TextBuffer& operator<<(int64_t v) {
+        if (v < 0) {
+            buf.push_back('-');
+            return *this << (~static_cast<uint64_t>(v) + 1);
+        }
+        return *this << static_cast<uint64_t>(v);
+    }
+    TextBuffer& operator<<(int v) { return *this << static_cast<int64_t>(v); }
+    TextBuffer& operator<<(unsigned v) { return *this << static_cast<uint64_t>(v); }
+};
+
+} // namespace EScript
@@ -0,0 +1,125 @@
+#include "threadpool.hpp"
+
+namespace EScript {
+
+namespace {
+
+// Pool and queue index of the current worker thread
+thread_local const ThreadPool* tlsPool = nullptr;
+thread_local size_t tlsIndex = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t threads)
+    : queued(0), pending(0), nextQueue(0), stopping(false) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+    }
+
+    for (size_t i = 0; i < threads; ++i) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m);
+        stopping = true;
+    }
+    workCv.notify_all();
+    for (auto& t : workers) {
+        t.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    size_t target;
+    {
+        std::lock_guard<std::mutex> lock(m);
+        pending++;
+        target = tlsPool == this ? tlsIndex : nextQueue++ % queues.size();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queues[target]->m);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(m);
+        queued.fetch_add(1, std::memory_order_release);
+    }
+    workCv.notify_one();
+}
+
+bool ThreadPool::tryPop(size_t self, std::function<void()>& task) {
+    // Own queue first, newest task (warm in cache)
+    {
+        WorkQueue& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.m);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued.fetch_sub(1, std::memory_order_acq_rel);
+            return true;
+        }
+    }
+
+    // Steal the oldest task from a sibling
+    for (size_t k = 1; k < queues.size(); ++k) {
+        WorkQueue& victim = *queues[(self + k) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.m);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1, std::memory_order_acq_rel);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    tlsPool = this;
+    tlsIndex = index;
+
+    for (;;) {
+        std::function<void()> task;
+        if (tryPop(index, task)) {
+            std::exception_ptr error;
+            try {
+                task();
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(m);
+            if (error && !firstError) firstError = error;
+            if (--pending == 0) doneCv.notify_all();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m);
+        workCv.wait(lock, [this] {
+            return stopping || queued.load(std::memory_order_acquire) > 0;
+        });
+        if (stopping && queued.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(m);
+    doneCv.wait(lock, [this] { return pending == 0; });
+    if (firstError) {
+        std::exception_ptr error = firstError;
+        firstError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace EScript
@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace EScript {
+
+// Work-stealing thread pool. Each worker owns a deque: it pops its own
+// work LIFO and steals FIFO from the other workers when it runs dry.
+// Tasks submitted from a worker stay on that worker's deque.
+class ThreadPool {
+    struct WorkQueue {
+        std::mutex m;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex m;
+    std::condition_variable workCv;
+    std::condition_variable doneCv;
+    std::atomic<size_t> queued;   // tasks sitting in a deque
+    size_t pending;               // submitted but not finished, guarded by m
+    size_t nextQueue;             // round-robin target for external submits
+    bool stopping;
+    std::exception_ptr firstError;
+
+    bool tryPop(size_t self, std::function<void()>& task);
+    void workerLoop(size_t index);
+
+public:
+    // threads == 0 picks std::thread::hardware_concurrency()
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Blocks until every submitted task has finished; rethrows the first
+    // exception a task let escape. Must not be called from a worker.
+    void wait();
+
+    size_t size() const { return workers.size(); }
+};
+
+} // namespace EScript
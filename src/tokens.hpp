@@ -1,17 +1,83 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <vector>
+#include <type_traits>
 
 namespace EScript {
 
+enum class TokenKind : uint8_t {
+    // Keywords (operation verbs)
+    KW_MODIFY,
+    KW_ADJUST,
+    KW_BYPASS,
+    KW_DELETE,
+    KW_PROCESS,
+    KW_CREATE,
+    KW_DEPLOY,
+    KW_LANE,
+    KW_SYNC,
+    KW_IF,
+    KW_ELSE,
+    KW_LOOP,
+    KW_CHANNEL,
+    KW_SEND,
+    KW_RECEIVE,
+    KW_USE,
+    KW_CALL,
+    KW_DEFINE,
+
+    // Actions
+    ACTION_READ,
+    ACTION_WRITE,
+    ACTION_PING,
+    ACTION_ANALYZE,
+
+    // Literals
+    STRING,
+    NUMBER,
+    IDENT,
+
+    // Operators and punctuation
+    HASH,
+    PLUS,
+    MINUS,
+    LPAREN,
+    RPAREN,
+    TO
+};
+
+// Printable name of a token kind, e.g. "KW_MODIFY"
+const char* tokenKindName(TokenKind kind);
+
+// Compact POD token; the lexeme lives in the source buffer
 struct Token {
-    std::string type;
-    std::string value;
-    int line;
-    int column;
-    
-    Token() : line(0), column(0) {}
-    Token(const std::string& t, const std::string& v, int l = 0, int c = 0)
-        : type(t), value(v), line(l), column(c) {}
+    uint32_t offset;   // byte offset of the lexeme in the source
+    uint32_t length;   // byte length of the lexeme
+    uint32_t line;
+    uint16_t column;   // saturates at UINT16_MAX on very long lines
+    TokenKind kind;
+
+    std::string_view text(std::string_view src) const {
+        return src.substr(offset, length);
+    }
+};
+
+static_assert(sizeof(Token) <= 16, "Token must stay within 16 bytes");
+static_assert(std::is_trivially_copyable<Token>::value, "Token must be POD");
+
+struct LexError {
+    size_t offset;
+    std::string message;   // without the position, e.g. "Unknown token near '@...'"
+};
+
+// What a tolerant tokenize found besides the tokens
+struct LexStatus {
+    std::vector<LexError> errors;
+    size_t openComment = SIZE_MAX;   // a "**" no later "**" closes, lexed as a line comment
+    bool openString = false;         // src ended inside a string
 };
 
 } // namespace EScript
@@ -0,0 +1,268 @@
+#include "x64.hpp"
+#include <stdexcept>
+#include <string>
+
+namespace EScript {
+
+namespace {
+
+using Kind = MOperand::Kind;
+
+uint8_t regNum(Reg r) {
+    return static_cast<uint8_t>(r);
+}
+
+bool fitsInt8(int32_t v) {
+    return v >= -128 && v <= 127;
+}
+
+// Group-1 ALU opcodes: op r/m, r is n*8+1; op r, r/m is n*8+3; imm is /n
+int aluIndex(MOp op) {
+    switch (op) {
+    case MOp::Add: return 0;
+    case MOp::Or:  return 1;
+    case MOp::And: return 4;
+    case MOp::Sub: return 5;
+    case MOp::Xor: return 6;
+    case MOp::Cmp: return 7;
+    default:       return -1;
+    }
+}
+
+[[noreturn]] void unsupported(const char* what) {
+    throw std::runtime_error(std::string("x86-64 encoder: unsupported ") + what);
+}
+
+} // namespace
+
+void X64Assembler::emit32(uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        bytes.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+}
+
+void X64Assembler::patch32(size_t offset, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        bytes[offset + i] = static_cast<uint8_t>(v >> (8 * i));
+    }
+}
+
+void X64Assembler::emitImm32(const MOperand& op) {
+    if (op.kind == Kind::Addr) {
+        relocs.push_back(Reloc{bytes.size(), false, op.sym, op.value});
+        emit32(0);
+    } else {
+        emit32(static_cast<uint32_t>(op.value));
+    }
+}
+
+void X64Assembler::emitRex(bool w, uint8_t reg, uint8_t rm, bool byteRegs) {
+    uint8_t rex = 0x40;
+    if (w) rex |= 0x08;
+    if (reg & 8) rex |= 0x04;
+    if (rm & 8) rex |= 0x01;
+    // spl/bpl/sil/dil are only reachable with a REX prefix
+    bool needed = rex != 0x40 || (byteRegs && ((reg & 7) >= 4 || (rm & 7) >= 4));
+    if (needed) emit8(rex);
+}
+
+void X64Assembler::emitModRM(uint8_t reg, const MOperand& rm) {
+    const uint8_t r = static_cast<uint8_t>((reg & 7) << 3);
+    if (rm.kind == Kind::Reg) {
+        emit8(static_cast<uint8_t>(0xC0 | r | (regNum(rm.reg) & 7)));
+        return;
+    }
+    if (rm.kind != Kind::Mem) unsupported("memory operand");
+
+    if (!rm.hasBase) {
+        // [disp32] absolute: mod=00 rm=100, SIB base=101 no index
+        emit8(static_cast<uint8_t>(0x04 | r));
+        emit8(0x25);
+    } else {
+        const uint8_t base = regNum(rm.reg) & 7;
+        uint8_t mod;
+        if (rm.sym != kNoMSym || !fitsInt8(rm.value)) mod = 0x80;
+        else if (rm.value == 0 && base != 5) mod = 0x00;
+        else mod = 0x40;
+        emit8(static_cast<uint8_t>(mod | r | base));
+        if (base == 4) emit8(0x24);     // rsp/r12 base needs a SIB byte
+        if (mod == 0x40) {
+            emit8(static_cast<uint8_t>(rm.value));
+            return;
+        }
+        if (mod == 0x00) return;
+    }
+
+    if (rm.sym != kNoMSym) {
+        relocs.push_back(Reloc{bytes.size(), false, rm.sym, rm.value});
+        emit32(0);
+    } else {
+        emit32(static_cast<uint32_t>(rm.value));
+    }
+}
+
+void X64Assembler::emitRegRM(const MInstr& in, uint8_t opcode, uint8_t reg, const MOperand& rm) {
+    if (in.lock) emit8(0xF0);
+    uint8_t rmNum = rm.kind == Kind::Reg ? regNum(rm.reg)
+                  : (rm.hasBase ? regNum(rm.reg) : 0);
+    emitRex(in.width == Width::W64, reg, rmNum, in.width == Width::W8);
+    emit8(opcode);
+    emitModRM(reg, rm);
+}
+
+void X64Assembler::emitBranch(const MInstr& in) {
+    switch (in.op) {
+    case MOp::Jmp:  emit8(0xE9); break;
+    case MOp::Call: emit8(0xE8); break;
+    case MOp::Jz:   emit8(0x0F); emit8(0x84); break;
+    case MOp::Jnz:  emit8(0x0F); emit8(0x85); break;
+    case MOp::Js:   emit8(0x0F); emit8(0x88); break;
+    case MOp::Jo:   emit8(0x0F); emit8(0x80); break;
+    default:        unsupported("branch");
+    }
+    relocs.push_back(Reloc{bytes.size(), true, in.dst.sym, 0});
+    emit32(0);
+}
+
+void X64Assembler::encode(const MInstr& in) {
+    const MOperand& dst = in.dst;
+    const MOperand& src = in.src;
+    const bool byteOp = in.width == Width::W8;
+    const bool immSrc = src.kind == Kind::Imm || src.kind == Kind::Addr;
+
+    switch (in.op) {
+    case MOp::Mov:
+        if (dst.kind == Kind::Reg && immSrc && in.width == Width::W32) {
+            // B8+rd id
+            emitRex(false, 0, regNum(dst.reg), false);
+            emit8(static_cast<uint8_t>(0xB8 + (regNum(dst.reg) & 7)));
+            emitImm32(src);
+        } else if (immSrc) {
+            // C6 /0 ib, C7 /0 id (sign-extended for 64-bit)
+            emitRegRM(in, byteOp ? 0xC6 : 0xC7, 0, dst);
+            if (byteOp) emit8(static_cast<uint8_t>(src.value));
+            else emitImm32(src);
+        } else if (src.kind == Kind::Reg) {
+            emitRegRM(in, byteOp ? 0x88 : 0x89, regNum(src.reg), dst);
+        } else if (dst.kind == Kind::Reg && src.kind == Kind::Mem) {
+            emitRegRM(in, byteOp ? 0x8A : 0x8B, regNum(dst.reg), src);
+        } else {
+            unsupported("mov operands");
+        }
+        return;
+
+    case MOp::Add:
+    case MOp::Or:
+    case MOp::And:
+    case MOp::Sub:
+    case MOp::Xor:
+    case MOp::Cmp: {
+        if (byteOp) unsupported("8-bit arithmetic");
+        const uint8_t n = static_cast<uint8_t>(aluIndex(in.op));
+        if (immSrc) {
+            bool short8 = src.kind == Kind::Imm && fitsInt8(src.value);
+            emitRegRM(in, short8 ? 0x83 : 0x81, n, dst);
+            if (short8) emit8(static_cast<uint8_t>(src.value));
+            else emitImm32(src);
+        } else if (src.kind == Kind::Reg) {
+            emitRegRM(in, static_cast<uint8_t>(n * 8 + 1), regNum(src.reg), dst);
+        } else if (dst.kind == Kind::Reg && src.kind == Kind::Mem) {
+            emitRegRM(in, static_cast<uint8_t>(n * 8 + 3), regNum(dst.reg), src);
+        } else {
+            unsupported("arithmetic operands");
+        }
+        return;
+    }
+
+    case MOp::Test:
+        if (byteOp) unsupported("8-bit test");
+        if (immSrc) {
+            emitRegRM(in, 0xF7, 0, dst);
+            emitImm32(src);
+        } else if (src.kind == Kind::Reg) {
+            emitRegRM(in, 0x85, regNum(src.reg), dst);
+        } else {
+            unsupported("test operands");
+        }
+        return;
+
+    case MOp::Lea:
+        if (dst.kind != Kind::Reg || src.kind != Kind::Mem) unsupported("lea operands");
+        emitRegRM(in, 0x8D, regNum(dst.reg), src);
+        return;
+
+    case MOp::Shl:
+    case MOp::Shr:
+        // C1 /4 ib, C1 /5 ib
+        if (byteOp || src.kind != Kind::Imm) unsupported("shift operands");
+        emitRegRM(in, 0xC1, in.op == MOp::Shl ? 4 : 5, dst);
+        emit8(static_cast<uint8_t>(src.value));
+        return;
+
+    case MOp::Xadd:
+        // 0F C1 /r
+        if (byteOp || src.kind != Kind::Reg) unsupported("xadd operands");
+        if (in.lock) emit8(0xF0);
+        emitRex(in.width == Width::W64, regNum(src.reg),
+                dst.kind == Kind::Reg ? regNum(dst.reg) : (dst.hasBase ? regNum(dst.reg) : 0), false);
+        emit8(0x0F);
+        emit8(0xC1);
+        emitModRM(regNum(src.reg), dst);
+        return;
+
+    case MOp::Neg:
+    case MOp::Div:
+        // F7 /3, F7 /6
+        if (byteOp || src.kind != Kind::None) unsupported("neg/div operands");
+        emitRegRM(in, 0xF7, in.op == MOp::Neg ? 3 : 6, dst);
+        return;
+
+    case MOp::Jmp:
+    case MOp::Jz:
+    case MOp::Jnz:
+    case MOp::Js:
+    case MOp::Jo:
+    case MOp::Call:
+        emitBranch(in);
+        return;
+
+    case MOp::Ret:
+        emit8(0xC3);
+        return;
+    case MOp::Syscall:
+        emit8(0x0F);
+        emit8(0x05);
+        return;
+    case MOp::Int80:
+        emit8(0xCD);
+        emit8(0x80);
+        return;
+    case MOp::Pause:
+        emit8(0xF3);
+        emit8(0x90);
+        return;
+    }
+    unsupported("opcode");
+}
+
+void X64Assembler::link(const std::vector<uint64_t>& symbolAddress, uint64_t textAddress) {
+    for (const Reloc& r : relocs) {
+        if (r.sym >= symbolAddress.size()) {
+            throw std::runtime_error("Undefined symbol " + std::to_string(r.sym));
+        }
+        int64_t target = static_cast<int64_t>(symbolAddress[r.sym]) + r.addend;
+        if (r.pcRelative) {
+            // rel32 is relative to the end of the 4-byte field
+            int64_t rel = target - static_cast<int64_t>(textAddress + r.offset + 4);
+            patch32(r.offset, static_cast<uint32_t>(static_cast<int32_t>(rel)));
+        } else {
+            // disp32/imm32 are sign-extended in 64-bit forms
+            if (target < 0 || target > INT32_MAX) {
+                throw std::runtime_error("Address does not fit in 32 bits");
+            }
+            patch32(r.offset, static_cast<uint32_t>(target));
+        }
+    }
+}
+
+} // namespace EScript
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "mc.hpp"
+
+namespace EScript {
+
+// Encoder for the machine instructions lowering produces. Code is
+// position dependent: symbol addresses (code labels, data, bss) are
+// patched by link() once the final load addresses are known.
+class X64Assembler {
+public:
+    // Appends the encoding of `in`; throws std::runtime_error for operand
+    // combinations the encoder does not support
+    void encode(const MInstr& in);
+
+    // Patches every symbol reference. symbolAddress holds the absolute
+    // address of each MSym; textAddress is where code() will be loaded.
+    void link(const std::vector<uint64_t>& symbolAddress, uint64_t textAddress);
+
+    const std::vector<uint8_t>& code() const { return bytes; }
+    size_t size() const { return bytes.size(); }
+
+private:
+    struct Reloc {
+        size_t offset;      // position of the 4-byte field in code
+        bool pcRelative;    // rel32 from the end of the field, else abs32
+        MSym sym;
+        int32_t addend;
+    };
+
+    std::vector<uint8_t> bytes;
+    std::vector<Reloc> relocs;
+
+    void emit8(uint8_t b) { bytes.push_back(b); }
+    void emit32(uint32_t v);
+    void patch32(size_t offset, uint32_t v);
+
+    // imm32 field: plain value, or a symbol address plus addend
+    void emitImm32(const MOperand& op);
+    void emitRex(bool w, uint8_t reg, uint8_t rm, bool byteRegs);
+    // ModRM (+SIB/disp) addressing `rm` with `reg` in the reg field
+    void emitModRM(uint8_t reg, const MOperand& rm);
+    // Opcode with REX for a reg/rm pair
+    void emitRegRM(const MInstr& in, uint8_t opcode, uint8_t reg, const MOperand& rm);
+    void emitBranch(const MInstr& in);
+};
+
+} // namespace EScript